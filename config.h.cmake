@@ -8,11 +8,14 @@
 #cmakedefine HAVE_LIBEXECINFO
 #cmakedefine HAVE_CXXABI_H
 #cmakedefine HAVE_NICE
+#cmakedefine HAVE_POSIX_SPAWN
 #cmakedefine HAVE_EDITLINE
 #cmakedefine HAVE_SYSTEMD
 
 #cmakedefine ICINGA2_UNITY_BUILD
 
+#cmakedefine ICINGA2_LOCK_PROFILING
+
 #define ICINGA_CONFIGDIR "${ICINGA2_FULL_CONFIGDIR}"
 #define ICINGA_DATADIR "${ICINGA2_FULL_DATADIR}"
 #define ICINGA_LOGDIR "${ICINGA2_FULL_LOGDIR}"
@@ -105,6 +105,8 @@ void Application::Exit(int rc)
 	std::cout.flush();
 	std::cerr.flush();
 
+	Logger::StopLogWriter();
+
 	for (const Logger::Ptr& logger : Logger::GetLoggers()) {
 		logger->Flush();
 	}
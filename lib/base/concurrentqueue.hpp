@@ -0,0 +1,177 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CONCURRENTQUEUE_H
+#define CONCURRENTQUEUE_H
+
+#include "base/i2-base.hpp"
+#include "base/debug.hpp"
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <deque>
+#include <memory>
+
+namespace icinga
+{
+
+/**
+ * A multi-producer multi-consumer FIFO queue.
+ *
+ * Items are stored in a bounded lock-free ring buffer (Dmitry Vyukov's
+ * MPMC queue) so that producers and consumers don't have to share a
+ * mutex. When the ring is full items spill over into a mutex-protected
+ * deque; as long as that deque isn't empty new items go there as well
+ * so that items from the same producer are still dequeued in order.
+ *
+ * @ingroup base
+ */
+template<typename T>
+class ConcurrentQueue
+{
+public:
+	/**
+	 * @param ringSize The number of slots in the ring buffer, must be a power of two.
+	 */
+	ConcurrentQueue(size_t ringSize = 1024)
+		: m_Mask(ringSize - 1), m_Ring(new Cell[ringSize])
+	{
+		VERIFY((ringSize & m_Mask) == 0);
+
+		for (size_t i = 0; i < ringSize; i++)
+			m_Ring[i].Sequence.store(i, std::memory_order_relaxed);
+	}
+
+	ConcurrentQueue(const ConcurrentQueue&) = delete;
+	ConcurrentQueue& operator=(const ConcurrentQueue&) = delete;
+
+	void Push(T&& item)
+	{
+		if (m_OverflowCount.load() == 0 && TryPushRing(item))
+			return;
+
+		boost::mutex::scoped_lock lock(m_OverflowMutex);
+		m_Overflow.emplace_back(std::move(item));
+		m_OverflowCount.fetch_add(1);
+	}
+
+	void Push(const T& item)
+	{
+		Push(T(item));
+	}
+
+	/**
+	 * Removes the oldest item from the queue.
+	 *
+	 * @param item Receives the item.
+	 * @returns true if an item was dequeued, false if the queue was empty.
+	 */
+	bool Pop(T& item)
+	{
+		if (TryPopRing(item))
+			return true;
+
+		if (m_OverflowCount.load() == 0)
+			return false;
+
+		boost::mutex::scoped_lock lock(m_OverflowMutex);
+
+		if (m_Overflow.empty())
+			return false;
+
+		item = std::move(m_Overflow.front());
+		m_Overflow.pop_front();
+		m_OverflowCount.fetch_sub(1);
+
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> Sequence;
+		T Item;
+	};
+
+	size_t m_Mask;
+	std::unique_ptr<Cell[]> m_Ring;
+	std::atomic<size_t> m_EnqueuePos{0};
+	std::atomic<size_t> m_DequeuePos{0};
+
+	boost::mutex m_OverflowMutex;
+	std::deque<T> m_Overflow;
+	std::atomic<size_t> m_OverflowCount{0};
+
+	bool TryPushRing(T& item)
+	{
+		size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+		Cell *cell;
+
+		for (;;) {
+			cell = &m_Ring[pos & m_Mask];
+			size_t seq = cell->Sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+			if (diff == 0) {
+				if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0)
+				return false;
+			else
+				pos = m_EnqueuePos.load(std::memory_order_relaxed);
+		}
+
+		cell->Item = std::move(item);
+		cell->Sequence.store(pos + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	bool TryPopRing(T& item)
+	{
+		size_t pos = m_DequeuePos.load(std::memory_order_relaxed);
+		Cell *cell;
+
+		for (;;) {
+			cell = &m_Ring[pos & m_Mask];
+			size_t seq = cell->Sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+			if (diff == 0) {
+				if (m_DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0)
+				return false;
+			else
+				pos = m_DequeuePos.load(std::memory_order_relaxed);
+		}
+
+		item = std::move(cell->Item);
+
+		/* Release whatever resources the moved-from item still holds. */
+		cell->Item = T();
+
+		cell->Sequence.store(pos + m_Mask + 1, std::memory_order_release);
+
+		return true;
+	}
+};
+
+}
+
+#endif /* CONCURRENTQUEUE_H */
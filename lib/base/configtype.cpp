@@ -60,6 +60,8 @@ void ConfigType::RegisterObject(const ConfigObject::Ptr& object)
 
 		m_ObjectMap[name] = object;
 		m_ObjectVector.push_back(object);
+
+		std::atomic_store(&m_Snapshot, std::shared_ptr<const Snapshot>());
 	}
 }
 
@@ -72,6 +74,8 @@ void ConfigType::UnregisterObject(const ConfigObject::Ptr& object)
 
 		m_ObjectMap.erase(name);
 		m_ObjectVector.erase(std::remove(m_ObjectVector.begin(), m_ObjectVector.end(), object), m_ObjectVector.end());
+
+		std::atomic_store(&m_Snapshot, std::shared_ptr<const Snapshot>());
 	}
 }
 
@@ -81,9 +85,51 @@ std::vector<ConfigObject::Ptr> ConfigType::GetObjects() const
 	return m_ObjectVector;
 }
 
-std::vector<ConfigObject::Ptr> ConfigType::GetObjectsHelper(Type *type)
+/**
+ * Returns the registered objects which have not been activated yet or
+ * which are being deactivated.
+ */
+std::vector<ConfigObject::Ptr> ConfigType::GetInactiveObjects() const
+{
+	std::vector<ConfigObject::Ptr> objects;
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	for (const ConfigObject::Ptr& object : m_ObjectVector) {
+		if (!object->IsActive())
+			objects.push_back(object);
+	}
+
+	return objects;
+}
+
+/**
+ * Returns the specified objects in the order in which they were registered.
+ * Objects which are not registered for this type are skipped.
+ */
+std::vector<ConfigObject::Ptr> ConfigType::GetObjects(const std::set<ConfigObject::Ptr>& objects) const
+{
+	std::vector<ConfigObject::Ptr> result;
+	result.reserve(objects.size());
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	for (const ConfigObject::Ptr& object : m_ObjectVector) {
+		if (objects.find(object) == objects.end())
+			continue;
+
+		result.push_back(object);
+
+		if (result.size() == objects.size())
+			break;
+	}
+
+	return result;
+}
+
+ConfigType *ConfigType::GetConfigType(Type *type)
 {
-	return static_cast<TypeImpl<ConfigObject> *>(type)->GetObjects();
+	return static_cast<TypeImpl<ConfigObject> *>(type);
 }
 
 int ConfigType::GetObjectCount() const
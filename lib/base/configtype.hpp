@@ -25,12 +25,56 @@
 #include "base/type.hpp"
 #include "base/dictionary.hpp"
 #include <boost/thread/mutex.hpp>
+#include <memory>
+#include <set>
 
 namespace icinga
 {
 
 class ConfigObject;
 
+/**
+ * An immutable list of the objects of a type, as returned by
+ * ConfigType::GetObjectsByType(). Objects which are created or deleted
+ * later on are not reflected in the snapshot.
+ *
+ * @ingroup base
+ */
+template<typename T>
+class ConfigObjectsSnapshot
+{
+public:
+	typedef std::vector<intrusive_ptr<T> > ObjectVector;
+	typedef typename ObjectVector::const_iterator const_iterator;
+
+	ConfigObjectsSnapshot(std::shared_ptr<const ObjectVector> objects)
+		: m_Objects(std::move(objects))
+	{ }
+
+	const_iterator begin() const
+	{
+		return m_Objects->begin();
+	}
+
+	const_iterator end() const
+	{
+		return m_Objects->end();
+	}
+
+	size_t size() const
+	{
+		return m_Objects->size();
+	}
+
+	bool empty() const
+	{
+		return m_Objects->empty();
+	}
+
+private:
+	std::shared_ptr<const ObjectVector> m_Objects;
+};
+
 class ConfigType
 {
 public:
@@ -42,6 +86,8 @@ public:
 	void UnregisterObject(const intrusive_ptr<ConfigObject>& object);
 
 	std::vector<intrusive_ptr<ConfigObject> > GetObjects() const;
+	std::vector<intrusive_ptr<ConfigObject> > GetInactiveObjects() const;
+	std::vector<intrusive_ptr<ConfigObject> > GetObjects(const std::set<intrusive_ptr<ConfigObject> >& objects) const;
 
 	template<typename T>
 	static TypeImpl<T> *Get()
@@ -51,15 +97,34 @@ public:
 	}
 
 	template<typename T>
-	static std::vector<intrusive_ptr<T> > GetObjectsByType()
+	static ConfigObjectsSnapshot<T> GetObjectsByType()
 	{
-		std::vector<intrusive_ptr<ConfigObject> > objects = GetObjectsHelper(T::TypeInstance.get());
-		std::vector<intrusive_ptr<T> > result;
-		result.reserve(objects.size());
-for (const auto& object : objects) {
-			result.push_back(static_pointer_cast<T>(object));
+		typedef TypedSnapshot<T> SnapshotType;
+
+		ConfigType *ctype = GetConfigType(T::TypeInstance.get());
+
+		/* Fast path: the snapshot is only rebuilt after objects have been created or deleted. */
+		auto snapshot = std::dynamic_pointer_cast<const SnapshotType>(std::atomic_load(&ctype->m_Snapshot));
+
+		if (!snapshot) {
+			boost::mutex::scoped_lock lock(ctype->m_Mutex);
+
+			snapshot = std::dynamic_pointer_cast<const SnapshotType>(std::atomic_load(&ctype->m_Snapshot));
+
+			if (!snapshot) {
+				auto newSnapshot = std::make_shared<SnapshotType>();
+				newSnapshot->Objects.reserve(ctype->m_ObjectVector.size());
+
+				for (const auto& object : ctype->m_ObjectVector) {
+					newSnapshot->Objects.push_back(static_pointer_cast<T>(object));
+				}
+
+				snapshot = newSnapshot;
+				std::atomic_store(&ctype->m_Snapshot, std::shared_ptr<const Snapshot>(snapshot));
+			}
 		}
-		return result;
+
+		return ConfigObjectsSnapshot<T>(std::shared_ptr<const typename SnapshotType::ObjectVector>(snapshot, &snapshot->Objects));
 	}
 
 	int GetObjectCount() const;
@@ -68,11 +133,27 @@ private:
 	typedef std::map<String, intrusive_ptr<ConfigObject> > ObjectMap;
 	typedef std::vector<intrusive_ptr<ConfigObject> > ObjectVector;
 
+	struct Snapshot
+	{
+		virtual ~Snapshot() = default;
+	};
+
+	template<typename T>
+	struct TypedSnapshot : Snapshot
+	{
+		typedef std::vector<intrusive_ptr<T> > ObjectVector;
+
+		ObjectVector Objects;
+	};
+
 	mutable boost::mutex m_Mutex;
 	ObjectMap m_ObjectMap;
 	ObjectVector m_ObjectVector;
 
-	static std::vector<intrusive_ptr<ConfigObject> > GetObjectsHelper(Type *type);
+	/* Built on demand by GetObjectsByType() and dropped whenever an object is registered or unregistered. */
+	std::shared_ptr<const Snapshot> m_Snapshot;
+
+	static ConfigType *GetConfigType(Type *type);
 };
 
 }
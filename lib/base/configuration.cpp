@@ -47,9 +47,14 @@ int Configuration::RLimitProcesses;
 int Configuration::RLimitStack;
 String Configuration::RunAsGroup;
 String Configuration::RunAsUser;
+bool Configuration::SocketIOAffinity{false};
+int Configuration::SocketIOThreads{8};
+int Configuration::SpawnHelpers{1};
+String Configuration::SpawnMethod{"fork"};
 String Configuration::SpoolDir;
 String Configuration::StatePath;
 double Configuration::TlsHandshakeTimeout{10};
+bool Configuration::TlsKernelOffload{false};
 String Configuration::VarsPath;
 String Configuration::ZonesDir;
 
@@ -290,6 +295,46 @@ void Configuration::SetRunAsUser(const String& val, bool suppress_events, const
 	HandleUserWrite("RunAsUser", &Configuration::RunAsUser, val, m_ReadOnly);
 }
 
+bool Configuration::GetSocketIOAffinity() const
+{
+	return Configuration::SocketIOAffinity;
+}
+
+void Configuration::SetSocketIOAffinity(bool val, bool suppress_events, const Value& cookie)
+{
+	HandleUserWrite("SocketIOAffinity", &Configuration::SocketIOAffinity, val, m_ReadOnly);
+}
+
+int Configuration::GetSocketIOThreads() const
+{
+	return Configuration::SocketIOThreads;
+}
+
+void Configuration::SetSocketIOThreads(int val, bool suppress_events, const Value& cookie)
+{
+	HandleUserWrite("SocketIOThreads", &Configuration::SocketIOThreads, val, m_ReadOnly);
+}
+
+int Configuration::GetSpawnHelpers() const
+{
+	return Configuration::SpawnHelpers;
+}
+
+void Configuration::SetSpawnHelpers(int val, bool suppress_events, const Value& cookie)
+{
+	HandleUserWrite("SpawnHelpers", &Configuration::SpawnHelpers, val, m_ReadOnly);
+}
+
+String Configuration::GetSpawnMethod() const
+{
+	return Configuration::SpawnMethod;
+}
+
+void Configuration::SetSpawnMethod(const String& val, bool suppress_events, const Value& cookie)
+{
+	HandleUserWrite("SpawnMethod", &Configuration::SpawnMethod, val, m_ReadOnly);
+}
+
 String Configuration::GetSpoolDir() const
 {
 	return Configuration::SpoolDir;
@@ -320,6 +365,16 @@ void Configuration::SetTlsHandshakeTimeout(double val, bool suppress_events, con
 	HandleUserWrite("TlsHandshakeTimeout", &Configuration::TlsHandshakeTimeout, val, m_ReadOnly);
 }
 
+bool Configuration::GetTlsKernelOffload() const
+{
+	return Configuration::TlsKernelOffload;
+}
+
+void Configuration::SetTlsKernelOffload(bool val, bool suppress_events, const Value& cookie)
+{
+	HandleUserWrite("TlsKernelOffload", &Configuration::TlsKernelOffload, val, m_ReadOnly);
+}
+
 String Configuration::GetVarsPath() const
 {
 	return Configuration::VarsPath;
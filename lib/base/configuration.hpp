@@ -102,6 +102,18 @@ public:
 	String GetRunAsUser() const override;
 	void SetRunAsUser(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
+	bool GetSocketIOAffinity() const override;
+	void SetSocketIOAffinity(bool value, bool suppress_events = false, const Value& cookie = Empty) override;
+
+	int GetSocketIOThreads() const override;
+	void SetSocketIOThreads(int value, bool suppress_events = false, const Value& cookie = Empty) override;
+
+	int GetSpawnHelpers() const override;
+	void SetSpawnHelpers(int value, bool suppress_events = false, const Value& cookie = Empty) override;
+
+	String GetSpawnMethod() const override;
+	void SetSpawnMethod(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
+
 	String GetSpoolDir() const override;
 	void SetSpoolDir(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
@@ -111,6 +123,9 @@ public:
 	double GetTlsHandshakeTimeout() const override;
 	void SetTlsHandshakeTimeout(double value, bool suppress_events = false, const Value& cookie = Empty) override;
 
+	bool GetTlsKernelOffload() const override;
+	void SetTlsKernelOffload(bool value, bool suppress_events = false, const Value& cookie = Empty) override;
+
 	String GetVarsPath() const override;
 	void SetVarsPath(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
@@ -152,9 +167,14 @@ public:
 	static int RLimitStack;
 	static String RunAsGroup;
 	static String RunAsUser;
+	static bool SocketIOAffinity;
+	static int SocketIOThreads;
+	static int SpawnHelpers;
+	static String SpawnMethod;
 	static String SpoolDir;
 	static String StatePath;
 	static double TlsHandshakeTimeout;
+	static bool TlsKernelOffload;
 	static String VarsPath;
 	static String ZonesDir;
 
@@ -0,0 +1,70 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef DEFER_H
+#define DEFER_H
+
+#include "base/i2-base.hpp"
+#include <functional>
+
+namespace icinga
+{
+
+/**
+ * Calls a function when it goes out of scope, e.g. to undo an earlier
+ * operation no matter whether the code in between returns or throws.
+ *
+ * @ingroup base
+ */
+class Defer
+{
+public:
+	template<class Func>
+	explicit Defer(Func func) : m_Func(std::move(func))
+	{ }
+
+	Defer(const Defer&) = delete;
+	Defer& operator=(const Defer&) = delete;
+
+	~Defer()
+	{
+		if (m_Func) {
+			try {
+				m_Func();
+			} catch (...) {
+				/* Destructors must not throw. */
+			}
+		}
+	}
+
+	/**
+	 * Makes sure the function isn't called.
+	 */
+	void Cancel()
+	{
+		m_Func = nullptr;
+	}
+
+private:
+	std::function<void()> m_Func;
+};
+
+}
+
+#endif /* DEFER_H */
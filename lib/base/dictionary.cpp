@@ -22,29 +22,62 @@
 #include "base/debug.hpp"
 #include "base/primitivetype.hpp"
 #include "base/configwriter.hpp"
+#include <algorithm>
 #include <sstream>
 
 using namespace icinga;
 
-template class std::map<String, Value>;
+template class std::vector<std::pair<String, Value> >;
 
 REGISTER_PRIMITIVE_TYPE(Dictionary, Object, Dictionary::GetPrototype());
 
 Dictionary::Dictionary(const DictionaryData& other)
+	: m_Data(other)
 {
-	for (const auto& kv : other)
-		m_Data.insert(kv);
+	SortData();
 }
 
 Dictionary::Dictionary(DictionaryData&& other)
+	: m_Data(std::move(other))
 {
-	for (auto& kv : other)
-		m_Data.insert(std::move(kv));
+	SortData();
 }
 
 Dictionary::Dictionary(std::initializer_list<Dictionary::Pair> init)
 	: m_Data(init)
-{ }
+{
+	SortData();
+}
+
+/**
+ * Sorts the items by key. If a key occurs more than once only the
+ * first item is kept.
+ */
+void Dictionary::SortData()
+{
+	auto keyLess = [](const Pair& a, const Pair& b) { return a.first < b.first; };
+
+	if (!std::is_sorted(m_Data.begin(), m_Data.end(), keyLess))
+		std::stable_sort(m_Data.begin(), m_Data.end(), keyLess);
+
+	m_Data.erase(std::unique(m_Data.begin(), m_Data.end(), [](const Pair& a, const Pair& b) { return a.first == b.first; }), m_Data.end());
+}
+
+/**
+ * Finds the item with the specified key, or the position where it would
+ * have to be inserted if there is no such item.
+ *
+ * Note: Caller must hold the object lock.
+ */
+std::vector<Dictionary::Pair>::iterator Dictionary::FindKey(const String& key)
+{
+	return std::lower_bound(m_Data.begin(), m_Data.end(), key, [](const Pair& kv, const String& key) { return kv.first < key; });
+}
+
+std::vector<Dictionary::Pair>::const_iterator Dictionary::FindKey(const String& key) const
+{
+	return std::lower_bound(m_Data.begin(), m_Data.end(), key, [](const Pair& kv, const String& key) { return kv.first < key; });
+}
 
 /**
  * Retrieves a value from a dictionary.
@@ -56,9 +89,9 @@ Value Dictionary::Get(const String& key) const
 {
 	ObjectLock olock(this);
 
-	auto it = m_Data.find(key);
+	auto it = FindKey(key);
 
-	if (it == m_Data.end())
+	if (it == m_Data.end() || it->first != key)
 		return Empty;
 
 	return it->second;
@@ -75,9 +108,9 @@ bool Dictionary::Get(const String& key, Value *result) const
 {
 	ObjectLock olock(this);
 
-	auto it = m_Data.find(key);
+	auto it = FindKey(key);
 
-	if (it == m_Data.end())
+	if (it == m_Data.end() || it->first != key)
 		return false;
 
 	*result = it->second;
@@ -87,6 +120,10 @@ bool Dictionary::Get(const String& key, Value *result) const
 /**
  * Sets a value in the dictionary.
  *
+ * Keys which sort after all existing keys are appended. Any other new key
+ * has to be inserted in the middle, which takes linear time. Use the
+ * DictionaryData constructor to build large dictionaries in arbitrary order.
+ *
  * @param key The key.
  * @param value The value.
  * @param overrideFrozen Whether to allow modifying frozen dictionaries.
@@ -98,7 +135,22 @@ void Dictionary::Set(const String& key, Value value, bool overrideFrozen)
 	if (m_Frozen && !overrideFrozen)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Value in dictionary must not be modified."));
 
-	m_Data[key] = std::move(value);
+	/* Skip the first few re-allocations, most dictionaries have more than one item. */
+	if (m_Data.capacity() == 0)
+		m_Data.reserve(8);
+
+	/* Appending is the common case when dictionaries are built in order. */
+	if (m_Data.empty() || m_Data.back().first < key) {
+		m_Data.emplace_back(key, std::move(value));
+		return;
+	}
+
+	auto it = FindKey(key);
+
+	if (it != m_Data.end() && it->first == key)
+		it->second = std::move(value);
+	else
+		m_Data.emplace(it, key, std::move(value));
 }
 
 /**
@@ -123,7 +175,9 @@ bool Dictionary::Contains(const String& key) const
 {
 	ObjectLock olock(this);
 
-	return (m_Data.find(key) != m_Data.end());
+	auto it = FindKey(key);
+
+	return (it != m_Data.end() && it->first == key);
 }
 
 /**
@@ -137,7 +191,7 @@ Dictionary::Iterator Dictionary::Begin()
 {
 	ASSERT(OwnsLock());
 
-	return m_Data.begin();
+	return m_Data.cbegin();
 }
 
 /**
@@ -151,7 +205,7 @@ Dictionary::Iterator Dictionary::End()
 {
 	ASSERT(OwnsLock());
 
-	return m_Data.end();
+	return m_Data.cend();
 }
 
 /**
@@ -183,10 +237,9 @@ void Dictionary::Remove(const String& key, bool overrideFrozen)
 	if (m_Frozen && !overrideFrozen)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
 
-	Dictionary::Iterator it;
-	it = m_Data.find(key);
+	auto it = FindKey(key);
 
-	if (it == m_Data.end())
+	if (it == m_Data.end() || it->first != key)
 		return;
 
 	m_Data.erase(it);
@@ -262,6 +315,7 @@ std::vector<String> Dictionary::GetKeys() const
 	ObjectLock olock(this);
 
 	std::vector<String> keys;
+	keys.reserve(m_Data.size());
 
 	for (const Dictionary::Pair& kv : m_Data) {
 		keys.push_back(kv.first);
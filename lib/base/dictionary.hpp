@@ -42,14 +42,15 @@ class Dictionary final : public Object
 public:
 	DECLARE_OBJECT(Dictionary);
 
+	typedef std::pair<String, Value> Pair;
+
 	/**
 	 * An iterator that can be used to iterate over dictionary elements.
+	 * Items are kept sorted by key, so they can't be modified in place.
 	 */
-	typedef std::map<String, Value>::iterator Iterator;
-
-	typedef std::map<String, Value>::size_type SizeType;
+	typedef std::vector<Pair>::const_iterator Iterator;
 
-	typedef std::map<String, Value>::value_type Pair;
+	typedef std::vector<Pair>::size_type SizeType;
 
 	Dictionary() = default;
 	Dictionary(const DictionaryData& other);
@@ -91,8 +92,16 @@ public:
 	bool GetOwnField(const String& field, Value *result) const override;
 
 private:
-	std::map<String, Value> m_Data; /**< The data for the dictionary. */
+	/* Sorted by key. Most dictionaries only have a handful of items, a
+	 * contiguous array beats a tree for lookups and iteration at that size.
+	 * Inserting a key which doesn't sort last moves all items after it; large
+	 * dictionaries should be built from a DictionaryData vector instead. */
+	std::vector<Pair> m_Data; /**< The data for the dictionary. */
 	bool m_Frozen{false};
+
+	std::vector<Pair>::iterator FindKey(const String& key);
+	std::vector<Pair>::const_iterator FindKey(const String& key) const;
+	void SortData();
 };
 
 Dictionary::Iterator begin(const Dictionary::Ptr& x);
@@ -100,6 +109,6 @@ Dictionary::Iterator end(const Dictionary::Ptr& x);
 
 }
 
-extern template class std::map<icinga::String, icinga::Value>;
+extern template class std::vector<std::pair<icinga::String, icinga::Value> >;
 
 #endif /* DICTIONARY_H */
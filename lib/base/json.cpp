@@ -24,363 +24,816 @@
 #include "base/array.hpp"
 #include "base/objectlock.hpp"
 #include "base/convert.hpp"
-#include <boost/exception_ptr.hpp>
-#include <yajl/yajl_version.h>
-#include <yajl/yajl_gen.h>
-#include <yajl/yajl_parse.h>
-#include <stack>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
 
 using namespace icinga;
 
-static void Encode(yajl_gen handle, const Value& value);
-
-#if YAJL_MAJOR < 2
-typedef unsigned int yajl_size;
-#else /* YAJL_MAJOR */
-typedef size_t yajl_size;
-#endif /* YAJL_MAJOR */
+namespace
+{
 
-static void EncodeNamespace(yajl_gen handle, const Namespace::Ptr& ns)
+/**
+ * Writes JSON directly into a std::string, without going through yajl's
+ * generator state machine and its intermediate buffer. The output is
+ * compatible with what yajl_gen produced.
+ */
+class JsonEncoder
 {
-	yajl_gen_map_open(handle);
+public:
+	JsonEncoder(std::string& output, bool pretty_print)
+		: m_Output(output), m_PrettyPrint(pretty_print)
+	{ }
+
+	void Encode(const Value& value, int depth = 0)
+	{
+		EncodeValue(value, depth);
 
-	ObjectLock olock(ns);
-	for (const Namespace::Pair& kv : ns) {
-		yajl_gen_string(handle, reinterpret_cast<const unsigned char *>(kv.first.CStr()), kv.first.GetLength());
-		Encode(handle, kv.second->Get());
+		if (m_PrettyPrint && depth == 0)
+			m_Output += '\n';
 	}
 
-	yajl_gen_map_close(handle);
-}
+private:
+	std::string& m_Output;
+	bool m_PrettyPrint;
 
-static void EncodeDictionary(yajl_gen handle, const Dictionary::Ptr& dict)
-{
-	yajl_gen_map_open(handle);
+	void Indent(int depth)
+	{
+		m_Output.append(depth * 4, ' ');
+	}
+
+	void EncodeValue(const Value& value, int depth)
+	{
+		switch (value.GetType()) {
+			case ValueNumber:
+				EncodeNumber(value.Get<double>());
+
+				break;
+			case ValueBoolean:
+				if (value.ToBool())
+					m_Output.append("true", 4);
+				else
+					m_Output.append("false", 5);
+
+				break;
+			case ValueString:
+				EncodeString(static_cast<String>(value));
+
+				break;
+			case ValueObject:
+				{
+					const Object::Ptr& obj = value.Get<Object::Ptr>();
+					Namespace::Ptr ns = dynamic_pointer_cast<Namespace>(obj);
+
+					if (ns) {
+						EncodeNamespace(ns, depth);
+						break;
+					}
+
+					Dictionary::Ptr dict = dynamic_pointer_cast<Dictionary>(obj);
+
+					if (dict) {
+						EncodeDictionary(dict, depth);
+						break;
+					}
+
+					Array::Ptr arr = dynamic_pointer_cast<Array>(obj);
+
+					if (arr) {
+						EncodeArray(arr, depth);
+						break;
+					}
+				}
+
+				m_Output.append("null", 4);
+
+				break;
+			case ValueEmpty:
+				m_Output.append("null", 4);
 
-	ObjectLock olock(dict);
-	for (const Dictionary::Pair& kv : dict) {
-		yajl_gen_string(handle, reinterpret_cast<const unsigned char *>(kv.first.CStr()), kv.first.GetLength());
-		Encode(handle, kv.second);
+				break;
+			default:
+				VERIFY(!"Invalid variant type.");
+		}
 	}
 
-	yajl_gen_map_close(handle);
-}
+	void EncodeNumber(double value)
+	{
+		/* JSON has no representation for these. */
+		if (std::isnan(value) || std::isinf(value))
+			value = 0;
+
+		/* Integers are by far the most common numbers (states, timestamps
+		 * without fractions, counters), format them without printf. Like
+		 * yajl we append ".0" so they are still recognizable as doubles.
+		 */
+		if (value > -1e15 && value < 1e15 && value == static_cast<double>(static_cast<long long>(value))) {
+			long long ival = static_cast<long long>(value);
+			unsigned long long uval = ival < 0 ? -static_cast<unsigned long long>(ival) : ival;
+
+			char buf[24];
+			char *end = buf + sizeof(buf);
+			char *pos = end;
+
+			*--pos = '0';
+			*--pos = '.';
+
+			do {
+				*--pos = '0' + uval % 10;
+				uval /= 10;
+			} while (uval > 0);
+
+			if (ival < 0 || (ival == 0 && std::signbit(value)))
+				*--pos = '-';
+
+			m_Output.append(pos, end - pos);
+			return;
+		}
 
-static void EncodeArray(yajl_gen handle, const Array::Ptr& arr)
-{
-	yajl_gen_array_open(handle);
+		/* 17 significant digits are enough for the value to survive a round-trip. */
+		char buf[32];
+		int len = snprintf(buf, sizeof(buf), "%.17g", value);
+
+		m_Output.append(buf, len);
 
-	ObjectLock olock(arr);
-	for (const Value& value : arr) {
-		Encode(handle, value);
+		if (strspn(buf, "0123456789-") == static_cast<size_t>(len))
+			m_Output.append(".0", 2);
 	}
 
-	yajl_gen_array_close(handle);
-}
+	void EncodeString(const String& str)
+	{
+		const char *data = str.CStr();
+		size_t length = str.GetLength();
 
-static void Encode(yajl_gen handle, const Value& value)
-{
-	switch (value.GetType()) {
-		case ValueNumber:
-			if (yajl_gen_double(handle, value.Get<double>()) == yajl_gen_invalid_number)
-				yajl_gen_double(handle, 0);
-
-			break;
-		case ValueBoolean:
-			yajl_gen_bool(handle, value.ToBool());
-
-			break;
-		case ValueString:
-			yajl_gen_string(handle, reinterpret_cast<const unsigned char *>(value.Get<String>().CStr()), value.Get<String>().GetLength());
-
-			break;
-		case ValueObject:
-			{
-				const Object::Ptr& obj = value.Get<Object::Ptr>();
-				Namespace::Ptr ns = dynamic_pointer_cast<Namespace>(obj);
-
-				if (ns) {
-					EncodeNamespace(handle, ns);
-					break;
-				}
+		m_Output.reserve(m_Output.size() + length + 2);
+		m_Output += '"';
 
-				Dictionary::Ptr dict = dynamic_pointer_cast<Dictionary>(obj);
+		size_t begin = 0;
 
-				if (dict) {
-					EncodeDictionary(handle, dict);
-					break;
-				}
+		for (size_t i = 0; i < length; i++) {
+			unsigned char ch = data[i];
 
-				Array::Ptr arr = dynamic_pointer_cast<Array>(obj);
+			/* Most strings consist only of characters which don't need escaping. */
+			if (ch >= 0x20 && ch != '"' && ch != '\\')
+				continue;
 
-				if (arr) {
-					EncodeArray(handle, arr);
+			m_Output.append(data + begin, i - begin);
+			begin = i + 1;
+
+			switch (ch) {
+				case '"':
+					m_Output.append("\\\"", 2);
 					break;
-				}
+				case '\\':
+					m_Output.append("\\\\", 2);
+					break;
+				case '\b':
+					m_Output.append("\\b", 2);
+					break;
+				case '\f':
+					m_Output.append("\\f", 2);
+					break;
+				case '\n':
+					m_Output.append("\\n", 2);
+					break;
+				case '\r':
+					m_Output.append("\\r", 2);
+					break;
+				case '\t':
+					m_Output.append("\\t", 2);
+					break;
+				default:
+					{
+						static const char hexchars[] = "0123456789ABCDEF";
+						char escaped[] = { '\\', 'u', '0', '0', hexchars[ch >> 4], hexchars[ch & 0x0f] };
+						m_Output.append(escaped, sizeof(escaped));
+					}
 			}
+		}
+
+		m_Output.append(data + begin, length - begin);
+		m_Output += '"';
+	}
+
+	void BeginElement(bool first, int depth)
+	{
+		if (!first)
+			m_Output += ',';
+
+		if (m_PrettyPrint) {
+			m_Output += '\n';
+			Indent(depth + 1);
+		}
+	}
+
+	void EncodeKey(const String& key)
+	{
+		EncodeString(key);
+
+		if (m_PrettyPrint)
+			m_Output.append(": ", 2);
+		else
+			m_Output += ':';
+	}
+
+	void EndContainer(bool empty, int depth, char ch)
+	{
+		if (m_PrettyPrint && !empty) {
+			m_Output += '\n';
+			Indent(depth);
+		}
+
+		m_Output += ch;
+	}
+
+	void EncodeNamespace(const Namespace::Ptr& ns, int depth)
+	{
+		m_Output += '{';
+
+		bool first = true;
+
+		ObjectLock olock(ns);
+		for (const Namespace::Pair& kv : ns) {
+			BeginElement(first, depth);
+			first = false;
 
-			yajl_gen_null(handle);
+			EncodeKey(kv.first);
+			EncodeValue(kv.second->Get(), depth + 1);
+		}
+
+		EndContainer(first, depth, '}');
+	}
+
+	void EncodeDictionary(const Dictionary::Ptr& dict, int depth)
+	{
+		m_Output += '{';
+
+		bool first = true;
 
-			break;
-		case ValueEmpty:
-			yajl_gen_null(handle);
+		ObjectLock olock(dict);
+		for (const Dictionary::Pair& kv : dict) {
+			BeginElement(first, depth);
+			first = false;
+
+			EncodeKey(kv.first);
+			EncodeValue(kv.second, depth + 1);
+		}
 
-			break;
-		default:
-			VERIFY(!"Invalid variant type.");
+		EndContainer(first, depth, '}');
 	}
+
+	void EncodeArray(const Array::Ptr& arr, int depth)
+	{
+		m_Output += '[';
+
+		bool first = true;
+
+		ObjectLock olock(arr);
+		for (const Value& value : arr) {
+			BeginElement(first, depth);
+			first = false;
+
+			EncodeValue(value, depth + 1);
+		}
+
+		EndContainer(first, depth, ']');
+	}
+};
+
 }
 
+/* Per-thread scratch buffer for JsonEncode(), so that encoding a message
+ * doesn't have to grow a new buffer from scratch every time.
+ */
+static boost::thread_specific_ptr<std::string> l_JsonEncodeBuffer;
+
+/* Buffers which grew larger than this are released after use so that
+ * a single huge API response doesn't pin that memory in every thread.
+ */
+static const size_t l_JsonEncodeBufferMaxRetained = 1024 * 1024;
+
 String icinga::JsonEncode(const Value& value, bool pretty_print)
 {
-#if YAJL_MAJOR < 2
-	yajl_gen_config conf = { pretty_print, "" };
-	yajl_gen handle = yajl_gen_alloc(&conf, nullptr);
-#else /* YAJL_MAJOR */
-	yajl_gen handle = yajl_gen_alloc(nullptr);
-	if (pretty_print)
-		yajl_gen_config(handle, yajl_gen_beautify, 1);
-#endif /* YAJL_MAJOR */
+	std::string *buffer = l_JsonEncodeBuffer.get();
 
-	Encode(handle, value);
+	if (!buffer) {
+		buffer = new std::string();
+		l_JsonEncodeBuffer.reset(buffer);
+	}
 
-	const unsigned char *buf;
-	yajl_size len;
+	buffer->clear();
 
-	yajl_gen_get_buf(handle, &buf, &len);
+	JsonEncoder(*buffer, pretty_print).Encode(value);
 
-	String result = String(buf, buf + len);
+	String result = *buffer;
 
-	yajl_gen_free(handle);
+	if (buffer->capacity() > l_JsonEncodeBufferMaxRetained) {
+		buffer->clear();
+		buffer->shrink_to_fit();
+	}
 
 	return result;
 }
 
-struct JsonElement
+/**
+ * Encodes a value as JSON and appends it to an existing string. Callers
+ * which keep the output string around can use this to avoid allocating
+ * a new buffer for every message.
+ *
+ * @param value The value which should be encoded.
+ * @param output The string the JSON document is appended to.
+ * @param pretty_print Whether the output should be indented.
+ * @param depth The nesting level of the value within the document the caller
+ *		writes, used for indentation. Only values at level 0 are followed
+ *		by a newline.
+ */
+void icinga::JsonEncode(const Value& value, String& output, bool pretty_print, int depth)
+{
+	JsonEncoder(output.GetData(), pretty_print).Encode(value, depth);
+}
+
+namespace
 {
-	String Key;
-	bool KeySet{false};
-	Value EValue;
-};
 
-struct JsonContext
+/**
+ * A recursive-descent JSON decoder. Strings, numbers and containers are
+ * built directly from the input buffer: string values without escape
+ * sequences are copied once and containers are filled from a vector
+ * instead of being modified one element at a time.
+ *
+ * Like the yajl-based parser it replaces, it allows C and C++ style
+ * comments and does not validate UTF-8 in strings.
+ */
+class JsonDecoder
 {
 public:
-	void Push(const Value& value)
+	JsonDecoder(const char *data, size_t length)
+		: m_Begin(data), m_Pos(data), m_End(data + length)
+	{ }
+
+	Value Decode()
 	{
-		JsonElement element;
-		element.EValue = value;
+		Value result = DecodeValue(0);
+
+		SkipWhitespace();
+
+		if (m_Pos != m_End)
+			Fail("trailing garbage");
 
-		m_Stack.push(element);
+		return result;
 	}
 
-	JsonElement Pop()
+private:
+	/* Protects the stack against deeply nested input. */
+	static const int MaxDepth = 512;
+
+	const char *m_Begin;
+	const char *m_Pos;
+	const char *m_End;
+
+	void Fail(const char *message) const
 	{
-		JsonElement value = m_Stack.top();
-		m_Stack.pop();
-		return value;
+		std::ostringstream msgbuf;
+		msgbuf << "parse error: " << message << " at offset " << (m_Pos - m_Begin);
+		BOOST_THROW_EXCEPTION(std::invalid_argument(msgbuf.str()));
 	}
 
-	void AddValue(const Value& value)
+	void SkipWhitespace()
 	{
-		if (m_Stack.empty()) {
-			JsonElement element;
-			element.EValue = value;
-			m_Stack.push(element);
-			return;
+		while (m_Pos != m_End) {
+			switch (*m_Pos) {
+				case ' ':
+				case '\t':
+				case '\n':
+				case '\r':
+					m_Pos++;
+					break;
+				case '/':
+					SkipComment();
+					break;
+				default:
+					return;
+			}
 		}
+	}
 
-		JsonElement& element = m_Stack.top();
+	void SkipComment()
+	{
+		if (m_End - m_Pos < 2)
+			Fail("invalid comment");
 
-		if (element.EValue.IsObjectType<Dictionary>()) {
-			if (!element.KeySet) {
-				element.Key = value;
-				element.KeySet = true;
-			} else {
-				Dictionary::Ptr dict = element.EValue;
-				dict->Set(element.Key, value);
-				element.KeySet = false;
-			}
-		} else if (element.EValue.IsObjectType<Array>()) {
-			Array::Ptr arr = element.EValue;
-			arr->Add(value);
-		} else {
-			BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot add value to JSON element."));
-		}
+		if (m_Pos[1] == '/') {
+			m_Pos = std::find(m_Pos + 2, m_End, '\n');
+		} else if (m_Pos[1] == '*') {
+			const char *end = "*/";
+			const char *pos = std::search(m_Pos + 2, m_End, end, end + 2);
+
+			if (pos == m_End)
+				Fail("unterminated comment");
+
+			m_Pos = pos + 2;
+		} else
+			Fail("invalid comment");
 	}
 
-	Value GetValue() const
+	void Expect(char ch)
 	{
-		ASSERT(m_Stack.size() == 1);
-		return m_Stack.top().EValue;
+		SkipWhitespace();
+
+		if (m_Pos == m_End)
+			Fail("premature EOF");
+
+		if (*m_Pos != ch) {
+			char message[] = "expected ' '";
+			message[10] = ch;
+			Fail(message);
+		}
+
+		m_Pos++;
 	}
 
-	void SaveException()
+	void ExpectLiteral(const char *literal, size_t length)
 	{
-		m_Exception = boost::current_exception();
+		if (static_cast<size_t>(m_End - m_Pos) < length || memcmp(m_Pos, literal, length) != 0)
+			Fail("invalid literal");
+
+		m_Pos += length;
 	}
 
-	void ThrowException() const
+	Value DecodeValue(int depth)
 	{
-		if (m_Exception)
-			boost::rethrow_exception(m_Exception);
+		SkipWhitespace();
+
+		if (m_Pos == m_End)
+			Fail("premature EOF");
+
+		switch (*m_Pos) {
+			case '{':
+				return DecodeObject(depth + 1);
+			case '[':
+				return DecodeArray(depth + 1);
+			case '"':
+				return DecodeString();
+			case 't':
+				ExpectLiteral("true", 4);
+				return true;
+			case 'f':
+				ExpectLiteral("false", 5);
+				return false;
+			case 'n':
+				ExpectLiteral("null", 4);
+				return Empty;
+			default:
+				return DecodeNumber();
+		}
 	}
 
-private:
-	std::stack<JsonElement> m_Stack;
-	Value m_Key;
-	boost::exception_ptr m_Exception;
-};
+	Value DecodeObject(int depth)
+	{
+		if (depth > MaxDepth)
+			Fail("nesting too deep");
 
-static int DecodeNull(void *ctx)
-{
-	auto *context = static_cast<JsonContext *>(ctx);
+		m_Pos++;
 
-	try {
-		context->AddValue(Empty);
-	} catch (...) {
-		context->SaveException();
-		return 0;
-	}
+		DictionaryData data;
 
-	return 1;
-}
+		SkipWhitespace();
 
-static int DecodeBoolean(void *ctx, int value)
-{
-	auto *context = static_cast<JsonContext *>(ctx);
+		if (m_Pos != m_End && *m_Pos == '}') {
+			m_Pos++;
+			return new Dictionary();
+		}
+
+		for (;;) {
+			SkipWhitespace();
 
-	try {
-		context->AddValue(static_cast<bool>(value));
-	} catch (...) {
-		context->SaveException();
-		return 0;
+			if (m_Pos == m_End || *m_Pos != '"')
+				Fail("expected object key");
+
+			String key = DecodeString();
+
+			Expect(':');
+
+			data.emplace_back(std::move(key), DecodeValue(depth));
+
+			SkipWhitespace();
+
+			if (m_Pos == m_End)
+				Fail("premature EOF");
+
+			if (*m_Pos == '}') {
+				m_Pos++;
+				break;
+			}
+
+			if (*m_Pos != ',')
+				Fail("expected ',' or '}'");
+
+			m_Pos++;
+		}
+
+		/* Dictionary keeps the first of several identical keys, the last one must win. */
+		std::reverse(data.begin(), data.end());
+
+		return new Dictionary(std::move(data));
 	}
 
-	return 1;
-}
+	Value DecodeArray(int depth)
+	{
+		if (depth > MaxDepth)
+			Fail("nesting too deep");
 
-static int DecodeNumber(void *ctx, const char *str, yajl_size len)
-{
-	auto *context = static_cast<JsonContext *>(ctx);
-
-	try {
-		String jstr = String(str, str + len);
-		context->AddValue(Convert::ToDouble(jstr));
-	} catch (...) {
-		context->SaveException();
-		return 0;
+		m_Pos++;
+
+		ArrayData data;
+
+		SkipWhitespace();
+
+		if (m_Pos != m_End && *m_Pos == ']') {
+			m_Pos++;
+			return new Array();
+		}
+
+		for (;;) {
+			data.emplace_back(DecodeValue(depth));
+
+			SkipWhitespace();
+
+			if (m_Pos == m_End)
+				Fail("premature EOF");
+
+			if (*m_Pos == ']') {
+				m_Pos++;
+				break;
+			}
+
+			if (*m_Pos != ',')
+				Fail("expected ',' or ']'");
+
+			m_Pos++;
+		}
+
+		return new Array(std::move(data));
 	}
 
-	return 1;
-}
+	static int HexValue(char ch)
+	{
+		if (ch >= '0' && ch <= '9')
+			return ch - '0';
+		else if (ch >= 'a' && ch <= 'f')
+			return ch - 'a' + 10;
+		else if (ch >= 'A' && ch <= 'F')
+			return ch - 'A' + 10;
+		else
+			return -1;
+	}
 
-static int DecodeString(void *ctx, const unsigned char *str, yajl_size len)
-{
-	auto *context = static_cast<JsonContext *>(ctx);
+	unsigned int DecodeHex4()
+	{
+		if (m_End - m_Pos < 4)
+			Fail("premature EOF");
 
-	try {
-		context->AddValue(String(str, str + len));
-	} catch (...) {
-		context->SaveException();
-		return 0;
+		unsigned int result = 0;
+
+		for (int i = 0; i < 4; i++) {
+			int digit = HexValue(m_Pos[i]);
+
+			if (digit < 0)
+				Fail("invalid hex digit in unicode escape");
+
+			result = (result << 4) | digit;
+		}
+
+		m_Pos += 4;
+
+		return result;
 	}
 
-	return 1;
-}
+	static void AppendUtf8(std::string& str, unsigned int cp)
+	{
+		if (cp < 0x80) {
+			str += static_cast<char>(cp);
+		} else if (cp < 0x800) {
+			str += static_cast<char>(0xc0 | (cp >> 6));
+			str += static_cast<char>(0x80 | (cp & 0x3f));
+		} else if (cp < 0x10000) {
+			str += static_cast<char>(0xe0 | (cp >> 12));
+			str += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+			str += static_cast<char>(0x80 | (cp & 0x3f));
+		} else {
+			str += static_cast<char>(0xf0 | (cp >> 18));
+			str += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+			str += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+			str += static_cast<char>(0x80 | (cp & 0x3f));
+		}
+	}
 
-static int DecodeStartMap(void *ctx)
-{
-	auto *context = static_cast<JsonContext *>(ctx);
+	void DecodeUnicodeEscape(std::string& str)
+	{
+		unsigned int cp = DecodeHex4();
+
+		if (cp >= 0xd800 && cp <= 0xdbff) {
+			if (m_End - m_Pos >= 6 && m_Pos[0] == '\\' && m_Pos[1] == 'u') {
+				m_Pos += 2;
+
+				unsigned int low = DecodeHex4();
+
+				if (low >= 0xdc00 && low <= 0xdfff) {
+					AppendUtf8(str, 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00));
+					return;
+				}
+
+				/* Same as yajl: unpaired surrogates are replaced. */
+				str += '?';
+				AppendUtf8(str, low);
+				return;
+			}
 
-	try {
-		context->Push(new Dictionary());
-	} catch (...) {
-		context->SaveException();
-		return 0;
+			str += '?';
+			return;
+		} else if (cp >= 0xdc00 && cp <= 0xdfff) {
+			str += '?';
+			return;
+		}
+
+		AppendUtf8(str, cp);
 	}
 
-	return 1;
-}
+	String DecodeString()
+	{
+		m_Pos++;
 
-static int DecodeEndMapOrArray(void *ctx)
-{
-	auto *context = static_cast<JsonContext *>(ctx);
+		const char *start = m_Pos;
+
+		/* Fast path: strings without escape sequences are copied directly. */
+		while (m_Pos != m_End && *m_Pos != '"' && *m_Pos != '\\') {
+			if (static_cast<unsigned char>(*m_Pos) < 0x20)
+				Fail("invalid character in string");
+
+			m_Pos++;
+		}
+
+		if (m_Pos == m_End)
+			Fail("premature EOF in string");
+
+		if (*m_Pos == '"')
+			return String(start, m_Pos++);
+
+		std::string result(start, m_Pos);
+
+		for (;;) {
+			if (m_Pos == m_End)
+				Fail("premature EOF in string");
 
-	try {
-		context->AddValue(context->Pop().EValue);
-	} catch (...) {
-		context->SaveException();
-		return 0;
+			char ch = *m_Pos++;
+
+			if (ch == '"')
+				break;
+
+			if (static_cast<unsigned char>(ch) < 0x20)
+				Fail("invalid character in string");
+
+			if (ch != '\\') {
+				result += ch;
+				continue;
+			}
+
+			if (m_Pos == m_End)
+				Fail("premature EOF in string");
+
+			switch (*m_Pos++) {
+				case '"':
+					result += '"';
+					break;
+				case '\\':
+					result += '\\';
+					break;
+				case '/':
+					result += '/';
+					break;
+				case 'b':
+					result += '\b';
+					break;
+				case 'f':
+					result += '\f';
+					break;
+				case 'n':
+					result += '\n';
+					break;
+				case 'r':
+					result += '\r';
+					break;
+				case 't':
+					result += '\t';
+					break;
+				case 'u':
+					DecodeUnicodeEscape(result);
+					break;
+				default:
+					m_Pos--;
+					Fail("invalid escape sequence in string");
+			}
+		}
+
+		return String(std::move(result));
 	}
 
-	return 1;
-}
+	static bool IsDigit(char ch)
+	{
+		return ch >= '0' && ch <= '9';
+	}
 
-static int DecodeStartArray(void *ctx)
-{
-	auto *context = static_cast<JsonContext *>(ctx);
+	Value DecodeNumber()
+	{
+		const char *start = m_Pos;
+
+		if (*m_Pos == '-')
+			m_Pos++;
+
+		if (m_Pos == m_End || !IsDigit(*m_Pos))
+			Fail("invalid character");
+
+		bool integral = true;
+		int digits = 0;
+		long long mantissa = 0;
+
+		if (*m_Pos == '0') {
+			m_Pos++;
+			digits++;
+		} else {
+			while (m_Pos != m_End && IsDigit(*m_Pos)) {
+				/* Doubles are exact up to 2^53, larger numbers take the slow path.
+				 * Stop accumulating then so that the mantissa can't overflow. */
+				if (integral) {
+					mantissa = mantissa * 10 + (*m_Pos - '0');
+
+					if (++digits > 15)
+						integral = false;
+				}
+
+				m_Pos++;
+			}
+		}
+
+		if (m_Pos != m_End && *m_Pos == '.') {
+			integral = false;
+			m_Pos++;
+
+			if (m_Pos == m_End || !IsDigit(*m_Pos))
+				Fail("invalid number");
+
+			while (m_Pos != m_End && IsDigit(*m_Pos))
+				m_Pos++;
+		}
+
+		if (m_Pos != m_End && (*m_Pos == 'e' || *m_Pos == 'E')) {
+			integral = false;
+			m_Pos++;
+
+			if (m_Pos != m_End && (*m_Pos == '+' || *m_Pos == '-'))
+				m_Pos++;
+
+			if (m_Pos == m_End || !IsDigit(*m_Pos))
+				Fail("invalid number");
+
+			while (m_Pos != m_End && IsDigit(*m_Pos))
+				m_Pos++;
+		}
+
+		if (integral) {
+			double result = static_cast<double>(mantissa);
+			return *start == '-' ? -result : result;
+		}
 
-	try {
-		context->Push(new Array());
-	} catch (...) {
-		context->SaveException();
-		return 0;
+		try {
+			return boost::lexical_cast<double>(start, m_Pos - start);
+		} catch (const std::exception&) {
+			Fail("invalid number");
+			return Empty;
+		}
 	}
+};
 
-	return 1;
 }
 
 Value icinga::JsonDecode(const String& data)
 {
-	static const yajl_callbacks callbacks = {
-		DecodeNull,
-		DecodeBoolean,
-		nullptr,
-		nullptr,
-		DecodeNumber,
-		DecodeString,
-		DecodeStartMap,
-		DecodeString,
-		DecodeEndMapOrArray,
-		DecodeStartArray,
-		DecodeEndMapOrArray
-	};
-
-	yajl_handle handle;
-#if YAJL_MAJOR < 2
-	yajl_parser_config cfg = { 1, 0 };
-#endif /* YAJL_MAJOR */
-	JsonContext context;
-
-#if YAJL_MAJOR < 2
-	handle = yajl_alloc(&callbacks, &cfg, nullptr, &context);
-#else /* YAJL_MAJOR */
-	handle = yajl_alloc(&callbacks, nullptr, &context);
-	yajl_config(handle, yajl_dont_validate_strings, 1);
-	yajl_config(handle, yajl_allow_comments, 1);
-#endif /* YAJL_MAJOR */
-
-	yajl_parse(handle, reinterpret_cast<const unsigned char *>(data.CStr()), data.GetLength());
-
-#if YAJL_MAJOR < 2
-	if (yajl_parse_complete(handle) != yajl_status_ok) {
-#else /* YAJL_MAJOR */
-	if (yajl_complete_parse(handle) != yajl_status_ok) {
-#endif /* YAJL_MAJOR */
-		unsigned char *internal_err_str = yajl_get_error(handle, 1, reinterpret_cast<const unsigned char *>(data.CStr()), data.GetLength());
-		String msg = reinterpret_cast<char *>(internal_err_str);
-		yajl_free_error(handle, internal_err_str);
-
-		yajl_free(handle);
-
-		/* throw saved exception (if there is one) */
-		context.ThrowException();
-
-		BOOST_THROW_EXCEPTION(std::invalid_argument(msg));
-	}
-
-	yajl_free(handle);
+	return JsonDecode(data.CStr(), data.GetLength());
+}
 
-	return context.GetValue();
+/**
+ * Decodes a JSON document from a buffer, without having to copy it into
+ * a String first.
+ *
+ * @param data The JSON document.
+ * @param length The length of the document in bytes.
+ * @returns The decoded value.
+ */
+Value icinga::JsonDecode(const char *data, size_t length)
+{
+	return JsonDecoder(data, length).Decode();
 }
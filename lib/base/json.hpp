@@ -29,7 +29,9 @@ class String;
 class Value;
 
 String JsonEncode(const Value& value, bool pretty_print = false);
+void JsonEncode(const Value& value, String& output, bool pretty_print = false, int depth = 0);
 Value JsonDecode(const String& data);
+Value JsonDecode(const char *data, size_t length);
 
 }
 
@@ -26,7 +26,13 @@
 #include "base/objectlock.hpp"
 #include "base/context.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/concurrentqueue.hpp"
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/tss.hpp>
+#include <atomic>
 #include <iostream>
+#include <thread>
 
 using namespace icinga;
 
@@ -48,13 +54,201 @@ bool Logger::m_ConsoleLogEnabled = true;
 bool Logger::m_TimestampEnabled = true;
 LogSeverity Logger::m_ConsoleLogSeverity = LogInformation;
 
-INITIALIZE_ONCE([]() {
+/* The lowest severity any logger (or the console) is interested in. */
+static std::atomic<int> l_MinLogSeverity(LogInformation);
+
+namespace
+{
+
+/**
+ * A log entry waiting to be written by the log writer thread.
+ */
+struct QueuedLogEntry
+{
+	LogEntry Entry;
+	bool Console; /**< Whether to write the entry to the console, decided when it was logged. */
+};
+
+/**
+ * Message buffers which are re-used by the Log objects of one thread.
+ */
+struct LogBufferCache
+{
+	std::vector<std::unique_ptr<std::ostringstream> > Buffers;
+};
+
+}
+
+static const int l_LogQueueLimit = 65536;
+
+static ConcurrentQueue<QueuedLogEntry> l_LogQueue(4096);
+static std::atomic<int> l_LogPending(0);
+
+/* Serializes writing entries to the loggers so they're written in the same
+ * order they were queued. Recursive because loggers may log themselves. */
+static boost::recursive_mutex l_LogWriterMutex;
+
+static boost::mutex l_LogWriterIdleMutex;
+static boost::condition_variable l_LogWriterCV;
+static std::thread l_LogWriterThread;
+static bool l_LogWriterStopped = false;
+static std::atomic<bool> l_LogWriterRunning(false);
+static std::atomic<bool> l_LogWriterStopping(false);
+static std::atomic<bool> l_LogWriterIdle(false);
+
+static boost::thread_specific_ptr<LogBufferCache> l_LogBuffers;
+
+INITIALIZE_ONCE(&Logger::StaticInitialize);
+
+static void WriteLogEntry(const QueuedLogEntry& qentry, const std::set<Logger::Ptr>& loggers)
+{
+	const LogEntry& entry = qentry.Entry;
+
+	for (const Logger::Ptr& logger : loggers) {
+		ObjectLock llock(logger);
+
+		if (!logger->IsActive())
+			continue;
+
+		if (entry.Severity >= logger->GetMinSeverity())
+			logger->ProcessLogEntry(entry);
+
+#ifdef I2_DEBUG /* I2_DEBUG */
+		/* Always flush, don't depend on the timer. Enable this for development sprints. */
+		//logger->Flush();
+#endif /* I2_DEBUG */
+	}
+
+	if (qentry.Console) {
+		StreamLogger::ProcessLogEntry(std::cout, entry);
+
+		/* "Console" might be a pipe/socket (systemd, daemontools, docker, ...),
+		 * then cout will not flush lines automatically. */
+		std::cout << std::flush;
+	}
+}
+
+/**
+ * Writes all queued log entries.
+ */
+static void ProcessLogQueue()
+{
+	boost::recursive_mutex::scoped_lock lock(l_LogWriterMutex);
+
+	std::set<Logger::Ptr> loggers = Logger::GetLoggers();
+	QueuedLogEntry qentry;
+
+	while (l_LogQueue.Pop(qentry)) {
+		l_LogPending.fetch_sub(1);
+		WriteLogEntry(qentry, loggers);
+	}
+}
+
+static void LogWriterThreadProc()
+{
+	Utility::SetThreadName("Log Writer");
+
+	for (;;) {
+		{
+			boost::mutex::scoped_lock lock(l_LogWriterIdleMutex);
+
+			l_LogWriterIdle.store(true);
+
+			while (l_LogPending.load() <= 0 && !l_LogWriterStopping.load())
+				l_LogWriterCV.wait(lock);
+
+			l_LogWriterIdle.store(false);
+		}
+
+		ProcessLogQueue();
+
+		if (l_LogWriterStopping.load() && l_LogPending.load() <= 0)
+			break;
+	}
+}
+
+static void StartLogWriter()
+{
+	boost::mutex::scoped_lock lock(l_LogWriterIdleMutex);
+
+	if (l_LogWriterRunning.load() || l_LogWriterStopped)
+		return;
+
+	l_LogWriterThread = std::thread(&LogWriterThreadProc);
+	l_LogWriterRunning.store(true);
+}
+
+/**
+ * Hands a log entry to the log writer thread. Critical messages are written
+ * before this function returns, e.g. because the process is about to crash.
+ */
+static void QueueLogEntry(QueuedLogEntry&& qentry)
+{
+	bool sync = qentry.Entry.Severity >= LogCritical || !l_LogWriterRunning.load();
+
+	l_LogQueue.Push(std::move(qentry));
+	int pending = l_LogPending.fetch_add(1) + 1;
+
+	/* Don't let the queue grow without bounds if the loggers can't keep up. */
+	if (sync || pending > l_LogQueueLimit) {
+		ProcessLogQueue();
+		return;
+	}
+
+	if (l_LogWriterIdle.load()) {
+		boost::mutex::scoped_lock lock(l_LogWriterIdleMutex);
+		l_LogWriterCV.notify_one();
+	}
+}
+
+static std::ostringstream *AcquireLogBuffer()
+{
+	LogBufferCache *cache = l_LogBuffers.get();
+
+	if (!cache || cache->Buffers.empty())
+		return new std::ostringstream();
+
+	std::ostringstream *buffer = cache->Buffers.back().release();
+	cache->Buffers.pop_back();
+	return buffer;
+}
+
+static void ReleaseLogBuffer(std::ostringstream *buffer)
+{
+	LogBufferCache *cache = l_LogBuffers.get();
+
+	if (!cache) {
+		cache = new LogBufferCache();
+		l_LogBuffers.reset(cache);
+	}
+
+	/* Log objects are rarely nested, a few buffers per thread are enough. */
+	if (cache->Buffers.size() >= 4) {
+		delete buffer;
+		return;
+	}
+
+	/* Reset the contents and any formatting the caller might have used while keeping the memory. */
+	buffer->str(std::string());
+	buffer->clear();
+	buffer->flags(std::ios_base::dec | std::ios_base::skipws);
+	buffer->precision(6);
+	buffer->width(0);
+	buffer->fill(' ');
+
+	cache->Buffers.emplace_back(buffer);
+}
+
+void Logger::StaticInitialize()
+{
 	ScriptGlobal::Set("System.LogDebug", LogDebug, true);
 	ScriptGlobal::Set("System.LogNotice", LogNotice, true);
 	ScriptGlobal::Set("System.LogInformation", LogInformation, true);
 	ScriptGlobal::Set("System.LogWarning", LogWarning, true);
 	ScriptGlobal::Set("System.LogCritical", LogCritical, true);
-});
+
+	OnSeverityChanged.connect([](const Logger::Ptr&, const Value&) { UpdateMinLogSeverity(); });
+}
 
 /**
  * Constructor for the Logger class.
@@ -63,8 +257,15 @@ void Logger::Start(bool runtimeCreated)
 {
 	ObjectImpl<Logger>::Start(runtimeCreated);
 
-	boost::mutex::scoped_lock lock(m_Mutex);
-	m_Loggers.insert(this);
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Loggers.insert(this);
+	}
+
+	UpdateMinLogSeverity();
+
+	/* Config objects are only activated after the daemon has forked, it's safe to start a thread now. */
+	StartLogWriter();
 }
 
 void Logger::Stop(bool runtimeRemoved)
@@ -74,6 +275,8 @@ void Logger::Stop(bool runtimeRemoved)
 		m_Loggers.erase(this);
 	}
 
+	UpdateMinLogSeverity();
+
 	ObjectImpl<Logger>::Stop(runtimeRemoved);
 }
 
@@ -151,11 +354,13 @@ LogSeverity Logger::StringToSeverity(const String& severity)
 void Logger::DisableConsoleLog()
 {
 	m_ConsoleLogEnabled = false;
+	UpdateMinLogSeverity();
 }
 
 void Logger::EnableConsoleLog()
 {
 	m_ConsoleLogEnabled = true;
+	UpdateMinLogSeverity();
 }
 
 bool Logger::IsConsoleLogEnabled()
@@ -166,6 +371,7 @@ bool Logger::IsConsoleLogEnabled()
 void Logger::SetConsoleLogSeverity(LogSeverity logSeverity)
 {
 	m_ConsoleLogSeverity = logSeverity;
+	UpdateMinLogSeverity();
 }
 
 LogSeverity Logger::GetConsoleLogSeverity()
@@ -188,6 +394,56 @@ bool Logger::IsTimestampEnabled()
 	return m_TimestampEnabled;
 }
 
+/**
+ * Checks whether any logger would write messages with the specified
+ * severity. This is cheap enough to be done for every message.
+ *
+ * @param severity The severity.
+ */
+bool Logger::IsSeverityEnabled(LogSeverity severity)
+{
+	return severity >= l_MinLogSeverity.load(std::memory_order_relaxed);
+}
+
+void Logger::UpdateMinLogSeverity()
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	int minSeverity = m_ConsoleLogEnabled ? m_ConsoleLogSeverity : LogCritical;
+
+	for (const Logger::Ptr& logger : m_Loggers)
+		minSeverity = std::min<int>(minSeverity, logger->GetMinSeverity());
+
+	l_MinLogSeverity.store(minSeverity);
+}
+
+/**
+ * Stops the log writer thread after it has written all queued messages.
+ * Messages which are logged afterwards are written synchronously.
+ */
+void Logger::StopLogWriter()
+{
+	{
+		boost::mutex::scoped_lock lock(l_LogWriterIdleMutex);
+
+		if (!l_LogWriterRunning.load())
+			return;
+
+		l_LogWriterStopped = true;
+		l_LogWriterRunning.store(false);
+		l_LogWriterStopping.store(true);
+		l_LogWriterCV.notify_all();
+	}
+
+	if (l_LogWriterThread.get_id() != std::this_thread::get_id())
+		l_LogWriterThread.join();
+	else
+		l_LogWriterThread.detach();
+
+	/* Write messages which were queued while the writer was shutting down. */
+	ProcessLogQueue();
+}
+
 void Logger::ValidateSeverity(const Lazy<String>& lvalue, const ValidationUtils& utils)
 {
 	ObjectImpl<Logger>::ValidateSeverity(lvalue, utils);
@@ -200,25 +456,39 @@ void Logger::ValidateSeverity(const Lazy<String>& lvalue, const ValidationUtils&
 }
 
 Log::Log(LogSeverity severity, String facility, const String& message)
-	: m_Severity(severity), m_Facility(std::move(facility))
+	: m_Severity(severity), m_Facility(std::move(facility)), m_Buffer(nullptr)
 {
-	m_Buffer << message;
+	if (!Logger::IsSeverityEnabled(severity))
+		return;
+
+	m_Buffer = AcquireLogBuffer();
+	*m_Buffer << message;
 }
 
 Log::Log(LogSeverity severity, String facility)
-	: m_Severity(severity), m_Facility(std::move(facility))
-{ }
+	: m_Severity(severity), m_Facility(std::move(facility)), m_Buffer(nullptr)
+{
+	if (Logger::IsSeverityEnabled(severity))
+		m_Buffer = AcquireLogBuffer();
+}
 
 /**
- * Writes the message to the application's log.
+ * Queues the message for the application's log.
  */
 Log::~Log()
 {
-	LogEntry entry;
+	if (!m_Buffer)
+		return;
+
+	QueuedLogEntry qentry;
+
+	LogEntry& entry = qentry.Entry;
 	entry.Timestamp = Utility::GetTime();
 	entry.Severity = m_Severity;
-	entry.Facility = m_Facility;
-	entry.Message = m_Buffer.str();
+	entry.Facility = std::move(m_Facility);
+	entry.Message = m_Buffer->str();
+
+	ReleaseLogBuffer(m_Buffer);
 
 	if (m_Severity >= LogWarning) {
 		ContextTrace context;
@@ -230,32 +500,15 @@ Log::~Log()
 		}
 	}
 
-	for (const Logger::Ptr& logger : Logger::GetLoggers()) {
-		ObjectLock llock(logger);
-
-		if (!logger->IsActive())
-			continue;
-
-		if (entry.Severity >= logger->GetMinSeverity())
-			logger->ProcessLogEntry(entry);
-
-#ifdef I2_DEBUG /* I2_DEBUG */
-		/* Always flush, don't depend on the timer. Enable this for development sprints. */
-		//logger->Flush();
-#endif /* I2_DEBUG */
-	}
-
-	if (Logger::IsConsoleLogEnabled() && entry.Severity >= Logger::GetConsoleLogSeverity()) {
-		StreamLogger::ProcessLogEntry(std::cout, entry);
+	qentry.Console = Logger::IsConsoleLogEnabled() && entry.Severity >= Logger::GetConsoleLogSeverity();
 
-		/* "Console" might be a pipe/socket (systemd, daemontools, docker, ...),
-		 * then cout will not flush lines automatically. */
-		std::cout << std::flush;
-	}
+	QueueLogEntry(std::move(qentry));
 }
 
 Log& Log::operator<<(const char *val)
 {
-	m_Buffer << val;
+	if (m_Buffer)
+		*m_Buffer << val;
+
 	return *this;
 }
@@ -64,6 +64,8 @@ class Logger : public ObjectImpl<Logger>
 public:
 	DECLARE_OBJECT(Logger);
 
+	static void StaticInitialize();
+
 	static String SeverityToString(LogSeverity severity);
 	static LogSeverity StringToSeverity(const String& severity);
 
@@ -91,6 +93,10 @@ public:
 	static void SetConsoleLogSeverity(LogSeverity logSeverity);
 	static LogSeverity GetConsoleLogSeverity();
 
+	static bool IsSeverityEnabled(LogSeverity severity);
+
+	static void StopLogWriter();
+
 	void ValidateSeverity(const Lazy<String>& lvalue, const ValidationUtils& utils) final;
 
 protected:
@@ -103,6 +109,8 @@ private:
 	static bool m_ConsoleLogEnabled;
 	static bool m_TimestampEnabled;
 	static LogSeverity m_ConsoleLogSeverity;
+
+	static void UpdateMinLogSeverity();
 };
 
 class Log
@@ -120,7 +128,9 @@ public:
 	template<typename T>
 	Log& operator<<(const T& val)
 	{
-		m_Buffer << val;
+		if (m_Buffer)
+			*m_Buffer << val;
+
 		return *this;
 	}
 
@@ -129,7 +139,7 @@ public:
 private:
 	LogSeverity m_Severity;
 	String m_Facility;
-	std::ostringstream m_Buffer;
+	std::ostringstream *m_Buffer; /**< Thread-local buffer, nullptr if nobody is interested in this message. */
 };
 
 extern template Log& Log::operator<<(const Value&);
@@ -193,7 +193,7 @@ static void PackAny(const Value& value, StringBuilder& builder)
 	switch (value.GetType()) {
 		case ValueString:
 			builder.emplace_back(4);
-			PackString(value.Get<String>(), builder);
+			PackString(static_cast<String>(value), builder);
 			break;
 
 		case ValueNumber:
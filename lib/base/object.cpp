@@ -25,8 +25,8 @@
 #include "base/timer.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
+#include "base/objectlock.hpp"
 #include <boost/lexical_cast.hpp>
-#include <boost/thread/recursive_mutex.hpp>
 
 using namespace icinga;
 
@@ -43,7 +43,7 @@ static Timer::Ptr l_ObjectCountTimer;
  */
 Object::~Object()
 {
-	delete reinterpret_cast<boost::recursive_mutex *>(m_Mutex);
+	delete reinterpret_cast<ObjectMutex *>(m_Mutex);
 }
 
 /**
@@ -18,13 +18,297 @@
  ******************************************************************************/
 
 #include "base/objectlock.hpp"
-#include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#ifdef __linux__
+#	include <linux/futex.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif /* __linux__ */
+#ifdef ICINGA2_LOCK_PROFILING
+#	include "base/configobject.hpp"
+#	include "base/perfdatavalue.hpp"
+#	include "base/statsfunction.hpp"
+#	include <algorithm>
+#	include <chrono>
+#	include <map>
+#endif /* ICINGA2_LOCK_PROFILING */
 
 using namespace icinga;
 
 #define I2MUTEX_UNLOCKED 0
 #define I2MUTEX_LOCKED 1
 
+#ifndef SPIN_PAUSE
+#	if defined(_MSC_VER)
+#		define SPIN_PAUSE() YieldProcessor()
+#	elif defined(__i386__) || defined(__x86_64__)
+#		define SPIN_PAUSE() __builtin_ia32_pause()
+#	elif defined(__aarch64__) || defined(__arm__)
+#		define SPIN_PAUSE() __asm__ __volatile__("yield")
+#	endif
+#endif /* SPIN_PAUSE */
+
+/* Number of times ObjectMutex::Lock() polls the lock before parking. Lock
+ * hold times are typically short (a few field updates), so this is enough
+ * to cover most of them without burning a full scheduler quantum. */
+static const int l_ObjectMutexSpinCount = 100;
+
+#ifndef __linux__
+/* Parking lot for platforms without futexes: waiters block on one of a
+ * fixed number of condition variables, chosen by the mutex address. */
+struct ObjectMutexParkingLot
+{
+	boost::mutex Mutex;
+	boost::condition_variable CV;
+};
+
+static ObjectMutexParkingLot l_ObjectMutexParkingLots[64];
+
+static ObjectMutexParkingLot& GetParkingLot(const void *mtx)
+{
+	return l_ObjectMutexParkingLots[(reinterpret_cast<uintptr_t>(mtx) >> 4) % 64];
+}
+#endif /* __linux__ */
+
+static inline uintptr_t GetCurrentThreadTag()
+{
+#ifdef _WIN32
+	return GetCurrentThreadId();
+#else /* _WIN32 */
+	return (uintptr_t)pthread_self();
+#endif /* _WIN32 */
+}
+
+#ifdef ICINGA2_LOCK_PROFILING
+struct LockContention
+{
+	unsigned long Count{0};
+	double WaitTime{0};
+	double MaxWaitTime{0};
+
+	void Add(double waitTime)
+	{
+		Count++;
+		WaitTime += waitTime;
+
+		if (waitTime > MaxWaitTime)
+			MaxWaitTime = waitTime;
+	}
+
+	Dictionary::Ptr ToDictionary() const
+	{
+		return new Dictionary({
+			{ "contended", Count },
+			{ "wait_time", WaitTime },
+			{ "max_wait_time", MaxWaitTime }
+		});
+	}
+};
+
+struct ObjectContention
+{
+	String Type;
+	String Name;
+	LockContention Contention;
+};
+
+/* Upper bound for the number of objects tracked individually. When it is
+ * reached the least contended half is dropped. */
+static const size_t l_MaxContendedObjects = 1024;
+
+static boost::mutex l_ContentionMutex;
+static std::map<String, LockContention> l_TypeContention;
+static std::map<const Object *, ObjectContention> l_ObjectContention;
+
+static void RecordContention(const Object *object, std::chrono::steady_clock::time_point start)
+{
+	double waitTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	/* The lock is held at this point, so it is safe to look at the object. */
+	String type = object->GetReflectionType()->GetName();
+	String name;
+
+	auto *cobj = dynamic_cast<const ConfigObject *>(object);
+
+	if (cobj)
+		name = cobj->GetName();
+
+	boost::mutex::scoped_lock lock(l_ContentionMutex);
+
+	l_TypeContention[type].Add(waitTime);
+
+	/* Object addresses may be reused after an object is freed. The names are
+	 * refreshed on every update so that the most recent owner is reported. */
+	ObjectContention& oc = l_ObjectContention[object];
+	oc.Type = std::move(type);
+	oc.Name = std::move(name);
+	oc.Contention.Add(waitTime);
+
+	if (l_ObjectContention.size() > l_MaxContendedObjects) {
+		std::vector<double> waitTimes;
+		waitTimes.reserve(l_ObjectContention.size());
+
+		for (auto& kv : l_ObjectContention)
+			waitTimes.push_back(kv.second.Contention.WaitTime);
+
+		auto median = waitTimes.begin() + waitTimes.size() / 2;
+		std::nth_element(waitTimes.begin(), median, waitTimes.end());
+		double threshold = *median;
+
+		for (auto it = l_ObjectContention.begin(); it != l_ObjectContention.end(); ) {
+			if (it->first != object && it->second.Contention.WaitTime <= threshold)
+				it = l_ObjectContention.erase(it);
+			else
+				++it;
+		}
+	}
+}
+
+static void ObjectLockStatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	DictionaryData types;
+	std::vector<ObjectContention> objects;
+	LockContention total;
+
+	{
+		boost::mutex::scoped_lock lock(l_ContentionMutex);
+
+		for (auto& kv : l_TypeContention) {
+			types.emplace_back(kv.first, kv.second.ToDictionary());
+
+			total.Count += kv.second.Count;
+			total.WaitTime += kv.second.WaitTime;
+
+			if (kv.second.MaxWaitTime > total.MaxWaitTime)
+				total.MaxWaitTime = kv.second.MaxWaitTime;
+		}
+
+		objects.reserve(l_ObjectContention.size());
+
+		for (auto& kv : l_ObjectContention)
+			objects.push_back(kv.second);
+	}
+
+	size_t top = std::min<size_t>(objects.size(), 25);
+
+	std::partial_sort(objects.begin(), objects.begin() + top, objects.end(),
+		[](const ObjectContention& a, const ObjectContention& b) { return a.Contention.WaitTime > b.Contention.WaitTime; });
+
+	ArrayData topObjects;
+
+	for (size_t i = 0; i < top; i++) {
+		Dictionary::Ptr result = objects[i].Contention.ToDictionary();
+		result->Set("type", objects[i].Type);
+		result->Set("name", objects[i].Name);
+		topObjects.push_back(result);
+	}
+
+	status->Set("objectlock", new Dictionary({
+		{ "types", new Dictionary(std::move(types)) },
+		{ "objects", new Array(std::move(topObjects)) }
+	}));
+
+	perfdata->Add(new PerfdataValue("objectlock_contended", total.Count));
+	perfdata->Add(new PerfdataValue("objectlock_wait_time", total.WaitTime));
+	perfdata->Add(new PerfdataValue("objectlock_max_wait_time", total.MaxWaitTime));
+}
+
+REGISTER_STATSFUNCTION(ObjectLock, &ObjectLockStatsFunc);
+#endif /* ICINGA2_LOCK_PROFILING */
+
+void ObjectMutex::Acquired(uintptr_t owner)
+{
+	m_Owner.store(owner, std::memory_order_relaxed);
+	m_Depth = 1;
+}
+
+bool ObjectMutex::TryLock()
+{
+	uintptr_t self = GetCurrentThreadTag();
+
+	/* Only the owning thread can observe its own tag here. */
+	if (m_Owner.load(std::memory_order_relaxed) == self) {
+		m_Depth++;
+		return true;
+	}
+
+	int state = 0;
+
+	if (!m_State.compare_exchange_strong(state, 1, std::memory_order_acquire, std::memory_order_relaxed))
+		return false;
+
+	Acquired(self);
+	return true;
+}
+
+void ObjectMutex::Lock()
+{
+	if (TryLock())
+		return;
+
+	uintptr_t self = GetCurrentThreadTag();
+	int state;
+
+	for (int i = 0; i < l_ObjectMutexSpinCount; i++) {
+#ifdef SPIN_PAUSE
+		SPIN_PAUSE();
+#endif /* SPIN_PAUSE */
+
+		state = m_State.load(std::memory_order_relaxed);
+
+		if (state == 0 && m_State.compare_exchange_weak(state, 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+			Acquired(self);
+			return;
+		}
+	}
+
+	/* Announce that there is a waiter; whoever releases the lock next has to wake us up. */
+	while (m_State.exchange(2, std::memory_order_acquire) != 0)
+		Park();
+
+	Acquired(self);
+}
+
+void ObjectMutex::Unlock()
+{
+	if (--m_Depth > 0)
+		return;
+
+	m_Owner.store(0, std::memory_order_relaxed);
+
+	if (m_State.exchange(0, std::memory_order_release) == 2)
+		Wake();
+}
+
+/**
+ * Blocks the calling thread while the lock is held and has been marked as
+ * contended. Spurious wakeups are fine, the caller retries.
+ */
+void ObjectMutex::Park()
+{
+#ifdef __linux__
+	syscall(SYS_futex, reinterpret_cast<int *>(&m_State), FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0);
+#else /* __linux__ */
+	ObjectMutexParkingLot& lot = GetParkingLot(this);
+	boost::mutex::scoped_lock lock(lot.Mutex);
+
+	while (m_State.load() == 2)
+		lot.CV.wait(lock);
+#endif /* __linux__ */
+}
+
+void ObjectMutex::Wake()
+{
+#ifdef __linux__
+	syscall(SYS_futex, reinterpret_cast<int *>(&m_State), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else /* __linux__ */
+	ObjectMutexParkingLot& lot = GetParkingLot(this);
+	boost::mutex::scoped_lock lock(lot.Mutex);
+	lot.CV.notify_all();
+#endif /* __linux__ */
+}
+
 ObjectLock::~ObjectLock()
 {
 	Unlock();
@@ -48,6 +332,11 @@ void ObjectLock::LockMutex(const Object *object)
 {
 	unsigned int it = 0;
 
+#ifdef ICINGA2_LOCK_PROFILING
+	std::chrono::steady_clock::time_point start;
+	bool contended = false;
+#endif /* ICINGA2_LOCK_PROFILING */
+
 #ifdef _WIN32
 #	ifdef _WIN64
 	while (likely(InterlockedCompareExchange64((LONGLONG *)&object->m_Mutex, I2MUTEX_LOCKED, I2MUTEX_UNLOCKED) != I2MUTEX_UNLOCKED)) {
@@ -58,18 +347,40 @@ void ObjectLock::LockMutex(const Object *object)
 	while (likely(!__sync_bool_compare_and_swap(&object->m_Mutex, I2MUTEX_UNLOCKED, I2MUTEX_LOCKED))) {
 #endif /* _WIN32 */
 		if (likely(object->m_Mutex > I2MUTEX_LOCKED)) {
-			auto *mtx = reinterpret_cast<boost::recursive_mutex *>(object->m_Mutex);
-			mtx->lock();
+			auto *mtx = reinterpret_cast<ObjectMutex *>(object->m_Mutex);
+
+#ifdef ICINGA2_LOCK_PROFILING
+			if (!mtx->TryLock()) {
+				if (!contended) {
+					start = std::chrono::steady_clock::now();
+					contended = true;
+				}
+
+				mtx->Lock();
+			}
+
+			if (contended)
+				RecordContention(object, start);
+#else /* ICINGA2_LOCK_PROFILING */
+			mtx->Lock();
+#endif /* ICINGA2_LOCK_PROFILING */
 
 			return;
 		}
 
+#ifdef ICINGA2_LOCK_PROFILING
+		if (!contended) {
+			start = std::chrono::steady_clock::now();
+			contended = true;
+		}
+#endif /* ICINGA2_LOCK_PROFILING */
+
 		Spin(it);
 		it++;
 	}
 
-	auto *mtx = new boost::recursive_mutex();
-	mtx->lock();
+	auto *mtx = new ObjectMutex();
+	mtx->Lock();
 #ifdef _WIN32
 #	ifdef _WIN64
 	InterlockedCompareExchange64((LONGLONG *)&object->m_Mutex, reinterpret_cast<LONGLONG>(mtx), I2MUTEX_LOCKED);
@@ -79,6 +390,11 @@ void ObjectLock::LockMutex(const Object *object)
 #else /* _WIN32 */
 	__sync_bool_compare_and_swap(&object->m_Mutex, I2MUTEX_LOCKED, reinterpret_cast<uintptr_t>(mtx));
 #endif /* _WIN32 */
+
+#ifdef ICINGA2_LOCK_PROFILING
+	if (contended)
+		RecordContention(object, start);
+#endif /* ICINGA2_LOCK_PROFILING */
 }
 
 void ObjectLock::Lock()
@@ -132,7 +448,7 @@ void ObjectLock::Unlock()
 #endif /* I2_DEBUG */
 
 	if (m_Locked) {
-		reinterpret_cast<boost::recursive_mutex *>(m_Object->m_Mutex)->unlock();
+		reinterpret_cast<ObjectMutex *>(m_Object->m_Mutex)->Unlock();
 		m_Locked = false;
 	}
 }
@@ -21,10 +21,40 @@
 #define OBJECTLOCK_H
 
 #include "base/object.hpp"
+#include <atomic>
 
 namespace icinga
 {
 
+/**
+ * A recursive mutex which spins for a bounded number of iterations
+ * and then parks the calling thread (on a futex where available).
+ *
+ * @ingroup base
+ */
+class ObjectMutex
+{
+public:
+	ObjectMutex() = default;
+	ObjectMutex(const ObjectMutex&) = delete;
+	ObjectMutex& operator=(const ObjectMutex&) = delete;
+
+	void Lock();
+	bool TryLock();
+	void Unlock();
+
+private:
+	/* 0 = unlocked, 1 = locked, 2 = locked and there may be parked waiters */
+	std::atomic<int> m_State{0};
+	std::atomic<uintptr_t> m_Owner{0};
+	unsigned int m_Depth{0};
+
+	void Acquired(uintptr_t owner);
+
+	void Park();
+	void Wake();
+};
+
 /**
  * A scoped lock for Objects.
  */
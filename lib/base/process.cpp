@@ -28,8 +28,13 @@
 #include "base/utility.hpp"
 #include "base/scriptglobal.hpp"
 #include "base/json.hpp"
+#include "base/configuration.hpp"
 #include <boost/algorithm/string/join.hpp>
 #include <boost/thread/once.hpp>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <set>
 #include <thread>
 #include <iostream>
 
@@ -38,6 +43,14 @@
 #	include <poll.h>
 #	include <string.h>
 
+#	ifdef HAVE_POSIX_SPAWN
+#		include <spawn.h>
+#	endif /* HAVE_POSIX_SPAWN */
+
+#	ifdef __linux__
+#		include <sys/epoll.h>
+#	endif /* __linux__ */
+
 #	ifndef __APPLE__
 extern char **environ;
 #	else /* __APPLE__ */
@@ -56,11 +69,60 @@ static std::map<Process::ProcessHandle, Process::Ptr> l_Processes[IOTHREADS];
 static HANDLE l_Events[IOTHREADS];
 #else /* _WIN32 */
 static int l_EventFDs[IOTHREADS][2];
+#	ifdef __linux__
+static int l_PollFDs[IOTHREADS];
+static std::set<std::pair<double, Process *> > l_Timeouts[IOTHREADS];
+#	else /* __linux__ */
 static std::map<Process::ConsoleHandle, Process::ProcessHandle> l_FDs[IOTHREADS];
+#	endif /* __linux__ */
+
+/**
+ * A request which was sent to a spawn helper and is waiting for its response.
+ */
+struct SpawnHelperRequest
+{
+	boost::condition_variable CV;
+	bool Done{false};
+	Dictionary::Ptr Response;
+};
+
+/**
+ * A connection to a forked spawn helper process. The read thread fails all
+ * outstanding requests when the helper goes away. The socket is closed once
+ * neither the read thread nor a sender holds a reference to the connection.
+ */
+struct SpawnHelperConnection
+{
+	~SpawnHelperConnection()
+	{
+		if (FD != -1)
+			(void)close(FD);
+	}
+
+	int FD{-1};
+	pid_t PID{-1};
+	bool Reading{false};
+	std::map<unsigned long, SpawnHelperRequest *> Requests;
+};
+
+/**
+ * A spawn helper. Requests are tagged with an ID and any number of them can
+ * be in flight at the same time; the responses are read by a separate thread
+ * and handed to the waiting callers.
+ */
+struct SpawnHelper
+{
+	boost::mutex SendMutex;
+	boost::mutex Mutex;
+	std::shared_ptr<SpawnHelperConnection> Connection;
+	unsigned long NextID{0};
+};
+
+static std::vector<std::unique_ptr<SpawnHelper> > l_SpawnHelpers;
+static std::atomic<unsigned int> l_NextSpawnHelper(0);
 
-static boost::mutex l_ProcessControlMutex;
+/* The control FD of the spawn helper we're running in (if any). */
 static int l_ProcessControlFD = -1;
-static pid_t l_ProcessControlPID;
 #endif /* _WIN32 */
 static boost::once_flag l_ProcessOnceFlag = BOOST_ONCE_INIT;
 static boost::once_flag l_SpawnHelperOnceFlag = BOOST_ONCE_INIT;
@@ -84,6 +146,108 @@ Process::~Process()
 }
 
 #ifndef _WIN32
+static pid_t ProcessSpawnFork(char **argv, char **envp, int fds[3], bool adjustPriority, int *errorCode)
+{
+	pid_t pid = fork();
+
+	if (pid < 0)
+		*errorCode = errno;
+
+	if (pid == 0) {
+		// child process
+
+		(void)close(l_ProcessControlFD);
+
+		if (setsid() < 0) {
+			perror("setsid() failed");
+			_exit(128);
+		}
+
+		if (dup2(fds[0], STDIN_FILENO) < 0 || dup2(fds[1], STDOUT_FILENO) < 0 || dup2(fds[2], STDERR_FILENO) < 0) {
+			perror("dup2() failed");
+			_exit(128);
+		}
+
+		(void)close(fds[0]);
+		(void)close(fds[1]);
+		(void)close(fds[2]);
+
+#ifdef HAVE_NICE
+		if (adjustPriority)
+			(void)nice(5);
+#endif /* HAVE_NICE */
+
+		sigset_t mask;
+		sigemptyset(&mask);
+		sigprocmask(SIG_SETMASK, &mask, nullptr);
+
+		if (icinga2_execvpe(argv[0], argv, envp) < 0) {
+			char errmsg[512];
+			strcpy(errmsg, "execvpe(");
+			strncat(errmsg, argv[0], sizeof(errmsg) - strlen(errmsg) - 1);
+			strncat(errmsg, ") failed", sizeof(errmsg) - strlen(errmsg) - 1);
+			errmsg[sizeof(errmsg) - 1] = '\0';
+			perror(errmsg);
+			_exit(128);
+		}
+
+		_exit(128);
+	}
+
+	return pid;
+}
+
+#if defined(HAVE_POSIX_SPAWN) && defined(POSIX_SPAWN_SETSID)
+/**
+ * Starts a process with posix_spawn() which, unlike fork(), doesn't have to
+ * copy the spawn helper's page tables. The only FDs the spawn helper has open
+ * are its control socket and the FDs for the new process, so these are the
+ * only ones which have to be closed in the child.
+ *
+ * Returns -1 if the process couldn't be started, including when exec() failed.
+ */
+static pid_t ProcessSpawnPosix(char **argv, char **envp, int fds[3], int *errorCode)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+
+	posix_spawn_file_actions_addclose(&actions, l_ProcessControlFD);
+
+	for (int i = 0; i < 3; i++)
+		posix_spawn_file_actions_adddup2(&actions, fds[i], i);
+
+	/* stdout and stderr usually share the same FD, it must only be closed once. */
+	for (int i = 0; i < 3; i++) {
+		if (fds[i] <= STDERR_FILENO || std::find(fds, fds + i, fds[i]) != fds + i)
+			continue;
+
+		posix_spawn_file_actions_addclose(&actions, fds[i]);
+	}
+
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGMASK);
+
+	sigset_t mask;
+	sigemptyset(&mask);
+	posix_spawnattr_setsigmask(&attr, &mask);
+
+	pid_t pid;
+	int rc = posix_spawnp(&pid, argv[0], &actions, &attr, argv, envp);
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+
+	if (rc != 0) {
+		*errorCode = rc;
+		return -1;
+	}
+
+	return pid;
+}
+#endif /* HAVE_POSIX_SPAWN && POSIX_SPAWN_SETSID */
+
 static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& request)
 {
 	struct cmsghdr *cmsg = CMSG_FIRSTHDR(msgh);
@@ -137,52 +301,23 @@ static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& reques
 
 	extraEnvironment.reset();
 
-	pid_t pid = fork();
-
+	pid_t pid;
 	int errorCode = 0;
 
-	if (pid < 0)
-		errorCode = errno;
-
-	if (pid == 0) {
-		// child process
-
-		(void)close(l_ProcessControlFD);
-
-		if (setsid() < 0) {
-			perror("setsid() failed");
-			_exit(128);
-		}
-
-		if (dup2(fds[0], STDIN_FILENO) < 0 || dup2(fds[1], STDOUT_FILENO) < 0 || dup2(fds[2], STDERR_FILENO) < 0) {
-			perror("dup2() failed");
-			_exit(128);
-		}
-
-		(void)close(fds[0]);
-		(void)close(fds[1]);
-		(void)close(fds[2]);
+	pid = -1;
 
-#ifdef HAVE_NICE
-		if (adjustPriority)
-			(void)nice(5);
-#endif /* HAVE_NICE */
+#if defined(HAVE_POSIX_SPAWN) && defined(POSIX_SPAWN_SETSID)
+	/* nice() can't be expressed as a spawn attribute. */
+	if (Configuration::SpawnMethod == "posix_spawn" && !adjustPriority)
+		pid = ProcessSpawnPosix(argv, envp, fds, &errorCode);
+#endif /* HAVE_POSIX_SPAWN && POSIX_SPAWN_SETSID */
 
-		sigset_t mask;
-		sigemptyset(&mask);
-		sigprocmask(SIG_SETMASK, &mask, nullptr);
-
-		if (icinga2_execvpe(argv[0], argv, envp) < 0) {
-			char errmsg[512];
-			strcpy(errmsg, "execvpe(");
-			strncat(errmsg, argv[0], sizeof(errmsg) - strlen(errmsg) - 1);
-			strncat(errmsg, ") failed", sizeof(errmsg) - strlen(errmsg) - 1);
-			errmsg[sizeof(errmsg) - 1] = '\0';
-			perror(errmsg);
-			_exit(128);
-		}
-
-		_exit(128);
+	/* posix_spawnp() returns exec() errors to the caller and doesn't run scripts
+	 * without a shebang line with /bin/sh. fork() handles both like it always did:
+	 * the child runs icinga2_execvpe() and exits with 128 if that fails. */
+	if (pid < 0) {
+		errorCode = 0;
+		pid = ProcessSpawnFork(argv, envp, fds, adjustPriority, &errorCode);
 	}
 
 	(void)close(fds[0]);
@@ -240,6 +375,46 @@ static Value ProcessWaitPIDImpl(struct msghdr *msgh, const Dictionary::Ptr& requ
 	return response;
 }
 
+static bool SendAll(int fd, const char *data, size_t length)
+{
+	size_t count = 0;
+
+	while (count < length) {
+		ssize_t rc = send(fd, data + count, length - count, 0);
+
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		count += rc;
+	}
+
+	return true;
+}
+
+static bool RecvAll(int fd, char *data, size_t length)
+{
+	size_t count = 0;
+
+	while (count < length) {
+		ssize_t rc = recv(fd, data + count, length - count, 0);
+
+		if (rc <= 0) {
+			if (rc < 0 && (errno == EINTR || errno == EAGAIN))
+				continue;
+
+			return false;
+		}
+
+		count += rc;
+	}
+
+	return true;
+}
+
 static void ProcessHandler()
 {
 	sigset_t mask;
@@ -286,26 +461,13 @@ static void ProcessHandler()
 
 		auto *mbuf = new char[length];
 
-		size_t count = 0;
-		while (count < length) {
-			rc = recv(l_ProcessControlFD, mbuf + count, length - count, 0);
-
-			if (rc <= 0) {
-				if (rc < 0 && (errno == EINTR || errno == EAGAIN))
-					continue;
-
-				delete [] mbuf;
-
-				_exit(0);
-			}
+		if (!RecvAll(l_ProcessControlFD, mbuf, length)) {
+			delete [] mbuf;
 
-			count += rc;
-
-			if (rc == 0)
-				break;
+			_exit(0);
 		}
 
-		String jrequest = String(mbuf, mbuf + count);
+		String jrequest = String(mbuf, mbuf + length);
 
 		delete [] mbuf;
 
@@ -324,9 +486,23 @@ static void ProcessHandler()
 		else
 			response = Empty;
 
-		String jresponse = JsonEncode(response);
+		Dictionary::Ptr dresponse;
+
+		if (response.IsObjectType<Dictionary>())
+			dresponse = response;
+		else
+			dresponse = new Dictionary();
 
-		if (send(l_ProcessControlFD, jresponse.CStr(), jresponse.GetLength(), 0) < 0) {
+		dresponse->Set("id", request->Get("id"));
+
+		String jresponse = JsonEncode(dresponse);
+
+		/* Responses are framed the same way as requests: the payload's
+		 * length followed by the JSON-encoded payload itself. */
+		size_t rlength = jresponse.GetLength();
+		String frame = String(reinterpret_cast<const char *>(&rlength), reinterpret_cast<const char *>(&rlength) + sizeof(rlength)) + jresponse;
+
+		if (!SendAll(l_ProcessControlFD, frame.CStr(), frame.GetLength())) {
 			BOOST_THROW_EXCEPTION(posix_error()
 				<< boost::errinfo_api_function("send")
 				<< boost::errinfo_errno(errno));
@@ -336,13 +512,79 @@ static void ProcessHandler()
 	_exit(0);
 }
 
-static void StartSpawnProcessHelper()
+/**
+ * Reads responses from a spawn helper and wakes up the threads waiting for them.
+ */
+static void SpawnHelperReadThreadProc(SpawnHelper *helper, const std::shared_ptr<SpawnHelperConnection>& conn)
 {
-	if (l_ProcessControlFD != -1) {
-		(void)close(l_ProcessControlFD);
+	Utility::SetThreadName("Spawn Helper");
+
+	for (;;) {
+		size_t length;
+
+		if (!RecvAll(conn->FD, reinterpret_cast<char *>(&length), sizeof(length)))
+			break;
+
+		std::vector<char> buf(length);
+
+		if (!RecvAll(conn->FD, buf.data(), length))
+			break;
+
+		Dictionary::Ptr response;
+
+		try {
+			response = JsonDecode(buf.data(), buf.size());
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "Process")
+				<< "Invalid response from spawn helper: " << DiagnosticInformation(ex, false);
+			break;
+		}
+
+		unsigned long id = response->Get("id");
+
+		boost::mutex::scoped_lock lock(helper->Mutex);
+
+		auto it = conn->Requests.find(id);
+
+		if (it == conn->Requests.end())
+			continue;
+
+		it->second->Response = response;
+		it->second->Done = true;
+		it->second->CV.notify_one();
+
+		conn->Requests.erase(it);
+	}
+
+	{
+		/* The helper is gone, fail all requests which are still waiting for a response. */
+		boost::mutex::scoped_lock lock(helper->Mutex);
+
+		for (auto& kv : conn->Requests) {
+			kv.second->Done = true;
+			kv.second->CV.notify_one();
+		}
+
+		conn->Requests.clear();
+	}
+}
+
+/**
+ * Note: Caller must hold helper->SendMutex.
+ */
+static void StartSpawnProcessHelper(SpawnHelper *helper)
+{
+	std::shared_ptr<SpawnHelperConnection> conn = helper->Connection;
+
+	if (conn) {
+		/* Wakes up the read thread; the socket itself is closed by the
+		 * connection's destructor. */
+		(void)shutdown(conn->FD, SHUT_RDWR);
 
 		int status;
-		(void)waitpid(l_ProcessControlPID, &status, 0);
+		(void)waitpid(conn->PID, &status, 0);
+
+		helper->Connection.reset();
 	}
 
 	int controlFDs[2];
@@ -372,64 +614,117 @@ static void StartSpawnProcessHelper()
 
 	(void)close(controlFDs[0]);
 
-	l_ProcessControlFD = controlFDs[1];
-	l_ProcessControlPID = pid;
+	conn = std::make_shared<SpawnHelperConnection>();
+	conn->FD = controlFDs[1];
+	conn->PID = pid;
+
+	helper->Connection = conn;
 }
 
-static pid_t ProcessSpawn(const std::vector<String>& arguments, const Dictionary::Ptr& extraEnvironment, bool adjustPriority, int fds[3])
+/**
+ * Sends a request to a spawn helper and waits for its response.
+ *
+ * @param helper The spawn helper.
+ * @param request The request. An "id" attribute is added to it.
+ * @param fds File descriptors which should be passed to the spawn helper (optional).
+ * @returns The response or nullptr if the spawn helper died before responding.
+ */
+static Dictionary::Ptr SpawnHelperRequestResponse(SpawnHelper *helper, const Dictionary::Ptr& request, int fds[3] = nullptr)
 {
-	Dictionary::Ptr request = new Dictionary({
-		{ "command", "spawn" },
-		{ "arguments", Array::FromVector(arguments) },
-		{ "extraEnvironment", extraEnvironment },
-		{ "adjustPriority", adjustPriority }
-	});
+	SpawnHelperRequest req;
+
+	{
+		boost::mutex::scoped_lock slock(helper->SendMutex);
 
-	String jrequest = JsonEncode(request);
-	size_t length = jrequest.GetLength();
+		for (;;) {
+			if (!helper->Connection)
+				StartSpawnProcessHelper(helper);
 
-	boost::mutex::scoped_lock lock(l_ProcessControlMutex);
+			std::shared_ptr<SpawnHelperConnection> conn = helper->Connection;
 
-	struct msghdr msg;
-	memset(&msg, 0, sizeof(msg));
+			/* The read thread is started lazily because we might've been
+			 * forked (i.e. daemonized) after the helper was started. */
+			if (!conn->Reading) {
+				conn->Reading = true;
+				std::thread(std::bind(&SpawnHelperReadThreadProc, helper, conn)).detach();
+			}
 
-	struct iovec io;
-	io.iov_base = &length;
-	io.iov_len = sizeof(length);
+			unsigned long id;
 
-	msg.msg_iov = &io;
-	msg.msg_iovlen = 1;
+			{
+				boost::mutex::scoped_lock lock(helper->Mutex);
+				id = helper->NextID++;
+				conn->Requests[id] = &req;
+			}
 
-	char cbuf[CMSG_SPACE(sizeof(int) * 3)];
-	msg.msg_control = cbuf;
-	msg.msg_controllen = sizeof(cbuf);
+			request->Set("id", id);
 
-	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-	cmsg->cmsg_level = SOL_SOCKET;
-	cmsg->cmsg_type = SCM_RIGHTS;
-	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * 3);
+			String jrequest = JsonEncode(request);
+			size_t length = jrequest.GetLength();
 
-	memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * 3);
+			struct msghdr msg;
+			memset(&msg, 0, sizeof(msg));
 
-	msg.msg_controllen = cmsg->cmsg_len;
+			struct iovec io;
+			io.iov_base = &length;
+			io.iov_len = sizeof(length);
 
-send_message:
-	while (sendmsg(l_ProcessControlFD, &msg, 0) < 0)
-		StartSpawnProcessHelper();
+			msg.msg_iov = &io;
+			msg.msg_iovlen = 1;
 
-	if (send(l_ProcessControlFD, jrequest.CStr(), jrequest.GetLength(), 0) < 0)
-		goto send_message;
+			char cbuf[CMSG_SPACE(sizeof(int) * 3)];
 
-	char buf[4096];
+			if (fds) {
+				msg.msg_control = cbuf;
+				msg.msg_controllen = sizeof(cbuf);
 
-	ssize_t rc = recv(l_ProcessControlFD, buf, sizeof(buf), 0);
+				struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+				cmsg->cmsg_level = SOL_SOCKET;
+				cmsg->cmsg_type = SCM_RIGHTS;
+				cmsg->cmsg_len = CMSG_LEN(sizeof(int) * 3);
 
-	if (rc <= 0)
-		return -1;
+				memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * 3);
 
-	String jresponse = String(buf, buf + rc);
+				msg.msg_controllen = cmsg->cmsg_len;
+			}
+
+			if (sendmsg(conn->FD, &msg, 0) >= 0 && SendAll(conn->FD, jrequest.CStr(), jrequest.GetLength()))
+				break;
+
+			{
+				boost::mutex::scoped_lock lock(helper->Mutex);
+
+				/* The read thread might have failed the request already. */
+				conn->Requests.erase(id);
+				req.Done = false;
+			}
+
+			/* The helper died, start a new one and try again. */
+			StartSpawnProcessHelper(helper);
+		}
+	}
 
-	Dictionary::Ptr response = JsonDecode(jresponse);
+	boost::mutex::scoped_lock lock(helper->Mutex);
+
+	while (!req.Done)
+		req.CV.wait(lock);
+
+	return req.Response;
+}
+
+static pid_t ProcessSpawn(SpawnHelper *helper, const std::vector<String>& arguments, const Dictionary::Ptr& extraEnvironment, bool adjustPriority, int fds[3])
+{
+	Dictionary::Ptr request = new Dictionary({
+		{ "command", "spawn" },
+		{ "arguments", Array::FromVector(arguments) },
+		{ "extraEnvironment", extraEnvironment },
+		{ "adjustPriority", adjustPriority }
+	});
+
+	Dictionary::Ptr response = SpawnHelperRequestResponse(helper, request, fds);
+
+	if (!response)
+		return -1;
 
 	if (response->Get("rc") == -1)
 		errno = response->Get("errno");
@@ -437,7 +732,7 @@ send_message:
 	return response->Get("rc");
 }
 
-static int ProcessKill(pid_t pid, int signum)
+static int ProcessKill(SpawnHelper *helper, pid_t pid, int signum)
 {
 	Dictionary::Ptr request = new Dictionary({
 		{ "command", "kill" },
@@ -445,68 +740,58 @@ static int ProcessKill(pid_t pid, int signum)
 		{ "signum", signum }
 	});
 
-	String jrequest = JsonEncode(request);
-	size_t length = jrequest.GetLength();
-
-	boost::mutex::scoped_lock lock(l_ProcessControlMutex);
-
-send_message:
-	while (send(l_ProcessControlFD, &length, sizeof(length), 0) < 0)
-		StartSpawnProcessHelper();
-
-	if (send(l_ProcessControlFD, jrequest.CStr(), jrequest.GetLength(), 0) < 0)
-		goto send_message;
-
-	char buf[4096];
+	Dictionary::Ptr response = SpawnHelperRequestResponse(helper, request);
 
-	ssize_t rc = recv(l_ProcessControlFD, buf, sizeof(buf), 0);
-
-	if (rc <= 0)
+	if (!response)
 		return -1;
 
-	String jresponse = String(buf, buf + rc);
-
-	Dictionary::Ptr response = JsonDecode(jresponse);
 	return response->Get("errno");
 }
 
-static int ProcessWaitPID(pid_t pid, int *status)
+static int ProcessWaitPID(SpawnHelper *helper, pid_t pid, int *status)
 {
 	Dictionary::Ptr request = new Dictionary({
 		{ "command", "waitpid" },
 		{ "pid", pid }
 	});
 
-	String jrequest = JsonEncode(request);
-	size_t length = jrequest.GetLength();
-
-	boost::mutex::scoped_lock lock(l_ProcessControlMutex);
-
-send_message:
-	while (send(l_ProcessControlFD, &length, sizeof(length), 0) < 0)
-		StartSpawnProcessHelper();
-
-	if (send(l_ProcessControlFD, jrequest.CStr(), jrequest.GetLength(), 0) < 0)
-		goto send_message;
+	Dictionary::Ptr response = SpawnHelperRequestResponse(helper, request);
 
-	char buf[4096];
-
-	ssize_t rc = recv(l_ProcessControlFD, buf, sizeof(buf), 0);
-
-	if (rc <= 0)
+	if (!response)
 		return -1;
 
-	String jresponse = String(buf, buf + rc);
-
-	Dictionary::Ptr response = JsonDecode(jresponse);
 	*status = response->Get("status");
 	return response->Get("rc");
 }
 
 void Process::InitializeSpawnHelper()
 {
-	if (l_ProcessControlFD == -1)
-		StartSpawnProcessHelper();
+	if (!l_SpawnHelpers.empty())
+		return;
+
+	String method = Configuration::SpawnMethod;
+
+#if defined(HAVE_POSIX_SPAWN) && defined(POSIX_SPAWN_SETSID)
+	if (method != "fork" && method != "posix_spawn")
+#else /* HAVE_POSIX_SPAWN && POSIX_SPAWN_SETSID */
+	if (method != "fork")
+#endif /* HAVE_POSIX_SPAWN && POSIX_SPAWN_SETSID */
+		Log(LogWarning, "Process")
+			<< "Spawn method '" << method << "' is not supported on this platform, falling back to 'fork'.";
+
+	int count = Configuration::SpawnHelpers;
+
+	if (count < 1)
+		count = 1;
+
+	for (int i = 0; i < count; i++) {
+		l_SpawnHelpers.emplace_back(new SpawnHelper());
+
+		SpawnHelper *helper = l_SpawnHelpers.back().get();
+
+		boost::mutex::scoped_lock lock(helper->SendMutex);
+		StartSpawnProcessHelper(helper);
+	}
 }
 #endif /* _WIN32 */
 
@@ -539,6 +824,26 @@ static void InitializeProcess()
 		}
 #	endif /* HAVE_PIPE2 */
 	}
+
+#	ifdef __linux__
+	for (int tid = 0; tid < IOTHREADS; tid++) {
+		l_PollFDs[tid] = epoll_create(128);
+
+		if (l_PollFDs[tid] < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("epoll_create")
+				<< boost::errinfo_errno(errno));
+		}
+
+		Utility::SetCloExec(l_PollFDs[tid]);
+
+		epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.data.ptr = nullptr;
+		event.events = EPOLLIN;
+		epoll_ctl(l_PollFDs[tid], EPOLL_CTL_ADD, l_EventFDs[tid][0], &event);
+	}
+#	endif /* __linux__ */
 #endif /* _WIN32 */
 }
 
@@ -548,7 +853,11 @@ void Process::ThreadInitialize()
 {
 	/* Note to self: Make sure this runs _after_ we've daemonized. */
 	for (int tid = 0; tid < IOTHREADS; tid++) {
+#ifdef __linux__
+		std::thread t(std::bind(&Process::IOThreadProcEpoll, tid));
+#else /* __linux__ */
 		std::thread t(std::bind(&Process::IOThreadProc, tid));
+#endif /* __linux__ */
 		t.detach();
 	}
 }
@@ -606,6 +915,7 @@ bool Process::GetAdjustPriority() const
 	return m_AdjustPriority;
 }
 
+#ifndef __linux__
 void Process::IOThreadProc(int tid)
 {
 #ifdef _WIN32
@@ -751,6 +1061,82 @@ void Process::IOThreadProc(int tid)
 		}
 	}
 }
+#else /* __linux__ */
+/**
+ * Collects the output of the running processes. Unlike IOThreadProc() this
+ * doesn't have to rebuild the FD set on each iteration: the pipes are
+ * registered with epoll when the process is started and each event carries
+ * a pointer to its process. Processes which have a timeout are additionally
+ * kept in a set ordered by their deadline.
+ *
+ * A process is done once its output pipe is closed; the exit status is then
+ * collected from the spawn helper which owns the child.
+ */
+void Process::IOThreadProcEpoll(int tid)
+{
+	Utility::SetThreadName("ProcessIO");
+
+	for (;;) {
+		int timeout = -1;
+
+		{
+			boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
+
+			if (!l_Timeouts[tid].empty()) {
+				double delta = l_Timeouts[tid].begin()->first - Utility::GetTime();
+
+				if (delta < 0.01)
+					delta = 0.01;
+				else if (delta > 3600)
+					delta = 3600;
+
+				timeout = delta * 1000;
+			}
+		}
+
+		epoll_event pevents[64];
+		int rc = epoll_wait(l_PollFDs[tid], pevents, sizeof(pevents) / sizeof(pevents[0]), timeout);
+
+		if (rc < 0)
+			continue;
+
+		boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
+
+		auto handleEvents = [tid](Process *process) {
+			if (process->DoEvents())
+				return;
+
+			(void)epoll_ctl(l_PollFDs[tid], EPOLL_CTL_DEL, process->m_FD, nullptr);
+			(void)close(process->m_FD);
+
+			if (process->m_Timeout != 0)
+				l_Timeouts[tid].erase(std::make_pair(process->m_Result.ExecutionStart + process->m_Timeout, process));
+
+			/* This drops the last reference to the process. */
+			l_Processes[tid].erase(process->m_Process);
+		};
+
+		for (int i = 0; i < rc; i++) {
+			auto *process = static_cast<Process *>(pevents[i].data.ptr);
+
+			if (!process) {
+				char buffer[512];
+				if (read(l_EventFDs[tid][0], buffer, sizeof(buffer)) < 0)
+					Log(LogCritical, "base", "Read from event FD failed.");
+
+				continue;
+			}
+
+			handleEvents(process);
+		}
+
+		double now = Utility::GetTime();
+
+		while (!l_Timeouts[tid].empty() && l_Timeouts[tid].begin()->first < now)
+			handleEvents(l_Timeouts[tid].begin()->second);
+	}
+}
+#endif /* __linux__ */
 
 String Process::PrettyPrintArguments(const Process::Arguments& arguments)
 {
@@ -986,7 +1372,11 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 	fds[1] = outfds[1];
 	fds[2] = outfds[1];
 
-	m_Process = ProcessSpawn(m_Arguments, m_ExtraEnvironment, m_AdjustPriority, fds);
+	/* Spread the processes over all spawn helpers. waitpid() and kill() requests
+	 * have to go to the helper which started the process. */
+	m_SpawnHelper = l_NextSpawnHelper++ % l_SpawnHelpers.size();
+
+	m_Process = ProcessSpawn(l_SpawnHelpers[m_SpawnHelper].get(), m_Arguments, m_ExtraEnvironment, m_AdjustPriority, fds);
 	m_PID = m_Process;
 
 	if (m_PID == -1) {
@@ -1006,19 +1396,48 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 
 	m_Callback = callback;
 
+#ifndef _WIN32
+	/* The process couldn't be started. There's nothing for the I/O threads to
+	 * wait for (and its PID doesn't identify it either), so finish it right away. */
+	if (m_PID == -1) {
+		(void)DoEvents();
+		(void)close(m_FD);
+		return;
+	}
+#endif /* _WIN32 */
+
 	int tid = GetTID();
 
+#ifdef __linux__
+	bool wakeup = false;
+#endif /* __linux__ */
+
 	{
 		boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
 		l_Processes[tid][m_Process] = this;
-#ifndef _WIN32
+#ifdef __linux__
+		epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.data.ptr = this;
+		event.events = EPOLLIN;
+		epoll_ctl(l_PollFDs[tid], EPOLL_CTL_ADD, m_FD, &event);
+
+		/* The I/O thread only has to be woken up if it's waiting for a later deadline. */
+		if (m_Timeout != 0)
+			wakeup = l_Timeouts[tid].insert(std::make_pair(m_Result.ExecutionStart + m_Timeout, this)).first == l_Timeouts[tid].begin();
+#elif !defined(_WIN32) /* __linux__ */
 		l_FDs[tid][m_FD] = m_Process;
-#endif /* _WIN32 */
+#endif /* __linux__ */
 	}
 
 #ifdef _WIN32
 	SetEvent(l_Events[tid]);
 #else /* _WIN32 */
+#	ifdef __linux__
+	if (!wakeup)
+		return;
+#	endif /* __linux__ */
+
 	if (write(l_EventFDs[tid][1], "T", 1) < 0 && errno != EINTR && errno != EAGAIN)
 		Log(LogCritical, "base", "Write to event FD failed.");
 #endif /* _WIN32 */
@@ -1043,7 +1462,7 @@ bool Process::DoEvents()
 #ifdef _WIN32
 			TerminateProcess(m_Process, 1);
 #else /* _WIN32 */
-			int error = ProcessKill(-m_Process, SIGKILL);
+			int error = ProcessKill(l_SpawnHelpers[m_SpawnHelper].get(), -m_Process, SIGKILL);
 			if (error) {
 				Log(LogWarning, "Process")
 					<< "Couldn't kill the process group " << m_PID << " (" << PrettyPrintArguments(m_Arguments)
@@ -1097,7 +1516,7 @@ bool Process::DoEvents()
 	int status, exitcode;
 	if (could_not_kill || m_PID == -1) {
 		exitcode = 128;
-	} else if (ProcessWaitPID(m_Process, &status) != m_Process) {
+	} else if (ProcessWaitPID(l_SpawnHelpers[m_SpawnHelper].get(), m_Process, &status) != m_Process) {
 		exitcode = 128;
 
 		Log(LogWarning, "Process")
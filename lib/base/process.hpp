@@ -106,13 +106,19 @@ private:
 	bool m_ReadFailed;
 	OVERLAPPED m_Overlapped;
 	char m_ReadBuffer[1024];
+#else /* _WIN32 */
+	unsigned int m_SpawnHelper;
 #endif /* _WIN32 */
 
 	std::ostringstream m_OutputStream;
 	std::function<void (const ProcessResult&)> m_Callback;
 	ProcessResult m_Result;
 
+#ifdef __linux__
+	static void IOThreadProcEpoll(int tid);
+#else /* __linux__ */
 	static void IOThreadProc(int tid);
+#endif /* __linux__ */
 	bool DoEvents();
 	int GetTID() const;
 };
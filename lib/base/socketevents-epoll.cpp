@@ -29,17 +29,19 @@ using namespace icinga;
 
 void SocketEventEngineEpoll::InitializeThread(int tid)
 {
+	/* All threads are initialized before the first one is started. */
+	if (m_PollFDs.size() < static_cast<size_t>(m_ThreadCount))
+		m_PollFDs.resize(m_ThreadCount);
+
 	m_PollFDs[tid] = epoll_create(128);
 	Utility::SetCloExec(m_PollFDs[tid]);
 
-	SocketEventDescriptor sed;
-
-	m_Sockets[tid][m_EventFDs[tid][0]] = sed;
 	m_FDChanged[tid] = true;
 
+	/* The wake-up socket is the only one without a descriptor. */
 	epoll_event event;
 	memset(&event, 0, sizeof(event));
-	event.data.fd = m_EventFDs[tid][0];
+	event.data.ptr = nullptr;
 	event.events = EPOLLIN;
 	epoll_ctl(m_PollFDs[tid], EPOLL_CTL_ADD, m_EventFDs[tid][0], &event);
 }
@@ -92,14 +94,17 @@ void SocketEventEngineEpoll::ThreadProc(int tid)
 		{
 			boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
+			/* Unregister() frees the descriptor once it has been notified, events
+			 * for sockets which were unregistered in the meantime are skipped below. */
 			if (m_FDChanged[tid]) {
 				m_FDChanged[tid] = false;
-
-				continue;
+				m_CV[tid].notify_all();
 			}
 
 			for (int i = 0; i < ready; i++) {
-				if (pevents[i].data.fd == m_EventFDs[tid][0]) {
+				auto *desc = static_cast<SocketEventDescriptor *>(pevents[i].data.ptr);
+
+				if (!desc) {
 					char buffer[512];
 					if (recv(m_EventFDs[tid][0], buffer, sizeof(buffer), 0) < 0)
 						Log(LogCritical, "SocketEvents", "Read from event FD failed.");
@@ -110,9 +115,12 @@ void SocketEventEngineEpoll::ThreadProc(int tid)
 				if ((pevents[i].events & (EPOLLIN | EPOLLOUT | EPOLLHUP | EPOLLERR)) == 0)
 					continue;
 
+				if (desc->EventInterface->m_FD == INVALID_SOCKET)
+					continue;
+
 				EventDescription event;
 				event.REvents = SocketEventEngineEpoll::EpollToPoll(pevents[i].events);
-				event.Descriptor = m_Sockets[tid][pevents[i].data.fd];
+				event.Descriptor = *desc;
 
 				events.emplace_back(std::move(event));
 			}
@@ -134,23 +142,24 @@ void SocketEventEngineEpoll::ThreadProc(int tid)
 
 void SocketEventEngineEpoll::Register(SocketEvents *se)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_ID % m_ThreadCount;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
 		VERIFY(se->m_FD != INVALID_SOCKET);
+		VERIFY(!se->m_EnginePrivate);
 
-		SocketEventDescriptor desc;
-		desc.EventInterface = se;
-
-		VERIFY(m_Sockets[tid].find(se->m_FD) == m_Sockets[tid].end());
+		/* The descriptor holds a reference to the socket until it is unregistered. */
+		auto *desc = new SocketEventDescriptor();
+		desc->Events = 0;
+		desc->EventInterface = se;
 
-		m_Sockets[tid][se->m_FD] = desc;
+		se->m_EnginePrivate = desc;
 
 		epoll_event event;
 		memset(&event, 0, sizeof(event));
-		event.data.fd = se->m_FD;
+		event.data.ptr = desc;
 		event.events = 0;
 		epoll_ctl(m_PollFDs[tid], EPOLL_CTL_ADD, se->m_FD, &event);
 
@@ -160,7 +169,9 @@ void SocketEventEngineEpoll::Register(SocketEvents *se)
 
 void SocketEventEngineEpoll::Unregister(SocketEvents *se)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_ID % m_ThreadCount;
+
+	SocketEventDescriptor *desc;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -168,7 +179,9 @@ void SocketEventEngineEpoll::Unregister(SocketEvents *se)
 		if (se->m_FD == INVALID_SOCKET)
 			return;
 
-		m_Sockets[tid].erase(se->m_FD);
+		desc = static_cast<SocketEventDescriptor *>(se->m_EnginePrivate);
+		se->m_EnginePrivate = nullptr;
+
 		m_FDChanged[tid] = true;
 
 		epoll_ctl(m_PollFDs[tid], EPOLL_CTL_DEL, se->m_FD, nullptr);
@@ -177,7 +190,11 @@ void SocketEventEngineEpoll::Unregister(SocketEvents *se)
 		se->m_Events = false;
 	}
 
+	/* Waits until the I/O thread no longer uses events it received before the socket
+	 * was removed from the epoll set, these still point to the descriptor. */
 	WakeUpThread(tid, true);
+
+	delete desc;
 }
 
 void SocketEventEngineEpoll::ChangeEvents(SocketEvents *se, int events)
@@ -185,19 +202,23 @@ void SocketEventEngineEpoll::ChangeEvents(SocketEvents *se, int events)
 	if (se->m_FD == INVALID_SOCKET)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
 
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_ID % m_ThreadCount;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
-		auto it = m_Sockets[tid].find(se->m_FD);
+		auto *desc = static_cast<SocketEventDescriptor *>(se->m_EnginePrivate);
 
-		if (it == m_Sockets[tid].end())
+		if (!desc || desc->Events == events)
 			return;
 
+		desc->Events = events;
+
+		/* The I/O thread picks up the new mask in its next epoll_wait() call,
+		 * it doesn't have to be woken up. */
 		epoll_event event;
 		memset(&event, 0, sizeof(event));
-		event.data.fd = se->m_FD;
+		event.data.ptr = desc;
 		event.events = SocketEventEngineEpoll::PollToEpoll(events);
 		epoll_ctl(m_PollFDs[tid], EPOLL_CTL_MOD, se->m_FD, &event);
 	}
@@ -132,7 +132,7 @@ void SocketEventEnginePoll::ThreadProc(int tid)
 
 void SocketEventEnginePoll::Register(SocketEvents *se)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_ID % m_ThreadCount;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -157,7 +157,7 @@ void SocketEventEnginePoll::Register(SocketEvents *se)
 
 void SocketEventEnginePoll::Unregister(SocketEvents *se)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_ID % m_ThreadCount;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -180,7 +180,7 @@ void SocketEventEnginePoll::ChangeEvents(SocketEvents *se, int events)
 	if (se->m_FD == INVALID_SOCKET)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
 
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_ID % m_ThreadCount;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -26,6 +26,8 @@
 #include <map>
 #ifdef __linux__
 #	include <sys/epoll.h>
+#	include <pthread.h>
+#	include <sched.h>
 #endif /* __linux__ */
 
 using namespace icinga;
@@ -35,9 +37,17 @@ static SocketEventEngine *l_SocketIOEngine;
 
 int SocketEvents::m_NextID = 0;
 
-void SocketEventEngine::Start()
+void SocketEventEngine::Start(int threads, bool pinThreads)
 {
-	for (int tid = 0; tid < SOCKET_IOTHREADS; tid++) {
+	m_ThreadCount = threads;
+	m_Threads.reset(new std::thread[threads]);
+	m_EventFDs.reset(new SOCKET[threads][2]);
+	m_FDChanged.reset(new bool[threads]());
+	m_EventMutex.reset(new boost::mutex[threads]);
+	m_CV.reset(new boost::condition_variable[threads]);
+	m_Sockets.reset(new std::map<SOCKET, SocketEventDescriptor>[threads]);
+
+	for (int tid = 0; tid < threads; tid++) {
 		Socket::SocketPair(m_EventFDs[tid]);
 
 		Utility::SetNonBlockingSocket(m_EventFDs[tid][0]);
@@ -49,14 +59,59 @@ void SocketEventEngine::Start()
 #endif /* _WIN32 */
 
 		InitializeThread(tid);
+	}
 
+	for (int tid = 0; tid < threads; tid++) {
 		m_Threads[tid] = std::thread(std::bind(&SocketEventEngine::ThreadProc, this, tid));
+
+		if (pinThreads)
+			PinThread(m_Threads[tid], tid);
+	}
+}
+
+/**
+ * Binds an I/O thread to one of the CPUs the process may run on, so that
+ * the sockets it handles stay in that CPU's caches.
+ */
+void SocketEventEngine::PinThread(std::thread& thread, int tid)
+{
+#ifdef __linux__
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+		return;
+
+	int cpus = CPU_COUNT(&allowed);
+
+	if (cpus <= 1)
+		return;
+
+	int target = tid % cpus;
+
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &allowed) || target--)
+			continue;
+
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu, &cpuset);
+
+		int rc = pthread_setaffinity_np(thread.native_handle(), sizeof(cpuset), &cpuset);
+
+		if (rc != 0) {
+			Log(LogWarning, "SocketEvents")
+				<< "Could not bind I/O thread " << tid << " to CPU " << cpu << ": " << Utility::FormatErrorNumber(rc);
+		}
+
+		break;
 	}
+#endif /* __linux__ */
 }
 
 void SocketEventEngine::WakeUpThread(int sid, bool wait)
 {
-	int tid = sid % SOCKET_IOTHREADS;
+	int tid = sid % m_ThreadCount;
 
 	if (std::this_thread::get_id() == m_Threads[tid].get_id())
 		return;
@@ -103,9 +158,19 @@ void SocketEvents::InitializeEngine()
 		l_SocketIOEngine = new SocketEventEnginePoll();
 	}
 
-	l_SocketIOEngine->Start();
+	int threads = Configuration::SocketIOThreads;
+
+	if (threads < 1) {
+		Log(LogWarning, "SocketEvents")
+			<< "Invalid number of I/O threads: " << threads << " - Falling back to 1";
+
+		threads = 1;
+	}
+
+	l_SocketIOEngine->Start(threads, Configuration::SocketIOAffinity);
 
 	Configuration::EventEngine = eventEngine;
+	Configuration::SocketIOThreads = threads;
 }
 
 /**
@@ -139,6 +204,11 @@ void SocketEvents::ChangeEvents(int events)
 	l_SocketIOEngine->ChangeEvents(this, events);
 }
 
+int SocketEventEngine::GetThreadCount() const
+{
+	return m_ThreadCount;
+}
+
 boost::mutex& SocketEventEngine::GetMutex(int tid)
 {
 	return m_EventMutex[tid];
@@ -146,7 +216,7 @@ boost::mutex& SocketEventEngine::GetMutex(int tid)
 
 bool SocketEvents::IsHandlingEvents() const
 {
-	int tid = m_ID % SOCKET_IOTHREADS;
+	int tid = m_ID % l_SocketIOEngine->GetThreadCount();
 	boost::mutex::scoped_lock lock(l_SocketIOEngine->GetMutex(tid));
 	return m_Events;
 }
@@ -24,7 +24,10 @@
 #include "base/socket.hpp"
 #include "base/stream.hpp"
 #include <boost/thread/condition_variable.hpp>
+#include <map>
+#include <memory>
 #include <thread>
+#include <vector>
 
 #ifndef _WIN32
 #	include <poll.h>
@@ -77,8 +80,6 @@ private:
 	friend class SocketEventEngineEpoll;
 };
 
-#define SOCKET_IOTHREADS 8
-
 struct SocketEventDescriptor
 {
 	int Events{POLLIN};
@@ -94,10 +95,12 @@ struct EventDescription
 class SocketEventEngine
 {
 public:
-	void Start();
+	void Start(int threads, bool pinThreads);
 
 	void WakeUpThread(int sid, bool wait);
 
+	int GetThreadCount() const;
+
 	boost::mutex& GetMutex(int tid);
 
 protected:
@@ -107,14 +110,18 @@ protected:
 	virtual void Unregister(SocketEvents *se) = 0;
 	virtual void ChangeEvents(SocketEvents *se, int events) = 0;
 
-	std::thread m_Threads[SOCKET_IOTHREADS];
-	SOCKET m_EventFDs[SOCKET_IOTHREADS][2];
-	bool m_FDChanged[SOCKET_IOTHREADS];
-	boost::mutex m_EventMutex[SOCKET_IOTHREADS];
-	boost::condition_variable m_CV[SOCKET_IOTHREADS];
-	std::map<SOCKET, SocketEventDescriptor> m_Sockets[SOCKET_IOTHREADS];
+	int m_ThreadCount{0};
+	std::unique_ptr<std::thread[]> m_Threads;
+	std::unique_ptr<SOCKET[][2]> m_EventFDs;
+	std::unique_ptr<bool[]> m_FDChanged;
+	std::unique_ptr<boost::mutex[]> m_EventMutex;
+	std::unique_ptr<boost::condition_variable[]> m_CV;
+	std::unique_ptr<std::map<SOCKET, SocketEventDescriptor>[]> m_Sockets;
 
 	friend class SocketEvents;
+
+private:
+	static void PinThread(std::thread& thread, int tid);
 };
 
 class SocketEventEnginePoll final : public SocketEventEngine
@@ -142,7 +149,7 @@ protected:
 	virtual void ThreadProc(int tid);
 
 private:
-	SOCKET m_PollFDs[SOCKET_IOTHREADS];
+	std::vector<SOCKET> m_PollFDs;
 
 	static int PollToEpoll(int events);
 	static int EpollToPoll(int events);
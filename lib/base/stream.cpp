@@ -50,6 +50,16 @@ size_t Stream::Peek(void *buffer, size_t count, bool allow_partial)
 	BOOST_THROW_EXCEPTION(std::runtime_error("Stream does not support Peek()."));
 }
 
+void Stream::WriteShared(const Object::Ptr& owner, const void *buffer, size_t count)
+{
+	Write(buffer, count);
+}
+
+bool Stream::WaitForSendQueue(size_t count, int timeout)
+{
+	return true;
+}
+
 void Stream::SignalDataAvailable()
 {
 	OnDataAvailable(this);
@@ -102,6 +102,30 @@ public:
 	 */
 	virtual void Write(const void *buffer, size_t count) = 0;
 
+	/**
+	 * Writes data to the stream. Streams which queue outgoing data may
+	 * reference the buffer instead of copying it, the default implementation
+	 * calls Write().
+	 *
+	 * @param owner An object which keeps the data alive. The data must not be
+	 *		modified afterwards.
+	 * @param buffer The data that is to be written.
+	 * @param count The number of bytes to write.
+	 */
+	virtual void WriteShared(const Object::Ptr& owner, const void *buffer, size_t count);
+
+	/**
+	 * Waits until no more than the specified number of bytes are queued for
+	 * writing. Streams which write synchronously return immediately.
+	 *
+	 * @param count The number of bytes which may still be queued.
+	 * @param timeout How long to wait (in seconds) for the peer to accept
+	 *		more data before giving up.
+	 * @returns false if the stream was closed or the peer didn't accept
+	 *		any data for the timeout.
+	 */
+	virtual bool WaitForSendQueue(size_t count, int timeout);
+
 	/**
 	 * Causes the stream to be closed (via Close()) once all pending data has been
 	 * written.
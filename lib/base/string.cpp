@@ -63,10 +63,7 @@ String::String(Value&& other)
 
 String& String::operator=(Value&& other)
 {
-	if (other.IsString())
-		m_Data = std::move(other.Get<String>());
-	else
-		*this = static_cast<String>(other);
+	*this = static_cast<String>(other);
 
 	return *this;
 }
@@ -29,11 +29,22 @@ using namespace icinga;
 
 int ThreadPool::m_NextID = 1;
 
+boost::thread_specific_ptr<ThreadPool::Worker> ThreadPool::m_CurrentWorker([](ThreadPool::Worker *) { });
+
 ThreadPool::ThreadPool(size_t max_threads)
-	: m_ID(m_NextID++), m_MaxThreads(max_threads)
+	: m_ID(m_NextID++), m_MaxThreads(max_threads), m_Queues{ { 4096 }, { 4096 } }
 {
-	if (m_MaxThreads != UINT_MAX && m_MaxThreads < sizeof(m_Queues) / sizeof(m_Queues[0]))
-		m_MaxThreads = sizeof(m_Queues) / sizeof(m_Queues[0]);
+	if (m_MaxThreads > MaxWorkers)
+		m_MaxThreads = MaxWorkers;
+
+	/* Work items may block, keep a few more threads around than there are CPUs. */
+	m_MinThreads = std::max<size_t>(8, std::thread::hardware_concurrency());
+
+	if (m_MinThreads > m_MaxThreads)
+		m_MinThreads = m_MaxThreads;
+
+	for (auto& pending : m_Pending)
+		pending.store(0);
 
 	Start();
 }
@@ -41,28 +52,39 @@ ThreadPool::ThreadPool(size_t max_threads)
 ThreadPool::~ThreadPool()
 {
 	Stop();
+
+	/* Work items which were posted while the pool was being stopped. */
+	for (auto& queue : m_Queues) {
+		WorkItem *wi;
+
+		while (queue.Pop(wi))
+			delete wi;
+	}
 }
 
 void ThreadPool::Start()
 {
+	boost::mutex::scoped_lock lock(m_MgmtMutex);
+
 	if (!m_Stopped)
 		return;
 
 	m_Stopped = false;
 
-	for (auto& queue : m_Queues)
-		queue.SpawnWorker(m_ThreadGroup);
+	for (size_t i = 0; i < m_MinThreads; i++)
+		SpawnWorker();
 
 	m_MgmtThread = std::thread(std::bind(&ThreadPool::ManagerThreadProc, this));
 }
 
 void ThreadPool::Stop()
 {
-	if (m_Stopped)
-		return;
-
 	{
 		boost::mutex::scoped_lock lock(m_MgmtMutex);
+
+		if (m_Stopped)
+			return;
+
 		m_Stopped = true;
 		m_MgmtCV.notify_all();
 	}
@@ -70,126 +92,199 @@ void ThreadPool::Stop()
 	if (m_MgmtThread.joinable())
 		m_MgmtThread.join();
 
+	{
+		boost::mutex::scoped_lock lock(m_IdleMutex);
+		m_Stopping.store(true);
+		m_IdleCV.notify_all();
+	}
+
+	boost::mutex::scoped_lock lock(m_MgmtMutex);
+
+	for (size_t i = 0; i < m_WorkerSlots.load(); i++) {
+		Worker& worker = *m_Workers[i];
+
+		if (worker.Thread.joinable())
+			worker.Thread.join();
+
+		worker.Alive = false;
+	}
+
+	m_AliveWorkers = 0;
+
+	/* Free the work items which haven't been processed. The workers are gone,
+	 * so their deques can be emptied from here. */
 	for (auto& queue : m_Queues) {
-		boost::mutex::scoped_lock lock(queue.Mutex);
-		queue.Stopped = true;
-		queue.CV.notify_all();
+		WorkItem *wi;
+
+		while (queue.Pop(wi)) {
+			m_Pending[wi->Policy].fetch_sub(1);
+			delete wi;
+		}
 	}
 
-	m_ThreadGroup.join_all();
-	m_ThreadGroup.~thread_group();
-	new (&m_ThreadGroup) boost::thread_group();
+	for (size_t i = 0; i < m_WorkerSlots.load(); i++) {
+		WorkItem *wi;
 
-	for (auto& queue : m_Queues)
-		queue.Stopped = false;
+		while ((wi = m_Workers[i]->Items.Take())) {
+			m_Pending[wi->Policy].fetch_sub(1);
+			delete wi;
+		}
+	}
 
-	m_Stopped = true;
+	m_Stopping.store(false);
 }
 
 /**
  * Waits for work items and processes them.
  */
-void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
+void ThreadPool::WorkerThreadProc(Worker& worker)
 {
 	std::ostringstream idbuf;
-	idbuf << "Q #" << &queue << " W #" << this;
+	idbuf << "TP #" << m_ID << " W #" << worker.Index;
 	Utility::SetThreadName(idbuf.str());
 
+	m_CurrentWorker.reset(&worker);
+
 	for (;;) {
-		WorkItem wi;
+		WorkItem *wi = FindWork(worker);
 
-		{
-			boost::mutex::scoped_lock lock(queue.Mutex);
+		if (wi) {
+			RunWorkItem(worker, wi);
+			continue;
+		}
 
-			UpdateUtilization(ThreadIdle);
+		boost::mutex::scoped_lock lock(m_IdleMutex);
 
-			while (queue.Items.empty() && !queue.Stopped && !Zombie) {
-				if (queue.Items.empty())
-					queue.CVStarved.notify_all();
+		m_IdleWorkers.fetch_add(1);
 
-				queue.CV.wait(lock);
-			}
+		/* Pairs with the increment of m_Pending in Post(): either we see the
+		 * new work item here or the producer sees us as idle and notifies us.
+		 */
+		while (m_Pending[LowLatencyScheduler].load() + m_Pending[DefaultScheduler].load() == 0
+			&& !m_Stopping.load() && !worker.Retire.load())
+			m_IdleCV.wait(lock);
 
-			if (Zombie)
-				break;
+		m_IdleWorkers.fetch_sub(1);
 
-			if (queue.Items.empty() && queue.Stopped)
-				break;
+		if (m_Pending[LowLatencyScheduler].load() + m_Pending[DefaultScheduler].load() > 0) {
+			lock.unlock();
 
-			wi = queue.Items.front();
-			queue.Items.pop_front();
+			/* The item might be taken by another worker right now, don't spin on the lock. */
+			std::this_thread::yield();
+			continue;
+		}
+
+		if (m_Stopping.load() || worker.Retire.load())
+			break;
+	}
+
+	m_CurrentWorker.reset();
+	worker.Exited.store(true);
+}
+
+/**
+ * Returns the next work item for a worker: latency-sensitive items first,
+ * then the worker's own deque, then the shared queue, and finally items
+ * stolen from other workers.
+ */
+ThreadPool::WorkItem *ThreadPool::FindWork(Worker& worker)
+{
+	WorkItem *wi = nullptr;
 
-			UpdateUtilization(ThreadBusy);
+	if (!m_Queues[LowLatencyScheduler].Pop(wi))
+		wi = worker.Items.Take();
+
+	if (!wi && !m_Queues[DefaultScheduler].Pop(wi))
+		wi = nullptr;
+
+	if (!wi) {
+		size_t slots = m_WorkerSlots.load(std::memory_order_acquire);
+
+		if (slots > 1) {
+			size_t start = Utility::Random() % slots;
+
+			for (size_t i = 0; i < slots && !wi; i++) {
+				Worker& victim = *m_Workers[(start + i) % slots];
+
+				if (&victim != &worker)
+					wi = victim.Items.Steal();
+			}
 		}
+	}
+
+	if (wi)
+		m_Pending[wi->Policy].fetch_sub(1);
+
+	return wi;
+}
 
-		double st = Utility::GetTime();
+void ThreadPool::RunWorkItem(Worker& worker, WorkItem *wi)
+{
+	double st = Utility::GetTime();
 
 #ifdef I2_DEBUG
 #	ifdef RUSAGE_THREAD
-		struct rusage usage_start, usage_end;
+	struct rusage usage_start, usage_end;
 
-		(void) getrusage(RUSAGE_THREAD, &usage_start);
+	(void) getrusage(RUSAGE_THREAD, &usage_start);
 #	endif /* RUSAGE_THREAD */
 #endif /* I2_DEBUG */
 
-		try {
-			if (wi.Callback)
-				wi.Callback();
-		} catch (const std::exception& ex) {
-			Log(LogCritical, "ThreadPool")
-				<< "Exception thrown in event handler:\n"
-				<< DiagnosticInformation(ex);
-		} catch (...) {
-			Log(LogCritical, "ThreadPool", "Exception of unknown type thrown in event handler.");
-		}
+	try {
+		if (wi->Callback)
+			wi->Callback();
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "ThreadPool")
+			<< "Exception thrown in event handler:\n"
+			<< DiagnosticInformation(ex);
+	} catch (...) {
+		Log(LogCritical, "ThreadPool", "Exception of unknown type thrown in event handler.");
+	}
 
-		double et = Utility::GetTime();
-		double latency = st - wi.Timestamp;
+	double et = Utility::GetTime();
+	double latency = st - wi->Timestamp;
 
-		{
-			boost::mutex::scoped_lock lock(queue.Mutex);
+	/* Only this worker writes its counters, the manager merely reads them. */
+	LaneCounters& counters = worker.Counters[wi->Policy];
+	counters.TaskCount.store(counters.TaskCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	counters.WaitTime.store(counters.WaitTime.load(std::memory_order_relaxed) + static_cast<uint64_t>(std::max(latency, 0.0) * 1000000), std::memory_order_relaxed);
+	counters.ServiceTime.store(counters.ServiceTime.load(std::memory_order_relaxed) + static_cast<uint64_t>(std::max(et - st, 0.0) * 1000000), std::memory_order_relaxed);
 
-			queue.WaitTime += latency;
-			queue.ServiceTime += et - st;
-			queue.TaskCount++;
-		}
+	delete wi;
 
 #ifdef I2_DEBUG
 #	ifdef RUSAGE_THREAD
-		(void) getrusage(RUSAGE_THREAD, &usage_end);
+	(void) getrusage(RUSAGE_THREAD, &usage_end);
 
-		double duser = (usage_end.ru_utime.tv_sec - usage_start.ru_utime.tv_sec) +
-			(usage_end.ru_utime.tv_usec - usage_start.ru_utime.tv_usec) / 1000000.0;
+	double duser = (usage_end.ru_utime.tv_sec - usage_start.ru_utime.tv_sec) +
+		(usage_end.ru_utime.tv_usec - usage_start.ru_utime.tv_usec) / 1000000.0;
 
-		double dsys = (usage_end.ru_stime.tv_sec - usage_start.ru_stime.tv_sec) +
-			(usage_end.ru_stime.tv_usec - usage_start.ru_stime.tv_usec) / 1000000.0;
+	double dsys = (usage_end.ru_stime.tv_sec - usage_start.ru_stime.tv_sec) +
+		(usage_end.ru_stime.tv_usec - usage_start.ru_stime.tv_usec) / 1000000.0;
 
-		double dwait = (et - st) - (duser + dsys);
+	double dwait = (et - st) - (duser + dsys);
 
-		int dminfaults = usage_end.ru_minflt - usage_start.ru_minflt;
-		int dmajfaults = usage_end.ru_majflt - usage_start.ru_majflt;
+	int dminfaults = usage_end.ru_minflt - usage_start.ru_minflt;
+	int dmajfaults = usage_end.ru_majflt - usage_start.ru_majflt;
 
-		int dvctx = usage_end.ru_nvcsw - usage_start.ru_nvcsw;
-		int divctx = usage_end.ru_nivcsw - usage_start.ru_nivcsw;
+	int dvctx = usage_end.ru_nvcsw - usage_start.ru_nvcsw;
+	int divctx = usage_end.ru_nivcsw - usage_start.ru_nivcsw;
 #	endif /* RUSAGE_THREAD */
-		if (et - st > 0.5) {
-			Log(LogWarning, "ThreadPool")
+	if (et - st > 0.5) {
+		Log(LogWarning, "ThreadPool")
 #	ifdef RUSAGE_THREAD
-				<< "Event call took user:" << duser << "s, system:" << dsys << "s, wait:" << dwait << "s, minor_faults:" << dminfaults << ", major_faults:" << dmajfaults << ", voluntary_csw:" << dvctx << ", involuntary_csw:" << divctx;
+			<< "Event call took user:" << duser << "s, system:" << dsys << "s, wait:" << dwait << "s, minor_faults:" << dminfaults << ", major_faults:" << dmajfaults << ", voluntary_csw:" << dvctx << ", involuntary_csw:" << divctx;
 #	else
-				<< "Event call took " << (et - st) << "s";
+			<< "Event call took " << (et - st) << "s";
 #	endif /* RUSAGE_THREAD */
-		}
-#endif /* I2_DEBUG */
 	}
-
-	boost::mutex::scoped_lock lock(queue.Mutex);
-	UpdateUtilization(ThreadDead);
-	Zombie = false;
+#endif /* I2_DEBUG */
 }
 
 /**
- * Appends a work item to the work queue. Work items will be processed in FIFO order.
+ * Appends a work item to the work queue. Work items posted from one of the
+ * pool's own worker threads are put into that worker's deque, all others
+ * are processed in roughly FIFO order.
  *
  * @param callback The callback function for the work item.
  * @param policy The scheduling policy
@@ -197,202 +292,335 @@ void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
  */
 bool ThreadPool::Post(const ThreadPool::WorkFunction& callback, SchedulerPolicy policy)
 {
-	WorkItem wi;
-	wi.Callback = callback;
-	wi.Timestamp = Utility::GetTime();
+	if (m_Stopping.load())
+		return false;
 
-	Queue& queue = m_Queues[Utility::Random() % (sizeof(m_Queues) / sizeof(m_Queues[0]))];
+	WorkItem *wi = new WorkItem();
+	wi->Callback = callback;
+	wi->Timestamp = Utility::GetTime();
+	wi->Policy = policy;
 
-	{
-		boost::mutex::scoped_lock lock(queue.Mutex);
+	Worker *worker = m_CurrentWorker.get();
+
+	if (policy == DefaultScheduler && worker && worker->Pool == this)
+		worker->Items.Push(wi);
+	else
+		m_Queues[policy].Push(wi);
+
+	m_Pending[policy].fetch_add(1);
+
+	WakeWorker();
+
+	/* Don't let latency-sensitive items wait for a busy worker. We must not
+	 * block on m_MgmtMutex here: Stop() holds it while joining the workers
+	 * and we might be running on one of them. Leave it to the manager thread
+	 * if the mutex is busy. */
+	if (policy == LowLatencyScheduler && m_IdleWorkers.load() == 0) {
+		boost::mutex::scoped_try_lock lock(m_MgmtMutex);
+
+		if (!lock.owns_lock()) {
+			m_SpawnRequested.store(true);
+			m_MgmtCV.notify_all();
+		} else if (!m_Stopped)
+			SpawnWorker();
+	}
+
+	return true;
+}
+
+void ThreadPool::WakeWorker()
+{
+	if (m_IdleWorkers.load() == 0)
+		return;
+
+	boost::mutex::scoped_lock lock(m_IdleMutex);
+	m_IdleCV.notify_one();
+}
+
+/**
+ * Note: Caller must hold m_MgmtMutex.
+ */
+bool ThreadPool::SpawnWorker()
+{
+	if (m_AliveWorkers >= m_MaxThreads)
+		return false;
+
+	ReapWorkers();
+
+	size_t slots = m_WorkerSlots.load();
+	Worker *worker = nullptr;
 
-		if (queue.Stopped)
+	for (size_t i = 0; i < slots; i++) {
+		if (!m_Workers[i]->Alive) {
+			worker = m_Workers[i].get();
+			break;
+		}
+	}
+
+	if (!worker) {
+		if (slots >= MaxWorkers)
 			return false;
 
-		if (policy == LowLatencyScheduler)
-			queue.SpawnWorker(m_ThreadGroup);
+		m_Workers[slots].reset(new Worker());
+		worker = m_Workers[slots].get();
+		worker->Pool = this;
+		worker->Index = slots;
 
-		queue.Items.emplace_back(std::move(wi));
-		queue.CV.notify_one();
+		/* Publish the new slot to thieves only once it is fully set up. */
+		m_WorkerSlots.store(slots + 1, std::memory_order_release);
 	}
 
+	Log(LogDebug, "ThreadPool", "Spawning worker thread.");
+
+	worker->Alive = true;
+	worker->Exited.store(false);
+	worker->Retire.store(false);
+	worker->Thread = std::thread(std::bind(&ThreadPool::WorkerThreadProc, this, std::ref(*worker)));
+
+	m_AliveWorkers++;
+
 	return true;
 }
 
+/**
+ * Joins worker threads which have exited after being retired.
+ *
+ * Note: Caller must hold m_MgmtMutex.
+ */
+void ThreadPool::ReapWorkers()
+{
+	size_t slots = m_WorkerSlots.load();
+
+	for (size_t i = 0; i < slots; i++) {
+		Worker& worker = *m_Workers[i];
+
+		if (worker.Alive && worker.Exited.load()) {
+			worker.Thread.join();
+			worker.Alive = false;
+		}
+	}
+}
+
+ThreadPoolStatistics ThreadPool::GetStatistics() const
+{
+	boost::mutex::scoped_lock lock(m_MgmtMutex);
+
+	ThreadPoolStatistics stats = m_Stats;
+	stats.Threads = m_AliveWorkers;
+	stats.IdleThreads = m_IdleWorkers.load();
+
+	for (int i = 0; i < 2; i++)
+		stats.Lanes[i].Pending = m_Pending[i].load();
+
+	return stats;
+}
+
 void ThreadPool::ManagerThreadProc()
 {
 	std::ostringstream idbuf;
 	idbuf << "TP #" << m_ID << " Manager";
 	Utility::SetThreadName(idbuf.str());
 
-	double lastStats = 0;
+	double lastStats = Utility::GetTime();
+	uint64_t lastCounters[2][3] = {};
+	int idleTicks = 0;
 
 	for (;;) {
-		size_t total_pending = 0, total_alive = 0;
-		double total_avg_latency = 0;
-		double total_utilization = 0;
-
-		{
-			boost::mutex::scoped_lock lock(m_MgmtMutex);
-
-			if (!m_Stopped)
-				m_MgmtCV.timed_wait(lock, boost::posix_time::milliseconds(500));
+		boost::mutex::scoped_lock lock(m_MgmtMutex);
 
-			if (m_Stopped)
-				break;
-		}
+		if (!m_Stopped && !m_SpawnRequested.load())
+			m_MgmtCV.timed_wait(lock, boost::posix_time::milliseconds(500));
 
-		for (auto& queue : m_Queues) {
-			size_t pending, alive = 0;
-			double avg_latency;
-			double utilization = 0;
+		if (m_Stopped)
+			break;
 
-				boost::mutex::scoped_lock lock(queue.Mutex);
+		ReapWorkers();
 
-			for (auto& thread : queue.Threads)
-				thread.UpdateUtilization();
+		m_SpawnRequested.store(false);
 
-			pending = queue.Items.size();
+		size_t idle = m_IdleWorkers.load();
+		size_t pending = m_Pending[DefaultScheduler].load() + m_Pending[LowLatencyScheduler].load();
+		int tthreads = 0;
 
-			for (auto& thread : queue.Threads) {
-				if (thread.State != ThreadDead && !thread.Zombie) {
-					alive++;
-					utilization += thread.Utilization * 100;
-				}
-			}
+		/* All workers are busy (or blocked) and there's outstanding work. */
+		if (pending > 0 && idle == 0)
+			tthreads = 2;
 
-			utilization /= alive;
+		/* Retire one surplus worker at a time once it's been idle for a while. */
+		if (idle > 2)
+			idleTicks++;
+		else
+			idleTicks = 0;
 
-			if (queue.TaskCount > 0)
-				avg_latency = queue.WaitTime / (queue.TaskCount * 1.0);
-			else
-				avg_latency = 0;
+		if (idleTicks >= 10 && m_AliveWorkers > m_MinThreads) {
+			tthreads = -1;
+			idleTicks = 0;
+		}
 
-			if (utilization < 60 || utilization > 80 || alive < 8) {
-				double wthreads = std::ceil((utilization * alive) / 80.0);
+		if (tthreads != 0) {
+			Log(LogNotice, "ThreadPool")
+				<< "Thread pool; current: " << m_AliveWorkers << "; adjustment: " << tthreads;
+		}
 
-				int tthreads = wthreads - alive;
+		for (int i = 0; i < tthreads; i++)
+			SpawnWorker();
 
-				/* Make sure there is at least one thread per queue */
-				if (alive + tthreads < 1)
-					tthreads = 1 - alive;
+		if (tthreads < 0) {
+			for (size_t i = 0; i < m_WorkerSlots.load(); i++) {
+				Worker& worker = *m_Workers[i];
 
-				/* Don't kill more than 2 threads at once. */
-				if (tthreads < -2)
-					tthreads = -2;
+				if (worker.Alive && !worker.Retire.load()) {
+					Log(LogDebug, "ThreadPool", "Killing worker thread.");
 
-				/* Spawn more workers if there are outstanding work items. */
-				if (tthreads > 0 && pending > 0)
-					tthreads = 2;
+					worker.Retire.store(true);
+					m_AliveWorkers--;
 
-				if (m_MaxThreads != UINT_MAX && (alive + tthreads) * (sizeof(m_Queues) / sizeof(m_Queues[0])) > m_MaxThreads)
-					tthreads = m_MaxThreads / (sizeof(m_Queues) / sizeof(m_Queues[0])) - alive;
+					boost::mutex::scoped_lock ilock(m_IdleMutex);
+					m_IdleCV.notify_all();
 
-				if (tthreads != 0) {
-					Log(LogNotice, "ThreadPool")
-						<< "Thread pool; current: " << alive << "; adjustment: " << tthreads;
+					break;
 				}
-
-				for (int i = 0; i < -tthreads; i++)
-					queue.KillWorker(m_ThreadGroup);
-
-				for (int i = 0; i < tthreads; i++)
-					queue.SpawnWorker(m_ThreadGroup);
 			}
-
-			queue.WaitTime = 0;
-			queue.ServiceTime = 0;
-			queue.TaskCount = 0;
-
-			total_pending += pending;
-			total_alive += alive;
-			total_avg_latency += avg_latency;
-			total_utilization += utilization;
 		}
 
 		double now = Utility::GetTime();
 
 		if (lastStats < now - 15) {
+			double interval = now - lastStats;
 			lastStats = now;
 
+			for (int lane = 0; lane < 2; lane++) {
+				uint64_t counters[3] = {};
+
+				for (size_t i = 0; i < m_WorkerSlots.load(); i++) {
+					const LaneCounters& wc = m_Workers[i]->Counters[lane];
+
+					counters[0] += wc.TaskCount.load(std::memory_order_relaxed);
+					counters[1] += wc.WaitTime.load(std::memory_order_relaxed);
+					counters[2] += wc.ServiceTime.load(std::memory_order_relaxed);
+				}
+
+				uint64_t tasks = counters[0] - lastCounters[lane][0];
+				ThreadPoolLaneStatistics& ls = m_Stats.Lanes[lane];
+
+				ls.TaskRate = tasks / interval;
+
+				if (tasks > 0) {
+					ls.AvgWaitTime = (counters[1] - lastCounters[lane][1]) / 1000000.0 / tasks;
+					ls.AvgServiceTime = (counters[2] - lastCounters[lane][2]) / 1000000.0 / tasks;
+				} else {
+					ls.AvgWaitTime = 0;
+					ls.AvgServiceTime = 0;
+				}
+
+				std::copy(counters, counters + 3, lastCounters[lane]);
+			}
+
 			Log(LogNotice, "ThreadPool")
-				<< "Pool #" << m_ID << ": Pending tasks: " << total_pending << "; Average latency: "
-				<< (long)(total_avg_latency * 1000 / (sizeof(m_Queues) / sizeof(m_Queues[0]))) << "ms"
-				<< "; Threads: " << total_alive
-				<< "; Pool utilization: " << (total_utilization / (sizeof(m_Queues) / sizeof(m_Queues[0]))) << "%";
+				<< "Pool #" << m_ID << ": Pending tasks: " << pending << "; Average latency: "
+				<< (long)(m_Stats.Lanes[DefaultScheduler].AvgWaitTime * 1000) << "ms"
+				<< "; Low latency average: " << (long)(m_Stats.Lanes[LowLatencyScheduler].AvgWaitTime * 1000) << "ms"
+				<< "; Threads: " << m_AliveWorkers << "; Idle: " << idle;
 		}
 	}
 }
 
-/**
- * Note: Caller must hold m_Mutex
- */
-void ThreadPool::Queue::SpawnWorker(boost::thread_group& group)
+ThreadPool::WorkStealingDeque::Buffer::Buffer(size_t size)
+	: Mask(size - 1), Items(new std::atomic<WorkItem *>[size])
+{ }
+
+ThreadPool::WorkItem *ThreadPool::WorkStealingDeque::Buffer::Get(int64_t index) const
 {
-	for (auto& thread : Threads) {
-		if (thread.State == ThreadDead) {
-			Log(LogDebug, "ThreadPool", "Spawning worker thread.");
+	return Items[index & Mask].load(std::memory_order_relaxed);
+}
 
-			thread = WorkerThread(ThreadIdle);
-			thread.Thread = group.create_thread(std::bind(&ThreadPool::WorkerThread::ThreadProc, std::ref(thread), std::ref(*this)));
+void ThreadPool::WorkStealingDeque::Buffer::Put(int64_t index, WorkItem *item)
+{
+	Items[index & Mask].store(item, std::memory_order_relaxed);
+}
 
-			break;
-		}
-	}
+ThreadPool::WorkStealingDeque::WorkStealingDeque()
+{
+	m_Buffers.emplace_back(new Buffer(64));
+	m_Buffer.store(m_Buffers.back().get());
 }
 
-/**
- * Note: Caller must hold Mutex.
+ThreadPool::WorkStealingDeque::~WorkStealingDeque()
+{
+	WorkItem *wi;
+
+	while ((wi = Take()))
+		delete wi;
+}
+
+/* The memory orderings follow "Correct and Efficient Work-Stealing for
+ * Weak Memory Models" (Lê et al., 2013), except that Push() uses a release
+ * store instead of a release fence, which is the same on x86 and is
+ * understood by ThreadSanitizer.
  */
-void ThreadPool::Queue::KillWorker(boost::thread_group& group)
+void ThreadPool::WorkStealingDeque::Push(WorkItem *item)
 {
-	for (auto& thread : Threads) {
-		if (thread.State == ThreadIdle && !thread.Zombie) {
-			Log(LogDebug, "ThreadPool", "Killing worker thread.");
+	int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+	int64_t top = m_Top.load(std::memory_order_acquire);
+	Buffer *buffer = m_Buffer.load(std::memory_order_relaxed);
 
-			group.remove_thread(thread.Thread);
-			thread.Thread->detach();
-			delete thread.Thread;
+	if (bottom - top > static_cast<int64_t>(buffer->Mask)) {
+		std::unique_ptr<Buffer> grown(new Buffer((buffer->Mask + 1) * 2));
 
-			thread.Zombie = true;
-			CV.notify_all();
+		for (int64_t i = top; i < bottom; i++)
+			grown->Put(i, buffer->Get(i));
 
-			break;
-		}
+		buffer = grown.get();
+		m_Buffers.emplace_back(std::move(grown));
+		m_Buffer.store(buffer, std::memory_order_release);
 	}
+
+	buffer->Put(bottom, item);
+	m_Bottom.store(bottom + 1, std::memory_order_release);
 }
 
-/**
- * Note: Caller must hold queue Mutex.
- */
-void ThreadPool::WorkerThread::UpdateUtilization(ThreadState state)
+ThreadPool::WorkItem *ThreadPool::WorkStealingDeque::Take()
 {
-	double utilization;
+	int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+	Buffer *buffer = m_Buffer.load(std::memory_order_relaxed);
+	m_Bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_Top.load(std::memory_order_relaxed);
+
+	if (top > bottom) {
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
 
-	switch (State) {
-		case ThreadDead:
-			return;
-		case ThreadIdle:
-			utilization = 0;
-			break;
-		case ThreadBusy:
-			utilization = 1;
-			break;
-		default:
-			VERIFY(0);
+	WorkItem *item = buffer->Get(bottom);
+
+	if (top == bottom) {
+		/* Last item, race against thieves. */
+		if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			item = nullptr;
+
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
 	}
 
-	double now = Utility::GetTime();
-	double time = now - LastUpdate;
+	return item;
+}
 
-	const double avg_time = 5.0;
+ThreadPool::WorkItem *ThreadPool::WorkStealingDeque::Steal()
+{
+	for (;;) {
+		int64_t top = m_Top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t bottom = m_Bottom.load(std::memory_order_acquire);
 
-	if (time > avg_time)
-		time = avg_time;
+		if (top >= bottom)
+			return nullptr;
 
-	Utilization = (Utilization * (avg_time - time) + utilization * time) / avg_time;
-	LastUpdate = now;
+		Buffer *buffer = m_Buffer.load(std::memory_order_acquire);
+		WorkItem *item = buffer->Get(top);
 
-	if (state != ThreadUnspecified)
-		State = state;
+		if (m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return item;
+
+		/* Lost against the owner or another thief, try again. */
+	}
 }
@@ -21,17 +21,20 @@
 #define THREADPOOL_H
 
 #include "base/i2-base.hpp"
+#include "base/concurrentqueue.hpp"
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
+#include <boost/thread/tss.hpp>
+#include <atomic>
 #include <deque>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace icinga
 {
 
-#define QUEUECOUNT 4U
-
 enum SchedulerPolicy
 {
 	DefaultScheduler,
@@ -39,7 +42,38 @@ enum SchedulerPolicy
 };
 
 /**
- * A thread pool.
+ * Wait and service time statistics for one of the thread pool's scheduling lanes.
+ *
+ * @ingroup base
+ */
+struct ThreadPoolLaneStatistics
+{
+	size_t Pending{0};
+	double TaskRate{0};
+	double AvgWaitTime{0};
+	double AvgServiceTime{0};
+};
+
+/**
+ * Statistics for a thread pool.
+ *
+ * @ingroup base
+ */
+struct ThreadPoolStatistics
+{
+	size_t Threads{0};
+	size_t IdleThreads{0};
+	ThreadPoolLaneStatistics Lanes[2];
+};
+
+/**
+ * A work-stealing thread pool.
+ *
+ * Each worker thread has its own deque. Work items which are posted by
+ * a worker go into that worker's deque, all other work items go into a
+ * shared injection queue. Idle workers steal from other workers' deques.
+ * Work items using the LowLatencyScheduler policy have their own lane
+ * which is always served first.
  *
  * @ingroup base
  */
@@ -56,73 +90,116 @@ public:
 
 	bool Post(const WorkFunction& callback, SchedulerPolicy policy = DefaultScheduler);
 
+	ThreadPoolStatistics GetStatistics() const;
+
 private:
-	enum ThreadState
-	{
-		ThreadUnspecified,
-		ThreadDead,
-		ThreadIdle,
-		ThreadBusy
-	};
+	static const size_t MaxWorkers = 256;
 
 	struct WorkItem
 	{
 		WorkFunction Callback;
 		double Timestamp;
+		SchedulerPolicy Policy;
 	};
 
-	struct Queue;
-
-	struct WorkerThread
+	/**
+	 * A Chase-Lev work-stealing deque. Only the owning worker may call
+	 * Push() and Take(), any thread may call Steal().
+	 */
+	class WorkStealingDeque
 	{
-		ThreadState State{ThreadDead};
-		bool Zombie{false};
-		double Utilization{0};
-		double LastUpdate{0};
-		boost::thread *Thread{nullptr};
-
-		WorkerThread(ThreadState state = ThreadDead)
-			: State(state)
-		{ }
-
-		void UpdateUtilization(ThreadState state = ThreadUnspecified);
-
-		void ThreadProc(Queue& queue);
+	public:
+		WorkStealingDeque();
+		~WorkStealingDeque();
+
+		void Push(WorkItem *item);
+		WorkItem *Take();
+		WorkItem *Steal();
+
+	private:
+		struct Buffer
+		{
+			size_t Mask;
+			std::unique_ptr<std::atomic<WorkItem *>[]> Items;
+
+			Buffer(size_t size);
+
+			WorkItem *Get(int64_t index) const;
+			void Put(int64_t index, WorkItem *item);
+		};
+
+		std::atomic<int64_t> m_Top{0};
+		std::atomic<int64_t> m_Bottom{0};
+		std::atomic<Buffer *> m_Buffer;
+
+		/* Buffers which were replaced when growing. Thieves might still be
+		 * reading from them so they are only freed with the deque.
+		 */
+		std::vector<std::unique_ptr<Buffer> > m_Buffers;
 	};
 
-	struct Queue
+	struct LaneCounters
 	{
-		boost::mutex Mutex;
-		boost::condition_variable CV;
-		boost::condition_variable CVStarved;
+		std::atomic<uint64_t> TaskCount{0};
+		std::atomic<uint64_t> WaitTime{0};
+		std::atomic<uint64_t> ServiceTime{0};
+	};
 
-		std::deque<WorkItem> Items;
+	struct Worker
+	{
+		ThreadPool *Pool;
+		size_t Index;
+		std::thread Thread;
 
-		double WaitTime{0};
-		double ServiceTime{0};
-		int TaskCount{0};
+		/* Set by the manager, guarded by m_MgmtMutex. */
+		bool Alive{false};
 
-		bool Stopped{false};
+		std::atomic<bool> Exited{false};
+		std::atomic<bool> Retire{false};
 
-		WorkerThread Threads[16];
+		WorkStealingDeque Items;
 
-		void SpawnWorker(boost::thread_group& group);
-		void KillWorker(boost::thread_group& group);
+		/* Microseconds, only written by the worker itself. */
+		LaneCounters Counters[2];
 	};
 
 	int m_ID;
 	static int m_NextID;
 
 	size_t m_MaxThreads;
+	size_t m_MinThreads;
+
+	static boost::thread_specific_ptr<Worker> m_CurrentWorker;
+
+	std::unique_ptr<Worker> m_Workers[MaxWorkers];
+	std::atomic<size_t> m_WorkerSlots{0};
+
+	ConcurrentQueue<WorkItem *> m_Queues[2];
+	std::atomic<size_t> m_Pending[2];
 
-	boost::thread_group m_ThreadGroup;
+	boost::mutex m_IdleMutex;
+	boost::condition_variable m_IdleCV;
+	std::atomic<size_t> m_IdleWorkers{0};
+
+	std::atomic<bool> m_Stopping{false};
 
 	std::thread m_MgmtThread;
-	boost::mutex m_MgmtMutex;
+	mutable boost::mutex m_MgmtMutex;
 	boost::condition_variable m_MgmtCV;
 	bool m_Stopped{true};
+	size_t m_AliveWorkers{0};
+
+	/* Set by Post() when it couldn't spawn a worker for a latency-sensitive item itself. */
+	std::atomic<bool> m_SpawnRequested{false};
+	ThreadPoolStatistics m_Stats;
+
+	void WorkerThreadProc(Worker& worker);
+	WorkItem *FindWork(Worker& worker);
+	void RunWorkItem(Worker& worker, WorkItem *wi);
+	void WakeWorker();
 
-	Queue m_Queues[QUEUECOUNT];
+	bool SpawnWorker();
+	void ReapWorkers();
 
 	void ManagerThreadProc();
 };
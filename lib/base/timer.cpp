@@ -23,57 +23,46 @@
 #include "base/utility.hpp"
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/key_extractors.hpp>
+#include <cmath>
+#include <limits>
 #include <thread>
 
 using namespace icinga;
 
-namespace icinga {
-
-class TimerHolder {
-public:
-	TimerHolder(Timer *timer)
-		: m_Timer(timer)
-	{ }
-
-	inline Timer *GetObject() const
-	{
-		return m_Timer;
-	}
-
-	inline double GetNextUnlocked() const
-	{
-		return m_Timer->m_Next;
-	}
-
-	operator Timer *() const
-	{
-		return m_Timer;
-	}
-
-private:
-	Timer *m_Timer;
-};
-
-}
-
-typedef boost::multi_index_container<
-	TimerHolder,
-	boost::multi_index::indexed_by<
-		boost::multi_index::ordered_unique<boost::multi_index::const_mem_fun<TimerHolder, Timer *, &TimerHolder::GetObject> >,
-		boost::multi_index::ordered_non_unique<boost::multi_index::const_mem_fun<TimerHolder, double, &TimerHolder::GetNextUnlocked> >
-	>
-> TimerSet;
+/* Timers are kept in a hierarchical timing wheel: level 0 has one slot per
+ * tick, each slot on level n covers a whole rotation of level n - 1. Timers
+ * which are due too far in the future for level 0 are moved ("cascaded")
+ * to the lower levels when their slot comes up.
+ */
+static const double l_TimerTick = 0.01;
+static const int l_WheelBits = 8;
+static const int64_t l_WheelSize = 1 << l_WheelBits;
+static const int64_t l_WheelMask = l_WheelSize - 1;
+static const int l_WheelLevels = 4;
 
 static boost::mutex l_TimerMutex;
 static boost::condition_variable l_TimerCV;
 static std::thread l_TimerThread;
 static bool l_StopTimerThread;
-static TimerSet l_Timers;
 static int l_AliveTimers = 0;
 
+static Timer *l_Wheel[l_WheelLevels][l_WheelSize];
+static size_t l_WheelTimers = 0;
+static int64_t l_CurrentTick = 0; /**< The next tick the timer thread is going to process. */
+static int64_t l_WakeTick = std::numeric_limits<int64_t>::max(); /**< When the timer thread is going to wake up. */
+
+static double l_LagSum = 0;
+static double l_LagMax = 0;
+static size_t l_LagCount = 0;
+static double l_LagWindowStart = 0;
+static double l_LastAvgLag = 0;
+static double l_LastMaxLag = 0;
+
+static int64_t TimeToTick(double ts)
+{
+	return static_cast<int64_t>(std::ceil(ts / l_TimerTick));
+}
+
 /**
  * Destructor for the Timer class.
  */
@@ -123,18 +112,22 @@ void Timer::UninitializeThread()
 
 /**
  * Calls this timer.
+ *
+ * @param due When the timer was due.
  */
-void Timer::Call()
+void Timer::Call(double due)
 {
+	double lag = Utility::GetTime() - due;
+
 	try {
 		OnTimerExpired(Timer::Ptr(this));
 	} catch (...) {
-		InternalReschedule(true);
+		InternalReschedule(true, -1, lag);
 
 		throw;
 	}
 
-	InternalReschedule(true);
+	InternalReschedule(true, -1, lag);
 }
 
 /**
@@ -191,11 +184,10 @@ void Timer::Stop(bool wait)
 	}
 
 	m_Started = false;
-	l_Timers.erase(this);
-
-	/* Notify the worker thread that we've disabled a timer. */
-	l_TimerCV.notify_all();
+	WheelRemove(this);
 
+	/* Removing a timer never makes the timer thread wake up earlier,
+	 * only wake it up if someone is waiting for the callback to finish. */
 	while (wait && m_Running)
 		l_TimerCV.wait(lock);
 }
@@ -211,14 +203,25 @@ void Timer::Reschedule(double next)
  * @param completed Whether the timer has just completed its callback.
  * @param next The time when this timer should be called again. Use -1 to let
  *        the timer figure out a suitable time based on the interval.
+ * @param lag How late the callback was called, only used when completed is true.
  */
-void Timer::InternalReschedule(bool completed, double next)
+void Timer::InternalReschedule(bool completed, double next, double lag)
 {
 	boost::mutex::scoped_lock lock(l_TimerMutex);
 
-	if (completed)
+	if (completed) {
 		m_Running = false;
 
+		l_LagSum += lag;
+		l_LagCount++;
+
+		if (lag > l_LagMax)
+			l_LagMax = lag;
+
+		/* Stop(true) might be waiting for the callback to finish. */
+		l_TimerCV.notify_all();
+	}
+
 	if (next < 0) {
 		/* Don't schedule the next call if this is not a periodic timer. */
 		if (m_Interval <= 0)
@@ -230,12 +233,17 @@ void Timer::InternalReschedule(bool completed, double next)
 	m_Next = next;
 
 	if (m_Started && !m_Running) {
-		/* Remove and re-add the timer to update the index. */
-		l_Timers.erase(this);
-		l_Timers.insert(this);
+		WheelRemove(this);
 
-		/* Notify the worker that we've rescheduled a timer. */
-		l_TimerCV.notify_all();
+		/* The timer thread doesn't advance the wheel while it's empty. */
+		if (l_WheelTimers == 0)
+			l_CurrentTick = static_cast<int64_t>(std::floor(Utility::GetTime() / l_TimerTick));
+
+		WheelInsert(this);
+
+		/* Only wake up the worker if this timer is due before it would wake up anyway. */
+		if (m_WheelTick < l_WakeTick)
+			l_TimerCV.notify_all();
 	}
 }
 
@@ -262,26 +270,184 @@ void Timer::AdjustTimers(double adjustment)
 
 	double now = Utility::GetTime();
 
-	typedef boost::multi_index::nth_index<TimerSet, 1>::type TimerView;
-	TimerView& idx = boost::get<1>(l_Timers);
+	for (auto& level : l_Wheel) {
+		for (Timer *head : level) {
+			for (Timer *timer = head; timer; timer = timer->m_WheelNext) {
+				if (std::fabs(now - (timer->m_Next + adjustment)) <
+					std::fabs(now - timer->m_Next)) {
+					timer->m_Next += adjustment;
+				}
+			}
+		}
+	}
+
+	/* The clock has jumped, re-sort all timers relative to the new time. */
+	WheelRebuild(static_cast<int64_t>(std::floor(now / l_TimerTick)));
+
+	/* Notify the worker that we've rescheduled some timers. */
+	l_TimerCV.notify_all();
+}
+
+/**
+ * Returns the number of active timers and how late timer callbacks
+ * were called during the last minute.
+ */
+TimerStatistics Timer::GetStatistics()
+{
+	boost::mutex::scoped_lock lock(l_TimerMutex);
+
+	TimerStatistics stats;
+	stats.Timers = l_AliveTimers;
+	stats.AvgLag = l_LastAvgLag;
+	stats.MaxLag = l_LastMaxLag;
+
+	return stats;
+}
+
+/**
+ * Adds a timer to the wheel.
+ *
+ * Note: Caller must hold l_TimerMutex.
+ */
+void Timer::WheelInsert(Timer *timer)
+{
+	int64_t tick = TimeToTick(timer->m_Next);
+
+	if (tick < l_CurrentTick)
+		tick = l_CurrentTick;
+
+	timer->m_WheelTick = tick;
+
+	int64_t delta = tick - l_CurrentTick;
+	int level = 0;
+
+	while (level < l_WheelLevels - 1 && delta >= (int64_t(1) << (l_WheelBits * (level + 1))))
+		level++;
+
+	/* Timers beyond the wheel's range are parked in the farthest slot and re-sorted from there. */
+	int64_t maxDelta = (int64_t(1) << (l_WheelBits * l_WheelLevels)) - 1;
+
+	if (delta > maxDelta)
+		tick = l_CurrentTick + maxDelta;
 
+	Timer **slot = &l_Wheel[level][(tick >> (l_WheelBits * level)) & l_WheelMask];
+
+	timer->m_WheelSlot = slot;
+	timer->m_WheelPrev = nullptr;
+	timer->m_WheelNext = *slot;
+
+	if (*slot)
+		(*slot)->m_WheelPrev = timer;
+
+	*slot = timer;
+
+	l_WheelTimers++;
+}
+
+/**
+ * Removes a timer from the wheel if it's in it.
+ *
+ * Note: Caller must hold l_TimerMutex.
+ */
+void Timer::WheelRemove(Timer *timer)
+{
+	if (!timer->m_WheelSlot)
+		return;
+
+	if (timer->m_WheelPrev)
+		timer->m_WheelPrev->m_WheelNext = timer->m_WheelNext;
+	else
+		*timer->m_WheelSlot = timer->m_WheelNext;
+
+	if (timer->m_WheelNext)
+		timer->m_WheelNext->m_WheelPrev = timer->m_WheelPrev;
+
+	timer->m_WheelSlot = nullptr;
+	timer->m_WheelPrev = nullptr;
+	timer->m_WheelNext = nullptr;
+
+	l_WheelTimers--;
+}
+
+/**
+ * Re-inserts all timers relative to a new current tick.
+ *
+ * Note: Caller must hold l_TimerMutex.
+ */
+void Timer::WheelRebuild(int64_t currentTick)
+{
 	std::vector<Timer *> timers;
+	timers.reserve(l_WheelTimers);
+
+	for (auto& level : l_Wheel) {
+		for (Timer *& head : level) {
+			for (Timer *timer = head; timer; timer = timer->m_WheelNext)
+				timers.push_back(timer);
 
-	for (Timer *timer : idx) {
-		if (std::fabs(now - (timer->m_Next + adjustment)) <
-			std::fabs(now - timer->m_Next)) {
-			timer->m_Next += adjustment;
-			timers.push_back(timer);
+			head = nullptr;
 		}
 	}
 
-	for (Timer *timer : timers) {
-		l_Timers.erase(timer);
-		l_Timers.insert(timer);
-	}
+	for (Timer *timer : timers)
+		timer->m_WheelSlot = nullptr;
 
-	/* Notify the worker that we've rescheduled some timers. */
-	l_TimerCV.notify_all();
+	l_WheelTimers = 0;
+	l_CurrentTick = currentTick;
+
+	for (Timer *timer : timers)
+		WheelInsert(timer);
+}
+
+/**
+ * Processes the wheel up to and including the specified tick and collects
+ * all timers which are due.
+ *
+ * Note: Caller must hold l_TimerMutex.
+ */
+void Timer::WheelAdvance(int64_t tick, std::vector<Timer *>& expired)
+{
+	/* Catching up tick by tick isn't worth it after a long sleep. */
+	if (tick - l_CurrentTick > l_WheelSize * l_WheelSize)
+		WheelRebuild(tick);
+
+	for (; l_CurrentTick <= tick; l_CurrentTick++) {
+		/* Cascade timers from the higher levels whose slot has come up. */
+		for (int level = l_WheelLevels - 1; level > 0; level--) {
+			if ((l_CurrentTick & ((int64_t(1) << (l_WheelBits * level)) - 1)) != 0)
+				continue;
+
+			Timer *& head = l_Wheel[level][(l_CurrentTick >> (l_WheelBits * level)) & l_WheelMask];
+			Timer *timer = head;
+			head = nullptr;
+
+			while (timer) {
+				Timer *next = timer->m_WheelNext;
+
+				timer->m_WheelSlot = nullptr;
+				l_WheelTimers--;
+				WheelInsert(timer);
+
+				timer = next;
+			}
+		}
+
+		Timer *& head = l_Wheel[0][l_CurrentTick & l_WheelMask];
+
+		for (Timer *timer = head; timer; ) {
+			Timer *next = timer->m_WheelNext;
+
+			timer->m_WheelSlot = nullptr;
+			timer->m_WheelPrev = nullptr;
+			timer->m_WheelNext = nullptr;
+			l_WheelTimers--;
+
+			expired.push_back(timer);
+
+			timer = next;
+		}
+
+		head = nullptr;
+	}
 }
 
 /**
@@ -293,42 +459,72 @@ void Timer::TimerThreadProc()
 
 	Utility::SetThreadName("Timer Thread");
 
+	std::vector<Timer *> expired;
+	std::vector<std::pair<Timer::Ptr, double> > calls;
+
 	for (;;) {
 		boost::mutex::scoped_lock lock(l_TimerMutex);
 
-		typedef boost::multi_index::nth_index<TimerSet, 1>::type NextTimerView;
-		NextTimerView& idx = boost::get<1>(l_Timers);
-
 		/* Wait until there is at least one timer. */
-		while (idx.empty() && !l_StopTimerThread)
+		while (l_WheelTimers == 0 && !l_StopTimerThread) {
+			l_WakeTick = std::numeric_limits<int64_t>::max();
 			l_TimerCV.wait(lock);
+		}
 
 		if (l_StopTimerThread)
 			break;
 
-		auto it = idx.begin();
-		Timer *timer = *it;
+		double now = Utility::GetTime();
+
+		if (l_LagWindowStart < now - 60) {
+			l_LastAvgLag = l_LagCount > 0 ? l_LagSum / l_LagCount : 0;
+			l_LastMaxLag = l_LagMax;
+			l_LagSum = 0;
+			l_LagMax = 0;
+			l_LagCount = 0;
+			l_LagWindowStart = now;
+		}
+
+		/* Ticks which are <= now are due. */
+		WheelAdvance(static_cast<int64_t>(std::floor(now / l_TimerTick)), expired);
+
+		if (!expired.empty()) {
+			for (Timer *timer : expired) {
+				/* Prevent the timer from being rescheduled until the current call is completed. */
+				timer->m_Running = true;
+
+				calls.emplace_back(timer, timer->m_Next);
+			}
 
-		double wait = timer->m_Next - Utility::GetTime();
+			expired.clear();
 
-		if (wait > 0.01) {
-			/* Wait for the next timer. */
-			l_TimerCV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000)));
+			lock.unlock();
+
+			/* Asynchronously call the timers. */
+			for (auto& call : calls)
+				Utility::QueueAsyncCallback(std::bind(&Timer::Call, call.first, call.second));
+
+			calls.clear();
 
 			continue;
 		}
 
-		Timer::Ptr ptimer = timer;
+		/* Sleep until the next non-empty slot on level 0, or until the
+		 * next cascade if there is none in the current rotation. */
+		int64_t wakeTick = ((l_CurrentTick >> l_WheelBits) + 1) << l_WheelBits;
 
-		/* Remove the timer from the list so it doesn't get called again
-		 * until the current call is completed. */
-		l_Timers.erase(timer);
+		for (int64_t tick = l_CurrentTick; tick < wakeTick; tick++) {
+			if (l_Wheel[0][tick & l_WheelMask]) {
+				wakeTick = tick;
+				break;
+			}
+		}
 
-		timer->m_Running = true;
+		l_WakeTick = wakeTick;
 
-		lock.unlock();
+		double wait = wakeTick * l_TimerTick - now;
 
-		/* Asynchronously call the timer. */
-		Utility::QueueAsyncCallback(std::bind(&Timer::Call, ptimer));
+		if (wait > 0)
+			l_TimerCV.timed_wait(lock, boost::posix_time::microseconds(long(wait * 1000000)));
 	}
 }
@@ -23,10 +23,21 @@
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
 #include <boost/signals2.hpp>
+#include <vector>
 
 namespace icinga {
 
-class TimerHolder;
+/**
+ * Statistics for the timer subsystem.
+ *
+ * @ingroup base
+ */
+struct TimerStatistics
+{
+	size_t Timers{0};
+	double AvgLag{0}; /**< Average delay between a timer being due and its callback running. */
+	double MaxLag{0};
+};
 
 /**
  * A timer that periodically triggers an event.
@@ -50,6 +61,8 @@ public:
 
 	static void AdjustTimers(double adjustment);
 
+	static TimerStatistics GetStatistics();
+
 	void Start();
 	void Stop(bool wait = false);
 
@@ -64,12 +77,21 @@ private:
 	bool m_Started{false}; /**< Whether the timer is enabled. */
 	bool m_Running{false}; /**< Whether the timer proc is currently running. */
 
-	void Call();
-	void InternalReschedule(bool completed, double next = -1);
+	/* Position in the timer wheel, guarded by the timer mutex. */
+	Timer *m_WheelPrev{nullptr};
+	Timer *m_WheelNext{nullptr};
+	Timer **m_WheelSlot{nullptr};
+	int64_t m_WheelTick{0};
 
-	static void TimerThreadProc();
+	void Call(double due);
+	void InternalReschedule(bool completed, double next = -1, double lag = -1);
 
-	friend class TimerHolder;
+	static void WheelInsert(Timer *timer);
+	static void WheelRemove(Timer *timer);
+	static void WheelRebuild(int64_t currentTick);
+	static void WheelAdvance(int64_t tick, std::vector<Timer *>& expired);
+
+	static void TimerThreadProc();
 };
 
 }
@@ -23,6 +23,7 @@
 #include "base/logger.hpp"
 #include "base/configuration.hpp"
 #include "base/convert.hpp"
+#include <algorithm>
 #include <iostream>
 
 #ifndef _WIN32
@@ -31,6 +32,13 @@
 
 #define TLS_TIMEOUT_SECONDS 10
 
+/* Writes from Write() are appended to the last queued segment up to this size. */
+#define TLS_SEND_SEGMENT_SIZE (64 * 1024)
+
+/* Shared buffers smaller than this are copied, separate SSL_write() calls would
+ * result in more TLS records and syscalls than the copy costs. */
+#define TLS_SHARED_WRITE_MIN (4 * 1024)
+
 using namespace icinga;
 
 int TlsStream::m_SSLIndex;
@@ -44,7 +52,7 @@ bool TlsStream::m_SSLIndexInitialized = false;
  */
 TlsStream::TlsStream(const Socket::Ptr& socket, const String& hostname, ConnectionRole role, const std::shared_ptr<SSL_CTX>& sslContext)
 	: SocketEvents(socket), m_Eof(false), m_HandshakeOK(false), m_VerifyOK(true), m_ErrorCode(0),
-	m_ErrorOccurred(false),  m_Socket(socket), m_Role(role), m_SendQ(new FIFO()), m_RecvQ(new FIFO()),
+	m_ErrorOccurred(false),  m_Socket(socket), m_Hostname(hostname), m_Role(role), m_RecvQ(new FIFO()),
 	m_CurrentAction(TlsActionNone), m_Retry(false), m_Shutdown(false)
 {
 	std::ostringstream msgbuf;
@@ -70,6 +78,13 @@ TlsStream::TlsStream(const Socket::Ptr& socket, const String& hostname, Connecti
 
 	SSL_set_verify(m_SSL.get(), SSL_VERIFY_PEER | SSL_VERIFY_CLIENT_ONCE, &TlsStream::ValidateCertificate);
 
+#ifdef SSL_OP_ENABLE_KTLS
+	/* OpenSSL passes the session keys to the kernel after the handshake if both
+	 * support the negotiated cipher, otherwise records are encrypted as usual. */
+	if (Configuration::TlsKernelOffload)
+		SSL_set_options(m_SSL.get(), SSL_OP_ENABLE_KTLS);
+#endif /* SSL_OP_ENABLE_KTLS */
+
 	socket->MakeNonBlocking();
 
 	SSL_set_fd(m_SSL.get(), socket->GetFD());
@@ -155,7 +170,7 @@ void TlsStream::OnEvent(int revents)
 	if (m_CurrentAction == TlsActionNone) {
 		if (revents & (POLLIN | POLLERR | POLLHUP))
 			m_CurrentAction = TlsActionRead;
-		else if (m_SendQ->GetAvailableBytes() > 0 && (revents & POLLOUT))
+		else if (!m_SendQ.empty() && (revents & POLLOUT))
 			m_CurrentAction = TlsActionWrite;
 		else {
 			ChangeEvents(POLLIN);
@@ -172,6 +187,7 @@ void TlsStream::OnEvent(int revents)
 	ERR_clear_error();
 
 	size_t readTotal = 0;
+	size_t writeTotal = 0;
 
 	switch (m_CurrentAction) {
 		case TlsActionRead:
@@ -210,14 +226,30 @@ void TlsStream::OnEvent(int revents)
 
 			break;
 		case TlsActionWrite:
-			count = m_SendQ->Peek(buffer, sizeof(buffer), true);
+			/* Queued buffers are passed to SSL_write() directly. If it has to be
+			 * retried, the next attempt starts at the same position of the same
+			 * segment. */
+			do {
+				TlsSendSegment& segment = m_SendQ.front();
 
-			rc = SSL_write(m_SSL.get(), buffer, count);
+				count = std::min<size_t>(segment.GetRemaining(), TLS_SEND_SEGMENT_SIZE);
 
-			if (rc > 0) {
-				m_SendQ->Read(nullptr, rc, true);
-				success = true;
-			}
+				rc = SSL_write(m_SSL.get(), segment.GetData(), count);
+
+				if (rc > 0) {
+					segment.Offset += rc;
+					m_SendQSize -= rc;
+
+					if (segment.GetRemaining() == 0)
+						m_SendQ.pop_front();
+
+					success = true;
+					writeTotal += rc;
+				}
+			} while (rc > 0 && !m_SendQ.empty() && writeTotal < 4 * TLS_SEND_SEGMENT_SIZE);
+
+			if (writeTotal > 0)
+				m_CV.notify_all();
 
 			break;
 		case TlsActionHandshake:
@@ -227,6 +259,18 @@ void TlsStream::OnEvent(int revents)
 				success = true;
 				m_HandshakeOK = true;
 				m_CV.notify_all();
+
+#ifdef SSL_OP_ENABLE_KTLS
+				if (Configuration::TlsKernelOffload) {
+					/* Don't ask the socket for the peer's address here, getpeername()
+					 * fails if the peer has disconnected in the meantime. */
+					Log(LogDebug, "TlsStream")
+						<< "Kernel TLS offload for " << (m_Role == RoleClient ? "connection to '" + m_Hostname + "'" : String("incoming connection"))
+						<< ": send "
+						<< (BIO_get_ktls_send(SSL_get_wbio(m_SSL.get())) ? "enabled" : "disabled") << ", receive "
+						<< (BIO_get_ktls_recv(SSL_get_rbio(m_SSL.get())) ? "enabled" : "disabled");
+				}
+#endif /* SSL_OP_ENABLE_KTLS */
 			}
 
 			break;
@@ -239,6 +283,17 @@ void TlsStream::OnEvent(int revents)
 
 		switch (err) {
 			case SSL_ERROR_WANT_READ:
+				/* Unlike writes, reads don't have to be retried with the same
+				 * arguments. Don't let a read which only got a non-application
+				 * record (e.g. a TLS 1.3 session ticket) hold up queued writes
+				 * until the peer sends something. */
+				if (m_CurrentAction == TlsActionRead) {
+					m_CurrentAction = TlsActionNone;
+					ChangeEvents(m_SendQ.empty() ? POLLIN : POLLIN|POLLOUT);
+
+					break;
+				}
+
 				m_Retry = true;
 				ChangeEvents(POLLIN);
 
@@ -277,7 +332,7 @@ void TlsStream::OnEvent(int revents)
 		m_CurrentAction = TlsActionNone;
 
 		if (!m_Eof) {
-			if (m_SendQ->GetAvailableBytes() > 0)
+			if (!m_SendQ.empty())
 				ChangeEvents(POLLIN|POLLOUT);
 			else
 				ChangeEvents(POLLIN);
@@ -289,7 +344,7 @@ void TlsStream::OnEvent(int revents)
 			SignalDataAvailable();
 	}
 
-	if (m_Shutdown && !m_SendQ->IsDataAvailable()) {
+	if (m_Shutdown && m_SendQ.empty()) {
 		if (!success)
 			lock.unlock();
 
@@ -358,13 +413,67 @@ size_t TlsStream::Read(void *buffer, size_t count, bool allow_partial)
 
 void TlsStream::Write(const void *buffer, size_t count)
 {
+	if (count == 0)
+		return;
+
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	m_SendQ->Write(buffer, count);
+	if (m_SendQ.empty() || m_SendQ.back().Owner || m_SendQ.back().Copy.size() >= TLS_SEND_SEGMENT_SIZE)
+		m_SendQ.emplace_back();
+
+	/* SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER allows this even if a write of the segment has to be retried. */
+	m_SendQ.back().Copy.append(static_cast<const char *>(buffer), count);
+	m_SendQSize += count;
 
 	ChangeEvents(POLLIN|POLLOUT);
 }
 
+/**
+ * Queues the buffer without copying it, e.g. for a JSON-RPC message which is
+ * sent to several endpoints.
+ */
+void TlsStream::WriteShared(const Object::Ptr& owner, const void *buffer, size_t count)
+{
+	if (count < TLS_SHARED_WRITE_MIN) {
+		Write(buffer, count);
+		return;
+	}
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	m_SendQ.emplace_back();
+
+	TlsSendSegment& segment = m_SendQ.back();
+	segment.Owner = owner;
+	segment.Data = static_cast<const char *>(buffer);
+	segment.Size = count;
+	m_SendQSize += count;
+
+	ChangeEvents(POLLIN|POLLOUT);
+}
+
+bool TlsStream::WaitForSendQueue(size_t count, int timeout)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	/* The timeout starts over whenever the peer accepts some data, so slow
+	 * peers are fine as long as they keep reading. */
+	size_t queued = m_SendQSize;
+	boost::system_time point_of_timeout = boost::get_system_time() + boost::posix_time::seconds(timeout);
+
+	while (m_SendQSize > count && !m_Eof && !m_ErrorOccurred) {
+		if (m_SendQSize < queued) {
+			queued = m_SendQSize;
+			point_of_timeout = boost::get_system_time() + boost::posix_time::seconds(timeout);
+		}
+
+		if (!m_CV.timed_wait(lock, point_of_timeout) && m_SendQSize >= queued)
+			return false;
+	}
+
+	return !m_Eof && !m_ErrorOccurred;
+}
+
 void TlsStream::Shutdown()
 {
 	m_Shutdown = true;
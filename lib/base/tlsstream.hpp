@@ -26,6 +26,8 @@
 #include "base/stream.hpp"
 #include "base/tlsutility.hpp"
 #include "base/fifo.hpp"
+#include <deque>
+#include <string>
 
 namespace icinga
 {
@@ -38,6 +40,31 @@ enum TlsAction
 	TlsActionHandshake
 };
 
+/**
+ * Outgoing data for a TLS stream. Shared segments reference a buffer which
+ * is kept alive by Owner, data from Write() is copied into Copy.
+ *
+ * @ingroup base
+ */
+struct TlsSendSegment
+{
+	Object::Ptr Owner;
+	const char *Data{nullptr};
+	size_t Size{0};
+	std::string Copy;
+	size_t Offset{0};
+
+	const char *GetData() const
+	{
+		return (Owner ? Data : Copy.c_str()) + Offset;
+	}
+
+	size_t GetRemaining() const
+	{
+		return (Owner ? Size : Copy.size()) - Offset;
+	}
+};
+
 /**
  * A TLS stream.
  *
@@ -64,6 +91,8 @@ public:
 	size_t Peek(void *buffer, size_t count, bool allow_partial = false) override;
 	size_t Read(void *buffer, size_t count, bool allow_partial = false) override;
 	void Write(const void *buffer, size_t count) override;
+	void WriteShared(const Object::Ptr& owner, const void *buffer, size_t count) override;
+	bool WaitForSendQueue(size_t count, int timeout) override;
 
 	bool IsEof() const override;
 
@@ -85,9 +114,11 @@ private:
 	bool m_ErrorOccurred;
 
 	Socket::Ptr m_Socket;
+	String m_Hostname;
 	ConnectionRole m_Role;
 
-	FIFO::Ptr m_SendQ;
+	std::deque<TlsSendSegment> m_SendQ;
+	size_t m_SendQSize{0};
 	FIFO::Ptr m_RecvQ;
 
 	TlsAction m_CurrentAction;
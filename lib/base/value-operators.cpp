@@ -30,26 +30,23 @@ using namespace icinga;
 
 Value::operator double() const
 {
-	const double *value = boost::get<double>(&m_Value);
+	if (m_Type == ValueNumber)
+		return m_Number;
 
-	if (value)
-		return *value;
-
-	const bool *fvalue = boost::get<bool>(&m_Value);
-
-	if (fvalue)
-		return *fvalue;
+	if (m_Type == ValueBoolean)
+		return m_Boolean;
 
 	if (IsEmpty())
 		return 0;
 
 	try {
-		return boost::lexical_cast<double>(m_Value);
-	} catch (const std::exception&) {
-		std::ostringstream msgbuf;
-		msgbuf << "Can't convert '" << *this << "' to a floating point number.";
-		BOOST_THROW_EXCEPTION(std::invalid_argument(msgbuf.str()));
-	}
+		if (m_Type == ValueString)
+			return boost::lexical_cast<double>(GetString());
+	} catch (const std::exception&) { /* fall through */ }
+
+	std::ostringstream msgbuf;
+	msgbuf << "Can't convert '" << *this << "' to a floating point number.";
+	BOOST_THROW_EXCEPTION(std::invalid_argument(msgbuf.str()));
 }
 
 Value::operator String() const
@@ -60,16 +57,16 @@ Value::operator String() const
 		case ValueEmpty:
 			return String();
 		case ValueNumber:
-			return Convert::ToString(boost::get<double>(m_Value));
+			return Convert::ToString(m_Number);
 		case ValueBoolean:
-			if (boost::get<bool>(m_Value))
+			if (m_Boolean)
 				return "true";
 			else
 				return "false";
 		case ValueString:
-			return boost::get<String>(m_Value);
+			return GetString();
 		case ValueObject:
-			object = boost::get<Object::Ptr>(m_Value).get();
+			object = m_Object.get();
 			return object->ToString();
 		default:
 			BOOST_THROW_EXCEPTION(std::runtime_error("Unknown value type."));
@@ -152,7 +149,7 @@ bool Value::operator==(const Value& rhs) const
 		return static_cast<double>(*this) == static_cast<double>(rhs);
 
 	if (IsString() && rhs.IsString())
-		return Get<String>() == rhs.Get<String>();
+		return StringEquals(rhs);
 	else if ((IsString() || IsEmpty()) && (rhs.IsString() || rhs.IsEmpty()) && !(IsEmpty() && rhs.IsEmpty()))
 		return static_cast<String>(*this) == static_cast<String>(rhs);
 
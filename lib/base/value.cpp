@@ -24,72 +24,72 @@
 
 using namespace icinga;
 
-template class boost::variant<boost::blank, double, bool, String, Object::Ptr>;
-template const double& Value::Get<double>() const;
-template const bool& Value::Get<bool>() const;
-template const String& Value::Get<String>() const;
-template const Object::Ptr& Value::Get<Object::Ptr>() const;
-
 Value icinga::Empty;
 
 Value::Value(std::nullptr_t)
+	: Value()
 { }
 
 Value::Value(int value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(unsigned int value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(long value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(unsigned long value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(long long value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(unsigned long long value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(double value)
-	: m_Value(value)
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(bool value)
-	: m_Value(value)
+	: m_Boolean(value), m_Type(ValueBoolean)
 { }
 
 Value::Value(const String& value)
-	: m_Value(value)
-{ }
+	: m_Type(ValueEmpty)
+{
+	SetString(value.CStr(), value.GetLength());
+}
 
 Value::Value(String&& value)
-	: m_Value(value)
-{ }
+	: m_Type(ValueEmpty)
+{
+	SetString(std::move(value));
+}
 
 Value::Value(const char *value)
-	: m_Value(String(value))
-{ }
+	: m_Type(ValueEmpty)
+{
+	SetString(value, strlen(value));
+}
 
 Value::Value(const Value& other)
-	: m_Value(other.m_Value)
-{ }
+	: m_Type(ValueEmpty)
+{
+	CopyFrom(other);
+}
 
 Value::Value(Value&& other)
+	: m_Type(ValueEmpty)
 {
-#if BOOST_VERSION >= 105400
-	m_Value = std::move(other.m_Value);
-#else /* BOOST_VERSION */
-	m_Value.swap(other.m_Value);
-#endif /* BOOST_VERSION */
+	MoveFrom(other);
 }
 
 Value::Value(Object *value)
@@ -97,28 +97,190 @@ Value::Value(Object *value)
 { }
 
 Value::Value(const intrusive_ptr<Object>& value)
+	: m_Type(ValueEmpty)
+{
+	if (value) {
+		new (&m_Object) Object::Ptr(value);
+		m_Type = ValueObject;
+	}
+}
+
+Value::~Value()
 {
-	if (value)
-		m_Value = value;
+	Reset();
 }
 
 Value& Value::operator=(const Value& other)
 {
-	m_Value = other.m_Value;
+	if (this != &other) {
+		/* other might be owned by what we're currently holding (e.g. an item of our own dictionary). */
+		Value tmp(other);
+		Reset();
+		MoveFrom(tmp);
+	}
+
 	return *this;
 }
 
 Value& Value::operator=(Value&& other)
 {
-#if BOOST_VERSION >= 105400
-	m_Value = std::move(other.m_Value);
-#else /* BOOST_VERSION */
-	m_Value.swap(other.m_Value);
-#endif /* BOOST_VERSION */
+	if (this != &other) {
+		Value tmp(std::move(other));
+		Reset();
+		MoveFrom(tmp);
+	}
 
 	return *this;
 }
 
+/**
+ * Releases whatever the value is holding and makes it empty.
+ */
+void Value::Reset()
+{
+	switch (m_Type) {
+		case ValueString:
+			if (m_ShortStringLength == SharedStringLength && m_String->RefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				delete m_String;
+			break;
+		case ValueObject:
+			m_Object.~intrusive_ptr();
+			break;
+		default:
+			break;
+	}
+
+	m_Type = ValueEmpty;
+}
+
+/**
+ * Copies another value. This value must be empty.
+ */
+void Value::CopyFrom(const Value& other)
+{
+	switch (other.m_Type) {
+		case ValueNumber:
+			m_Number = other.m_Number;
+			break;
+		case ValueBoolean:
+			m_Boolean = other.m_Boolean;
+			break;
+		case ValueString:
+			if (other.m_ShortStringLength == SharedStringLength) {
+				other.m_String->RefCount.fetch_add(1, std::memory_order_relaxed);
+				m_String = other.m_String;
+			} else {
+				memcpy(m_ShortString, other.m_ShortString, sizeof(m_ShortString));
+				memcpy(m_ShortStringTail, other.m_ShortStringTail, sizeof(m_ShortStringTail));
+			}
+
+			m_ShortStringLength = other.m_ShortStringLength;
+			break;
+		case ValueObject:
+			new (&m_Object) Object::Ptr(other.m_Object);
+			break;
+		default:
+			break;
+	}
+
+	m_Type = other.m_Type;
+}
+
+/**
+ * Takes over another value's contents and leaves it empty. This value must be empty.
+ */
+void Value::MoveFrom(Value& other)
+{
+	switch (other.m_Type) {
+		case ValueNumber:
+			m_Number = other.m_Number;
+			break;
+		case ValueBoolean:
+			m_Boolean = other.m_Boolean;
+			break;
+		case ValueString:
+			memcpy(m_ShortString, other.m_ShortString, sizeof(m_ShortString));
+			memcpy(m_ShortStringTail, other.m_ShortStringTail, sizeof(m_ShortStringTail));
+			m_ShortStringLength = other.m_ShortStringLength;
+			break;
+		case ValueObject:
+			new (&m_Object) Object::Ptr(std::move(other.m_Object));
+			other.m_Object.~intrusive_ptr();
+			break;
+		default:
+			break;
+	}
+
+	m_Type = other.m_Type;
+	other.m_Type = ValueEmpty;
+}
+
+/**
+ * Stores a string. Strings which fit into ShortStringCapacity are stored
+ * inline, all others are shared. This value must be empty.
+ */
+void Value::SetString(const char *data, size_t length)
+{
+	if (length > ShortStringCapacity) {
+		SetString(String(data, data + length));
+		return;
+	}
+
+	size_t head = std::min(length, sizeof(m_ShortString));
+
+	memcpy(m_ShortString, data, head);
+	memcpy(m_ShortStringTail, data + head, length - head);
+	m_ShortStringLength = length;
+	m_Type = ValueString;
+}
+
+void Value::SetString(String&& value)
+{
+	if (value.GetLength() <= ShortStringCapacity) {
+		SetString(value.CStr(), value.GetLength());
+		return;
+	}
+
+	m_String = new SharedString{ { 1 }, std::move(value) };
+	m_ShortStringLength = SharedStringLength;
+	m_Type = ValueString;
+}
+
+/**
+ * Returns a copy of the string. The value must hold a string.
+ */
+String Value::GetString() const
+{
+	if (m_ShortStringLength == SharedStringLength)
+		return m_String->Data;
+
+	size_t head = std::min<size_t>(m_ShortStringLength, sizeof(m_ShortString));
+
+	String result(m_ShortString, m_ShortString + head);
+	result.GetData().append(m_ShortStringTail, m_ShortStringLength - head);
+	return result;
+}
+
+/**
+ * Compares the strings of two values without copying them. Both values
+ * must hold a string.
+ */
+bool Value::StringEquals(const Value& other) const
+{
+	/* Inline strings are never longer than ShortStringCapacity and shared strings
+	 * are never shorter, so a short string can't be equal to a shared one. */
+	if (m_ShortStringLength != other.m_ShortStringLength)
+		return false;
+
+	if (m_ShortStringLength == SharedStringLength)
+		return m_String == other.m_String || m_String->Data == other.m_String->Data;
+
+	size_t head = std::min<size_t>(m_ShortStringLength, sizeof(m_ShortString));
+
+	return memcmp(m_ShortString, other.m_ShortString, head) == 0 &&
+		memcmp(m_ShortStringTail, other.m_ShortStringTail, m_ShortStringLength - head) == 0;
+}
+
 /**
  * Checks whether the variant is empty.
  *
@@ -126,7 +288,7 @@ Value& Value::operator=(Value&& other)
  */
 bool Value::IsEmpty() const
 {
-	return (GetType() == ValueEmpty || (IsString() && boost::get<String>(m_Value).IsEmpty()));
+	return (m_Type == ValueEmpty || (m_Type == ValueString && m_ShortStringLength == 0));
 }
 
 /**
@@ -186,25 +348,27 @@ bool Value::IsObject() const
  */
 ValueType Value::GetType() const
 {
-	return static_cast<ValueType>(m_Value.which());
+	return static_cast<ValueType>(m_Type);
 }
 
 void Value::Swap(Value& other)
 {
-	m_Value.swap(other.m_Value);
+	Value tmp(std::move(other));
+	other.MoveFrom(*this);
+	MoveFrom(tmp);
 }
 
 bool Value::ToBool() const
 {
 	switch (GetType()) {
 		case ValueNumber:
-			return static_cast<bool>(boost::get<double>(m_Value));
+			return static_cast<bool>(m_Number);
 
 		case ValueBoolean:
-			return boost::get<bool>(m_Value);
+			return m_Boolean;
 
 		case ValueString:
-			return !boost::get<String>(m_Value).IsEmpty();
+			return m_ShortStringLength != 0;
 
 		case ValueObject:
 			if (IsObjectType<Dictionary>()) {
@@ -239,7 +403,7 @@ String Value::GetTypeName() const
 		case ValueString:
 			return "String";
 		case ValueObject:
-			t = boost::get<Object::Ptr>(m_Value)->GetReflectionType();
+			t = m_Object->GetReflectionType();
 			if (!t) {
 				if (IsObjectType<Array>())
 					return "Array";
@@ -266,7 +430,7 @@ Type::Ptr Value::GetReflectionType() const
 		case ValueString:
 			return Type::GetByName("String");
 		case ValueObject:
-			return boost::get<Object::Ptr>(m_Value)->GetReflectionType();
+			return m_Object->GetReflectionType();
 		default:
 			return nullptr;
 	}
@@ -22,9 +22,9 @@
 
 #include "base/object.hpp"
 #include "base/string.hpp"
-#include <boost/variant/variant.hpp>
 #include <boost/variant/get.hpp>
 #include <boost/throw_exception.hpp>
+#include <atomic>
 
 namespace icinga
 {
@@ -48,12 +48,19 @@ enum ValueType
 /**
  * A type that can hold an arbitrary value.
  *
+ * Values are stored in a 16 byte tagged union. Short strings are stored
+ * inline, longer ones live in a separate reference-counted buffer which is
+ * shared by all copies of a Value.
+ *
  * @ingroup base
  */
 class Value
 {
 public:
-	Value() = default;
+	Value()
+		: m_Number(0), m_Type(ValueEmpty)
+	{ }
+
 	Value(std::nullptr_t);
 	Value(int value);
 	Value(unsigned int value);
@@ -70,6 +77,7 @@ public:
 	Value(Value&& other);
 	Value(Object *value);
 	Value(const intrusive_ptr<Object>& value);
+	~Value();
 
 	template<typename T>
 	Value(const intrusive_ptr<T>& value)
@@ -113,7 +121,7 @@ public:
 		if (!IsObject())
 			BOOST_THROW_EXCEPTION(std::runtime_error("Cannot convert value of type '" + GetTypeName() + "' to an object."));
 
-		const auto& object = Get<Object::Ptr>();
+		const auto& object = m_Object;
 
 		ASSERT(object);
 
@@ -138,7 +146,7 @@ public:
 		if (!IsObject())
 			return false;
 
-		return dynamic_cast<T *>(Get<Object::Ptr>().get());
+		return dynamic_cast<T *>(m_Object.get());
 	}
 
 	ValueType GetType() const;
@@ -152,19 +160,82 @@ public:
 	Value Clone() const;
 
 	template<typename T>
-	const T& Get() const
-	{
-		return boost::get<T>(m_Value);
-	}
+	const T& Get() const;
 
 private:
-	boost::variant<boost::blank, double, bool, String, Object::Ptr> m_Value;
+	/**
+	 * Strings up to this length are stored inline: the first part in
+	 * m_ShortString and the rest in m_ShortStringTail.
+	 */
+	static const size_t ShortStringCapacity = sizeof(double) + 6;
+
+	/**
+	 * Marks a string which is stored in m_String.
+	 */
+	static const unsigned char SharedStringLength = 0xff;
+
+	/**
+	 * A string which is shared by several Values. It's never modified
+	 * after it has been created.
+	 */
+	struct SharedString
+	{
+		std::atomic<int> RefCount;
+		String Data;
+	};
+
+	union {
+		double m_Number;
+		bool m_Boolean;
+		SharedString *m_String;
+		Object::Ptr m_Object;
+		char m_ShortString[sizeof(double)];
+	};
+
+	char m_ShortStringTail[ShortStringCapacity - sizeof(double)];
+	unsigned char m_ShortStringLength;
+	unsigned char m_Type;
+
+	void SetString(const char *data, size_t length);
+	void SetString(String&& value);
+	String GetString() const;
+	bool StringEquals(const Value& other) const;
+
+	void Reset();
+	void CopyFrom(const Value& other);
+	void MoveFrom(Value& other);
 };
 
-extern template const double& Value::Get<double>() const;
-extern template const bool& Value::Get<bool>() const;
-extern template const String& Value::Get<String>() const;
-extern template const Object::Ptr& Value::Get<Object::Ptr>() const;
+template<>
+inline const double& Value::Get<double>() const
+{
+	if (m_Type != ValueNumber)
+		BOOST_THROW_EXCEPTION(boost::bad_get());
+
+	return m_Number;
+}
+
+template<>
+inline const bool& Value::Get<bool>() const
+{
+	if (m_Type != ValueBoolean)
+		BOOST_THROW_EXCEPTION(boost::bad_get());
+
+	return m_Boolean;
+}
+
+/* Short strings aren't backed by a String object. Use operator String() instead. */
+template<>
+const String& Value::Get<String>() const = delete;
+
+template<>
+inline const Object::Ptr& Value::Get<Object::Ptr>() const
+{
+	if (m_Type != ValueObject)
+		BOOST_THROW_EXCEPTION(boost::bad_get());
+
+	return m_Object;
+}
 
 extern Value Empty;
 
@@ -263,6 +334,4 @@ std::istream& operator>>(std::istream& stream, Value& value);
 
 }
 
-extern template class boost::variant<boost::blank, double, bool, icinga::String, icinga::Object::Ptr>;
-
 #endif /* VALUE_H */
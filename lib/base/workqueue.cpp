@@ -25,6 +25,7 @@
 #include "base/exception.hpp"
 #include <boost/thread/tss.hpp>
 #include <math.h>
+#include <thread>
 
 using namespace icinga;
 
@@ -33,7 +34,7 @@ boost::thread_specific_ptr<WorkQueue *> l_ThreadWorkQueue;
 
 WorkQueue::WorkQueue(size_t maxItems, int threadCount)
 	: m_ID(m_NextID++), m_ThreadCount(threadCount), m_MaxItems(maxItems),
-	m_TaskStats(15 * 60)
+	m_Tasks{ { 32 }, { 512 }, { 32 } }, m_TaskStats(15 * 60)
 {
 	/* Initialize logger. */
 	m_StatusTimerTimeout = Utility::GetTime();
@@ -61,38 +62,21 @@ String WorkQueue::GetName() const
 	return m_Name;
 }
 
-boost::mutex::scoped_lock WorkQueue::AcquireLock()
+void WorkQueue::SpawnThreads()
 {
-	return boost::mutex::scoped_lock(m_Mutex);
-}
-
-/**
- * Enqueues a task. Tasks are guaranteed to be executed in the order
- * they were enqueued in except if there is more than one worker thread.
- */
-void WorkQueue::EnqueueUnlocked(boost::mutex::scoped_lock& lock, std::function<void ()>&& function, WorkQueuePriority priority)
-{
-	if (!m_Spawned) {
-		Log(LogNotice, "WorkQueue")
-			<< "Spawning WorkQueue threads for '" << m_Name << "'";
-
-		for (int i = 0; i < m_ThreadCount; i++) {
-			m_Threads.create_thread(std::bind(&WorkQueue::WorkerThreadProc, this));
-		}
+	boost::mutex::scoped_lock lock(m_Mutex);
 
-		m_Spawned = true;
-	}
+	if (m_Spawned.load())
+		return;
 
-	bool wq_thread = IsWorkerThread();
+	Log(LogNotice, "WorkQueue")
+		<< "Spawning WorkQueue threads for '" << m_Name << "'";
 
-	if (!wq_thread) {
-		while (m_Tasks.size() >= m_MaxItems && m_MaxItems != 0)
-			m_CVFull.wait(lock);
+	for (int i = 0; i < m_ThreadCount; i++) {
+		m_Threads.create_thread(std::bind(&WorkQueue::WorkerThreadProc, this));
 	}
 
-	m_Tasks.emplace(std::move(function), priority, ++m_NextTaskID);
-
-	m_CVEmpty.notify_one();
+	m_Spawned.store(true);
 }
 
 /**
@@ -100,6 +84,9 @@ void WorkQueue::EnqueueUnlocked(boost::mutex::scoped_lock& lock, std::function<v
  * they were enqueued in except if there is more than one worker thread or when
  * allowInterleaved is true in which case the new task might be run
  * immediately if it's being enqueued from within the WorkQueue thread.
+ *
+ * Unless called from one of the worker threads this blocks while the queue
+ * holds the maximum number of items.
  */
 void WorkQueue::Enqueue(std::function<void ()>&& function, WorkQueuePriority priority,
 	bool allowInterleaved)
@@ -112,8 +99,31 @@ void WorkQueue::Enqueue(std::function<void ()>&& function, WorkQueuePriority pri
 		return;
 	}
 
-	auto lock = AcquireLock();
-	EnqueueUnlocked(lock, std::move(function), priority);
+	if (!m_Spawned.load())
+		SpawnThreads();
+
+	if (!wq_thread && m_MaxItems != 0 && m_Pending.load() >= m_MaxItems) {
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		m_FullWaiters.fetch_add(1);
+
+		while (m_Pending.load() >= m_MaxItems)
+			m_CVFull.wait(lock);
+
+		m_FullWaiters.fetch_sub(1);
+	}
+
+	/* Count the task before it becomes visible so that workers never see
+	 * the counter drop below the number of queued tasks.
+	 */
+	m_Pending.fetch_add(1);
+
+	m_Tasks[priority].Push(std::move(function));
+
+	if (m_IdleThreads.load() > 0) {
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_CVEmpty.notify_one();
+	}
 }
 
 /**
@@ -126,16 +136,16 @@ void WorkQueue::Join(bool stop)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	while (m_Processing || !m_Tasks.empty())
+	while (m_Processing.load() || m_Pending.load())
 		m_CVStarved.wait(lock);
 
 	if (stop) {
-		m_Stopped = true;
+		m_Stopped.store(true);
 		m_CVEmpty.notify_all();
 		lock.unlock();
 
 		m_Threads.join_all();
-		m_Spawned = false;
+		m_Spawned.store(false);
 
 		Log(LogNotice, "WorkQueue")
 			<< "Stopped WorkQueue threads for '" << m_Name << "'";
@@ -201,9 +211,7 @@ void WorkQueue::ReportExceptions(const String& facility) const
 
 size_t WorkQueue::GetLength() const
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
-
-	return m_Tasks.size();
+	return m_Pending.load();
 }
 
 void WorkQueue::StatusTimerHandler()
@@ -212,7 +220,7 @@ void WorkQueue::StatusTimerHandler()
 
 	ASSERT(!m_Name.IsEmpty());
 
-	size_t pending = m_Tasks.size();
+	size_t pending = m_Pending.load();
 
 	double now = Utility::GetTime();
 	double gradient = (pending - m_PendingTasks) / (now - m_PendingTasksTimestamp);
@@ -266,6 +274,14 @@ void WorkQueue::RunTaskFunction(const TaskFunction& func)
 	}
 }
 
+/**
+ * Takes the next task from the highest-priority queue which has one.
+ */
+bool WorkQueue::DequeueTask(TaskFunction& task)
+{
+	return m_Tasks[PriorityHigh].Pop(task) || m_Tasks[PriorityNormal].Pop(task) || m_Tasks[PriorityLow].Pop(task);
+}
+
 void WorkQueue::WorkerThreadProc()
 {
 	std::ostringstream idbuf;
@@ -274,38 +290,58 @@ void WorkQueue::WorkerThreadProc()
 
 	l_ThreadWorkQueue.reset(new WorkQueue *(this));
 
-	boost::mutex::scoped_lock lock(m_Mutex);
-
 	for (;;) {
-		while (m_Tasks.empty() && !m_Stopped)
-			m_CVEmpty.wait(lock);
-
-		if (m_Stopped)
+		if (m_Stopped.load())
 			break;
 
-		if (m_Tasks.size() >= m_MaxItems && m_MaxItems != 0)
-			m_CVFull.notify_all();
+		TaskFunction task;
 
-		Task task = m_Tasks.top();
-		m_Tasks.pop();
+		if (!DequeueTask(task)) {
+			boost::mutex::scoped_lock lock(m_Mutex);
 
-		m_Processing++;
+			m_IdleThreads.fetch_add(1);
 
-		lock.unlock();
+			/* Pairs with the increment of m_Pending in Enqueue(): either we
+			 * see the new task here or the producer sees us as idle.
+			 */
+			bool waited = false;
 
-		RunTaskFunction(task.Function);
+			while (m_Pending.load() == 0 && !m_Stopped.load()) {
+				m_CVEmpty.wait(lock);
+				waited = true;
+			}
 
-		/* clear the task so whatever other resources it holds are released _before_ we re-acquire the mutex */
-		task = Task();
+			m_IdleThreads.fetch_sub(1);
 
-		IncreaseTaskCount();
+			lock.unlock();
+
+			/* The task has been counted but hasn't been pushed yet. */
+			if (!waited)
+				std::this_thread::yield();
+
+			continue;
+		}
+
+		m_Processing.fetch_add(1);
 
-		lock.lock();
+		size_t pending = m_Pending.fetch_sub(1) - 1;
 
-		m_Processing--;
+		if (m_MaxItems != 0 && pending < m_MaxItems && m_FullWaiters.load() > 0) {
+			boost::mutex::scoped_lock lock(m_Mutex);
+			m_CVFull.notify_all();
+		}
+
+		RunTaskFunction(task);
+
+		/* clear the task so whatever other resources it holds are released _before_ we signal Join() */
+		task = TaskFunction();
 
-		if (m_Tasks.empty())
+		IncreaseTaskCount();
+
+		if (m_Processing.fetch_sub(1) == 1 && m_Pending.load() == 0) {
+			boost::mutex::scoped_lock lock(m_Mutex);
 			m_CVStarved.notify_all();
+		}
 	}
 }
 
@@ -318,18 +354,3 @@ size_t WorkQueue::GetTaskCount(RingBuffer::SizeType span)
 {
 	return m_TaskStats.UpdateAndGetValues(Utility::GetTime(), span);
 }
-
-bool icinga::operator<(const Task& a, const Task& b)
-{
-	if (a.Priority < b.Priority)
-		return true;
-
-	if (a.Priority == b.Priority) {
-		if (a.ID > b.ID)
-			return true;
-		else
-			return false;
-	}
-
-	return false;
-}
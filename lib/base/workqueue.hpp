@@ -23,12 +23,11 @@
 #include "base/i2-base.hpp"
 #include "base/timer.hpp"
 #include "base/ringbuffer.hpp"
+#include "base/concurrentqueue.hpp"
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/exception_ptr.hpp>
-#include <queue>
-#include <deque>
 #include <atomic>
 
 namespace icinga
@@ -43,24 +42,14 @@ enum WorkQueuePriority
 
 using TaskFunction = std::function<void ()>;
 
-struct Task
-{
-	Task() = default;
-
-	Task(TaskFunction function, WorkQueuePriority priority, int id)
-		: Function(std::move(function)), Priority(priority), ID(id)
-	{ }
-
-	TaskFunction Function;
-	WorkQueuePriority Priority{PriorityNormal};
-	int ID{-1};
-};
-
-bool operator<(const Task& a, const Task& b);
-
 /**
  * A workqueue.
  *
+ * Tasks are kept in one lock-free queue per priority, so enqueuing a task
+ * doesn't contend with the worker threads. Only producers which have to
+ * wait because the queue is full and worker threads which have run out
+ * of tasks use the mutex.
+ *
  * @ingroup base
  */
 class WorkQueue
@@ -74,8 +63,6 @@ public:
 	void SetName(const String& name);
 	String GetName() const;
 
-	boost::mutex::scoped_lock AcquireLock();
-	void EnqueueUnlocked(boost::mutex::scoped_lock& lock, TaskFunction&& function, WorkQueuePriority priority = PriorityNormal);
 	void Enqueue(TaskFunction&& function, WorkQueuePriority priority = PriorityNormal,
 		bool allowInterleaved = false);
 	void Join(bool stop = false);
@@ -87,8 +74,6 @@ public:
 
 		SizeType totalCount = items.size();
 
-		auto lock = AcquireLock();
-
 		SizeType offset = 0;
 
 		for (int i = 0; i < m_ThreadCount; i++) {
@@ -96,7 +81,7 @@ public:
 			if (static_cast<SizeType>(i) < totalCount % static_cast<SizeType>(m_ThreadCount))
 				count++;
 
-			EnqueueUnlocked(lock, [&items, func, offset, count, this]() {
+			Enqueue([&items, func, offset, count, this]() {
 				for (SizeType j = offset; j < offset + count; j++) {
 					RunTaskFunction([&func, &items, j]() {
 						func(items[j]);
@@ -129,7 +114,7 @@ private:
 	String m_Name;
 	static std::atomic<int> m_NextID;
 	int m_ThreadCount;
-	bool m_Spawned{false};
+	std::atomic<bool> m_Spawned{false};
 
 	mutable boost::mutex m_Mutex;
 	boost::condition_variable m_CVEmpty;
@@ -137,10 +122,12 @@ private:
 	boost::condition_variable m_CVStarved;
 	boost::thread_group m_Threads;
 	size_t m_MaxItems;
-	bool m_Stopped{false};
-	int m_Processing{0};
-	std::priority_queue<Task, std::deque<Task> > m_Tasks;
-	int m_NextTaskID{0};
+	std::atomic<bool> m_Stopped{false};
+	std::atomic<int> m_Processing{0};
+	ConcurrentQueue<TaskFunction> m_Tasks[3];
+	std::atomic<size_t> m_Pending{0};
+	std::atomic<int> m_IdleThreads{0};
+	std::atomic<int> m_FullWaiters{0};
 	ExceptionCallback m_ExceptionCallback;
 	std::vector<boost::exception_ptr> m_Exceptions;
 	Timer::Ptr m_StatusTimer;
@@ -150,6 +137,8 @@ private:
 	size_t m_PendingTasks{0};
 	double m_PendingTasksTimestamp{0};
 
+	void SpawnThreads();
+	bool DequeueTask(TaskFunction& task);
 	void WorkerThreadProc();
 	void StatusTimerHandler();
 
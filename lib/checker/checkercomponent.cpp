@@ -60,6 +60,11 @@ void CheckerComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr
 
 void CheckerComponent::OnConfigLoaded()
 {
+	int shards = GetSchedulerThreads();
+
+	for (int i = 0; i < shards; i++)
+		m_Shards.emplace_back(new SchedulerShard());
+
 	ConfigObject::OnActiveChanged.connect(std::bind(&CheckerComponent::ObjectHandler, this, _1));
 	ConfigObject::OnPausedChanged.connect(std::bind(&CheckerComponent::ObjectHandler, this, _1));
 
@@ -71,10 +76,10 @@ void CheckerComponent::Start(bool runtimeCreated)
 	ObjectImpl<CheckerComponent>::Start(runtimeCreated);
 
 	Log(LogInformation, "CheckerComponent")
-		<< "'" << GetName() << "' started.";
-
+		<< "'" << GetName() << "' started with " << m_Shards.size() << " scheduler thread(s).";
 
-	m_Thread = std::thread(std::bind(&CheckerComponent::CheckThreadProc, this));
+	for (const std::unique_ptr<SchedulerShard>& shard : m_Shards)
+		shard->Thread = std::thread(std::bind(&CheckerComponent::CheckThreadProc, this, shard.get()));
 
 	m_ResultTimer = new Timer();
 	m_ResultTimer->SetInterval(5);
@@ -87,134 +92,227 @@ void CheckerComponent::Stop(bool runtimeRemoved)
 	Log(LogInformation, "CheckerComponent")
 		<< "'" << GetName() << "' stopped.";
 
-	{
-		boost::mutex::scoped_lock lock(m_Mutex);
-		m_Stopped = true;
-		m_CV.notify_all();
+	m_Stopped = true;
+
+	for (const std::unique_ptr<SchedulerShard>& shard : m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		shard->CV.notify_all();
 	}
 
 	m_ResultTimer->Stop();
-	m_Thread.join();
+
+	for (const std::unique_ptr<SchedulerShard>& shard : m_Shards)
+		shard->Thread.join();
 
 	ObjectImpl<CheckerComponent>::Stop(runtimeRemoved);
 }
 
-void CheckerComponent::CheckThreadProc()
+void CheckerComponent::ValidateSchedulerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<CheckerComponent>::ValidateSchedulerThreads(lvalue, utils);
+
+	if (lvalue() <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "scheduler_threads" }, "Value must be greater than 0."));
+}
+
+void CheckerComponent::CheckThreadProc(SchedulerShard *shard)
 {
 	Utility::SetThreadName("Check Scheduler");
 
-	boost::mutex::scoped_lock lock(m_Mutex);
+	boost::mutex::scoped_lock lock(shard->Mutex);
 
 	for (;;) {
 		typedef boost::multi_index::nth_index<CheckableSet, 1>::type CheckTimeView;
-		CheckTimeView& idx = boost::get<1>(m_IdleCheckables);
-
-		while (idx.begin() == idx.end() && !m_Stopped)
-			m_CV.wait(lock);
+		CheckTimeView& idx = boost::get<1>(shard->IdleCheckables);
 
 		if (m_Stopped)
 			break;
 
-		auto it = idx.begin();
-		CheckableScheduleInfo csi = *it;
+		ApplyRescheduled(shard);
 
-		double wait = csi.NextCheck - Utility::GetTime();
+		if (idx.begin() == idx.end()) {
+			shard->CV.wait(lock);
+			continue;
+		}
 
-		if (Checkable::GetPendingChecks() >= GetConcurrentChecks())
-			wait = 0.5;
+		double now = Utility::GetTime();
+		double wait = idx.begin()->NextCheck - now;
 
 		if (wait > 0) {
 			/* Wait for the next check. */
-			m_CV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000)));
+			shard->CV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000)));
 
 			continue;
 		}
 
-		Checkable::Ptr checkable = csi.Object;
+		/* Take all checkables which are due right now in one go. They're neither
+		 * idle nor pending now; ObjectHandler() removes them from the in-flight
+		 * set if they're deactivated or paused while we're evaluating them unlocked.
+		 *
+		 * The check slots are reserved right away so that the shards don't
+		 * exceed the concurrent checks limit together. */
+		std::vector<Checkable::Ptr> due;
 
-		m_IdleCheckables.erase(checkable);
+		{
+			boost::mutex::scoped_lock slotLock(m_SlotMutex);
 
-		bool forced = checkable->GetForceNextCheck();
-		bool check = true;
+			int slots = GetConcurrentChecks() - Checkable::GetPendingChecks();
 
-		if (!forced) {
-			if (!checkable->IsReachable(DependencyCheckExecution)) {
-				Log(LogNotice, "CheckerComponent")
-					<< "Skipping check for object '" << checkable->GetName() << "': Dependency failed.";
-				check = false;
+			for (auto it = idx.begin(); it != idx.end() && it->NextCheck <= now && due.size() < static_cast<size_t>(std::max(slots, 0));) {
+				due.push_back(it->Object);
+				shard->InFlightCheckables.insert(it->Object);
+				it = idx.erase(it);
+
+				Checkable::IncreasePendingChecks();
 			}
+		}
+
+		if (due.empty()) {
+			/* All check slots are in use. */
+			shard->CV.timed_wait(lock, boost::posix_time::milliseconds(500));
+
+			continue;
+		}
+
+		lock.unlock();
 
-			Host::Ptr host;
-			Service::Ptr service;
-			tie(host, service) = GetHostService(checkable);
+		std::vector<Checkable::Ptr> checks, skipped;
 
-			if (host && !service && (!checkable->GetEnableActiveChecks() || !IcingaApplication::GetInstance()->GetEnableHostChecks())) {
-				Log(LogNotice, "CheckerComponent")
-					<< "Skipping check for host '" << host->GetName() << "': active host checks are disabled";
-				check = false;
+		for (const Checkable::Ptr& checkable : due) {
+			if (!IsCheckEnabled(checkable)) {
+				Log(LogDebug, "CheckerComponent")
+					<< "Checks for checkable '" << checkable->GetName() << "' are disabled. Rescheduling check.";
+
+				/* reschedule the checkable if checks are disabled */
+				checkable->UpdateNextCheck();
+				skipped.push_back(checkable);
+				continue;
 			}
-			if (host && service && (!checkable->GetEnableActiveChecks() || !IcingaApplication::GetInstance()->GetEnableServiceChecks())) {
-				Log(LogNotice, "CheckerComponent")
-					<< "Skipping check for service '" << service->GetName() << "': active service checks are disabled";
-				check = false;
+
+			if (checkable->GetForceNextCheck()) {
+				ObjectLock olock(checkable);
+				checkable->SetForceNextCheck(false);
 			}
 
-			TimePeriod::Ptr tp = checkable->GetCheckPeriod();
+			checks.push_back(checkable);
+		}
+
+		lock.lock();
 
-			if (tp && !tp->IsInside(Utility::GetTime())) {
-				Log(LogNotice, "CheckerComponent")
-					<< "Skipping check for object '" << checkable->GetName()
-					<< "': not in check period '" << tp->GetName() << "'";
-				check = false;
-			}
+		for (const Checkable::Ptr& checkable : skipped) {
+			Checkable::DecreasePendingChecks();
+
+			/* the object might have been deactivated or paused while we weren't holding the lock */
+			if (shard->InFlightCheckables.erase(checkable))
+				shard->IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
 		}
 
-		/* reschedule the checkable if checks are disabled */
-		if (!check) {
-			m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
-			lock.unlock();
+		std::vector<Checkable::Ptr> started;
 
-			Log(LogDebug, "CheckerComponent")
-				<< "Checks for checkable '" << checkable->GetName() << "' are disabled. Rescheduling check.";
+		for (const Checkable::Ptr& checkable : checks) {
+			if (shard->InFlightCheckables.erase(checkable)) {
+				shard->PendingCheckables.insert(GetCheckableScheduleInfo(checkable));
+				started.push_back(checkable);
+			} else
+				Checkable::DecreasePendingChecks();
+		}
 
-			checkable->UpdateNextCheck();
+		checks.swap(started);
 
-			lock.lock();
+		lock.unlock();
 
-			continue;
+		if (!checks.empty()) {
+			Log(LogDebug, "CheckerComponent")
+				<< "Executing " << checks.size() << " checks.";
+
+			/* Hand the checks to the thread pool in batches rather than one by one,
+			 * so that bursts of due checks (e.g. after a reload) don't cost one
+			 * work item and one scheduler lock round trip per check. */
+			for (std::vector<Checkable::Ptr>::size_type i = 0; i < checks.size(); i += CHECK_BATCH_SIZE) {
+				auto end = checks.begin() + std::min(checks.size(), i + CHECK_BATCH_SIZE);
+				std::vector<Checkable::Ptr> batch(checks.begin() + i, end);
+
+				Utility::QueueAsyncCallback(std::bind(&CheckerComponent::ExecuteCheckBatch,
+					CheckerComponent::Ptr(this), shard, std::move(batch)));
+			}
 		}
 
+		lock.lock();
+	}
+}
 
-		csi = GetCheckableScheduleInfo(checkable);
+bool CheckerComponent::IsCheckEnabled(const Checkable::Ptr& checkable)
+{
+	if (checkable->GetForceNextCheck())
+		return true;
 
-		Log(LogDebug, "CheckerComponent")
-			<< "Scheduling info for checkable '" << checkable->GetName() << "' ("
-			<< Utility::FormatDateTime("%Y-%m-%d %H:%M:%S %z", checkable->GetNextCheck()) << "): Object '"
-			<< csi.Object->GetName() << "', Next Check: "
-			<< Utility::FormatDateTime("%Y-%m-%d %H:%M:%S %z", csi.NextCheck) << "(" << csi.NextCheck << ").";
+	bool check = true;
 
-		m_PendingCheckables.insert(csi);
+	if (!checkable->IsReachable(DependencyCheckExecution)) {
+		Log(LogNotice, "CheckerComponent")
+			<< "Skipping check for object '" << checkable->GetName() << "': Dependency failed.";
+		check = false;
+	}
 
-		lock.unlock();
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
 
-		if (forced) {
-			ObjectLock olock(checkable);
-			checkable->SetForceNextCheck(false);
-		}
+	if (host && !service && (!checkable->GetEnableActiveChecks() || !IcingaApplication::GetInstance()->GetEnableHostChecks())) {
+		Log(LogNotice, "CheckerComponent")
+			<< "Skipping check for host '" << host->GetName() << "': active host checks are disabled";
+		check = false;
+	}
+	if (host && service && (!checkable->GetEnableActiveChecks() || !IcingaApplication::GetInstance()->GetEnableServiceChecks())) {
+		Log(LogNotice, "CheckerComponent")
+			<< "Skipping check for service '" << service->GetName() << "': active service checks are disabled";
+		check = false;
+	}
 
-		Log(LogDebug, "CheckerComponent")
-			<< "Executing check for '" << checkable->GetName() << "'";
+	TimePeriod::Ptr tp = checkable->GetCheckPeriod();
 
-		Checkable::IncreasePendingChecks();
+	if (tp && !tp->IsInside(Utility::GetTime())) {
+		Log(LogNotice, "CheckerComponent")
+			<< "Skipping check for object '" << checkable->GetName()
+			<< "': not in check period '" << tp->GetName() << "'";
+		check = false;
+	}
 
-		Utility::QueueAsyncCallback(std::bind(&CheckerComponent::ExecuteCheckHelper, CheckerComponent::Ptr(this), checkable));
+	return check;
+}
 
-		lock.lock();
+void CheckerComponent::ExecuteCheckBatch(SchedulerShard *shard, const std::vector<Checkable::Ptr>& checkables)
+{
+	for (const Checkable::Ptr& checkable : checkables) {
+		ExecuteCheckHelper(checkable);
+
+		/* Return the checkable right away rather than after the whole batch,
+		 * so that its next check isn't delayed by the checks queued after it. */
+		boost::mutex::scoped_lock lock(shard->Mutex);
+
+		/* remove the object from the list of pending objects; if it's not in the
+		 * list this was a manual (i.e. forced) check, or the object was paused or
+		 * deactivated in the meantime; ObjectHandler() has then already taken
+		 * care of it and we must not re-add it here. */
+		auto it = shard->PendingCheckables.find(checkable);
+
+		if (it == shard->PendingCheckables.end())
+			continue;
+
+		shard->PendingCheckables.erase(it);
+
+		if (checkable->IsActive() && !checkable->IsPaused())
+			shard->IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
+
+		shard->CV.notify_all();
 	}
 }
 
 void CheckerComponent::ExecuteCheckHelper(const Checkable::Ptr& checkable)
 {
+	Log(LogDebug, "CheckerComponent")
+		<< "Executing check for '" << checkable->GetName() << "'";
+
 	try {
 		checkable->ExecuteCheck();
 	} catch (const std::exception& ex) {
@@ -237,24 +335,6 @@ void CheckerComponent::ExecuteCheckHelper(const Checkable::Ptr& checkable)
 
 	Checkable::DecreasePendingChecks();
 
-	{
-		boost::mutex::scoped_lock lock(m_Mutex);
-
-		/* remove the object from the list of pending objects; if it's not in the
-		 * list this was a manual (i.e. forced) check and we must not re-add the
-		 * object to the list because it's already there. */
-		auto it = m_PendingCheckables.find(checkable);
-
-		if (it != m_PendingCheckables.end()) {
-			m_PendingCheckables.erase(it);
-
-			if (checkable->IsActive())
-				m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
-
-			m_CV.notify_all();
-		}
-	}
-
 	Log(LogDebug, "CheckerComponent")
 		<< "Check finished for object '" << checkable->GetName() << "'";
 }
@@ -263,12 +343,8 @@ void CheckerComponent::ResultTimerHandler()
 {
 	std::ostringstream msgbuf;
 
-	{
-		boost::mutex::scoped_lock lock(m_Mutex);
-
-		msgbuf << "Pending checkables: " << m_PendingCheckables.size() << "; Idle checkables: " << m_IdleCheckables.size() << "; Checks/s: "
-			<< (CIB::GetActiveHostChecksStatistics(60) + CIB::GetActiveServiceChecksStatistics(60)) / 60.0;
-	}
+	msgbuf << "Pending checkables: " << GetPendingCheckables() << "; Idle checkables: " << GetIdleCheckables() << "; Checks/s: "
+		<< (CIB::GetActiveHostChecksStatistics(60) + CIB::GetActiveServiceChecksStatistics(60)) / 60.0;
 
 	Log(LogNotice, "CheckerComponent", msgbuf.str());
 }
@@ -284,19 +360,22 @@ void CheckerComponent::ObjectHandler(const ConfigObject::Ptr& object)
 	bool same_zone = (!zone || Zone::GetLocalZone() == zone);
 
 	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+		SchedulerShard *shard = GetShard(checkable);
+		boost::mutex::scoped_lock lock(shard->Mutex);
 
 		if (object->IsActive() && !object->IsPaused() && same_zone) {
-			if (m_PendingCheckables.find(checkable) != m_PendingCheckables.end())
+			if (shard->PendingCheckables.find(checkable) != shard->PendingCheckables.end() ||
+				shard->InFlightCheckables.find(checkable) != shard->InFlightCheckables.end())
 				return;
 
-			m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
+			shard->IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
 		} else {
-			m_IdleCheckables.erase(checkable);
-			m_PendingCheckables.erase(checkable);
+			shard->IdleCheckables.erase(checkable);
+			shard->PendingCheckables.erase(checkable);
+			shard->InFlightCheckables.erase(checkable);
 		}
 
-		m_CV.notify_all();
+		shard->CV.notify_all();
 	}
 }
 
@@ -308,37 +387,70 @@ CheckableScheduleInfo CheckerComponent::GetCheckableScheduleInfo(const Checkable
 	return csi;
 }
 
+CheckerComponent::SchedulerShard *CheckerComponent::GetShard(const Checkable::Ptr& checkable) const
+{
+	if (m_Shards.size() == 1)
+		return m_Shards[0].get();
+
+	size_t hash = std::hash<std::string>()(checkable->GetName().GetData());
+	return m_Shards[hash % m_Shards.size()].get();
+}
+
 void CheckerComponent::NextCheckChangedHandler(const Checkable::Ptr& checkable)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	SchedulerShard *shard = GetShard(checkable);
+	boost::mutex::scoped_lock lock(shard->Mutex);
 
-	/* remove and re-insert the object from the set in order to force an index update */
-	typedef boost::multi_index::nth_index<CheckableSet, 0>::type CheckableView;
-	CheckableView& idx = boost::get<0>(m_IdleCheckables);
+	/* the index is updated by the shard's scheduler thread, see ApplyRescheduled() */
+	shard->Rescheduled.push_back(checkable);
 
-	auto it = idx.find(checkable);
+	shard->CV.notify_all();
+}
 
-	if (it == idx.end())
+/**
+ * Re-sorts the checkables whose next check timestamp has changed since the
+ * last call. The shard's mutex must be held by the caller.
+ */
+void CheckerComponent::ApplyRescheduled(SchedulerShard *shard)
+{
+	if (shard->Rescheduled.empty())
 		return;
 
-	idx.erase(checkable);
+	typedef boost::multi_index::nth_index<CheckableSet, 0>::type CheckableView;
+	CheckableView& idx = boost::get<0>(shard->IdleCheckables);
+
+	for (const Checkable::Ptr& checkable : shard->Rescheduled) {
+		auto it = idx.find(checkable);
 
-	CheckableScheduleInfo csi = GetCheckableScheduleInfo(checkable);
-	idx.insert(csi);
+		if (it == idx.end())
+			continue;
 
-	m_CV.notify_all();
+		idx.replace(it, GetCheckableScheduleInfo(checkable));
+	}
+
+	shard->Rescheduled.clear();
 }
 
 unsigned long CheckerComponent::GetIdleCheckables()
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	unsigned long count = 0;
+
+	for (const std::unique_ptr<SchedulerShard>& shard : m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		count += shard->IdleCheckables.size();
+	}
 
-	return m_IdleCheckables.size();
+	return count;
 }
 
 unsigned long CheckerComponent::GetPendingCheckables()
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	unsigned long count = 0;
+
+	for (const std::unique_ptr<SchedulerShard>& shard : m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		count += shard->PendingCheckables.size();
+	}
 
-	return m_PendingCheckables.size();
+	return count;
 }
@@ -30,11 +30,18 @@
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/key_extractors.hpp>
+#include <atomic>
+#include <memory>
+#include <set>
 #include <thread>
+#include <vector>
 
 namespace icinga
 {
 
+/* Maximum number of checks handed to a single thread pool work item. */
+#define CHECK_BATCH_SIZE 32U
+
 /**
  * @ingroup checker
  */
@@ -54,7 +61,7 @@ struct CheckableNextCheckExtractor
 	/**
 	 * @threadsafety Always.
 	 */
-	double operator()(const CheckableScheduleInfo& csi)
+	double operator()(const CheckableScheduleInfo& csi) const
 	{
 		return csi.NextCheck;
 	}
@@ -81,28 +88,55 @@ public:
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
+	void ValidateSchedulerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
+
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 	unsigned long GetIdleCheckables();
 	unsigned long GetPendingCheckables();
 
 private:
-	boost::mutex m_Mutex;
-	boost::condition_variable m_CV;
-	bool m_Stopped{false};
-	std::thread m_Thread;
+	/**
+	 * A scheduler shard owns a disjoint subset of the checkables (selected
+	 * by hashing the checkable's name) and has its own dispatch thread.
+	 *
+	 * Next check changes are only queued in Rescheduled and applied to the
+	 * index by the dispatch thread itself, so result processing never has
+	 * to wait for an index update.
+	 */
+	struct SchedulerShard
+	{
+		boost::mutex Mutex;
+		boost::condition_variable CV;
+		std::thread Thread;
 
-	CheckableSet m_IdleCheckables;
-	CheckableSet m_PendingCheckables;
+		CheckableSet IdleCheckables;
+		CheckableSet PendingCheckables;
+		std::vector<Checkable::Ptr> Rescheduled;
+
+		/* Checkables taken from IdleCheckables which are still being evaluated. */
+		std::set<Checkable::Ptr> InFlightCheckables;
+	};
+
+	std::atomic<bool> m_Stopped{false};
+	std::vector<std::unique_ptr<SchedulerShard> > m_Shards;
+
+	/* Serializes the check slot reservation of the shards. */
+	boost::mutex m_SlotMutex;
 
 	Timer::Ptr m_ResultTimer;
 
-	void CheckThreadProc();
+	void CheckThreadProc(SchedulerShard *shard);
 	void ResultTimerHandler();
 
+	static bool IsCheckEnabled(const Checkable::Ptr& checkable);
+	void ExecuteCheckBatch(SchedulerShard *shard, const std::vector<Checkable::Ptr>& checkables);
 	void ExecuteCheckHelper(const Checkable::Ptr& checkable);
 
 	void AdjustCheckTimer();
 
+	SchedulerShard *GetShard(const Checkable::Ptr& checkable) const;
+	static void ApplyRescheduled(SchedulerShard *shard);
+
 	void ObjectHandler(const ConfigObject::Ptr& object);
 	void NextCheckChangedHandler(const Checkable::Ptr& checkable);
 
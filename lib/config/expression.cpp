@@ -442,10 +442,7 @@ ExpressionResult LogicalAndExpression::DoEvaluate(ScriptFrame& frame, DebugHint
 	if (!operand1.GetValue().ToBool())
 		return operand1;
 	else {
-		ExpressionResult operand2 = m_Operand2->Evaluate(frame);
-		CHECK_RESULT(operand2);
-
-		return operand2.GetValue();
+		return m_Operand2->Evaluate(frame);
 	}
 }
 
@@ -457,10 +454,7 @@ ExpressionResult LogicalOrExpression::DoEvaluate(ScriptFrame& frame, DebugHint *
 	if (operand1.GetValue().ToBool())
 		return operand1;
 	else {
-		ExpressionResult operand2 = m_Operand2->Evaluate(frame);
-		CHECK_RESULT(operand2);
-
-		return operand2.GetValue();
+		return m_Operand2->Evaluate(frame);
 	}
 }
 
@@ -475,7 +469,7 @@ ExpressionResult FunctionCallExpression::DoEvaluate(ScriptFrame& frame, DebugHin
 		ExpressionResult vfuncres = m_FName->Evaluate(frame);
 		CHECK_RESULT(vfuncres);
 
-		vfunc = vfuncres.GetValue();
+		vfunc = vfuncres.TakeValue();
 	}
 
 	if (vfunc.IsObjectType<Type>()) {
@@ -485,7 +479,7 @@ ExpressionResult FunctionCallExpression::DoEvaluate(ScriptFrame& frame, DebugHin
 			ExpressionResult argres = arg->Evaluate(frame);
 			CHECK_RESULT(argres);
 
-			arguments.push_back(argres.GetValue());
+			arguments.push_back(argres.TakeValue());
 		}
 
 		return VMOps::ConstructorCall(vfunc, arguments, m_DebugInfo);
@@ -505,7 +499,7 @@ ExpressionResult FunctionCallExpression::DoEvaluate(ScriptFrame& frame, DebugHin
 		ExpressionResult argres = arg->Evaluate(frame);
 		CHECK_RESULT(argres);
 
-		arguments.push_back(argres.GetValue());
+		arguments.push_back(argres.TakeValue());
 	}
 
 	return VMOps::FunctionCall(frame, self, func, arguments);
@@ -520,7 +514,7 @@ ExpressionResult ArrayExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhin
 		ExpressionResult element = aexpr->Evaluate(frame);
 		CHECK_RESULT(element);
 
-		result.push_back(element.GetValue());
+		result.push_back(element.TakeValue());
 	}
 
 	return new Array(std::move(result));
@@ -541,7 +535,7 @@ ExpressionResult DictExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint
 		for (const auto& aexpr : m_Expressions) {
 			ExpressionResult element = aexpr->Evaluate(frame, m_Inline ? dhint : nullptr);
 			CHECK_RESULT(element);
-			result = element.GetValue();
+			result = element.TakeValue();
 		}
 	} catch (...) {
 		if (!m_Inline)
@@ -694,7 +688,7 @@ ExpressionResult ReturnExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhi
 	ExpressionResult operand = m_Operand->Evaluate(frame);
 	CHECK_RESULT(operand);
 
-	return ExpressionResult(operand.GetValue(), ResultReturn);
+	return ExpressionResult(operand.TakeValue(), ResultReturn);
 }
 
 ExpressionResult BreakExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
@@ -752,7 +746,7 @@ bool IndexerExpression::GetReference(ScriptFrame& frame, bool init_dict, Value *
 		free_psd = true;
 	} else {
 		ExpressionResult operand1 = m_Operand1->Evaluate(frame);
-		*parent = operand1.GetValue();
+		*parent = operand1.TakeValue();
 	}
 
 	ExpressionResult operand2 = m_Operand2->Evaluate(frame);
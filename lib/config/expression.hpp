@@ -168,6 +168,14 @@ public:
 		return m_Value;
 	}
 
+	/* Moves the value out of the result. Use this when the value is stored
+	 * somewhere else anyway, copying it would update the reference count
+	 * of objects and strings for nothing. */
+	Value TakeValue()
+	{
+		return std::move(m_Value);
+	}
+
 	ExpressionResultCode GetCode() const
 	{
 		return m_Code;
@@ -297,6 +305,16 @@ public:
 		: DebuggableExpression(debugInfo), m_Operand1(std::move(operand1)), m_Operand2(std::move(operand2))
 	{ }
 
+	Expression *GetOperand1() const
+	{
+		return m_Operand1.get();
+	}
+
+	Expression *GetOperand2() const
+	{
+		return m_Operand2.get();
+	}
+
 protected:
 	std::unique_ptr<Expression> m_Operand1;
 	std::unique_ptr<Expression> m_Operand2;
@@ -626,6 +644,16 @@ public:
 
 	void MakeInline();
 
+	bool IsInline() const
+	{
+		return m_Inline;
+	}
+
+	const std::vector<std::unique_ptr<Expression> >& GetExpressions() const
+	{
+		return m_Expressions;
+	}
+
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 
@@ -280,7 +280,7 @@ private:
 		DictionaryData locals;
 
 		for (const auto& cvar : closedVars)
-			locals.emplace_back(cvar.first, cvar.second->Evaluate(frame));
+			locals.emplace_back(cvar.first, cvar.second->Evaluate(frame).TakeValue());
 
 		return new Dictionary(std::move(locals));
 	}
@@ -26,6 +26,9 @@
 #include "base/perfdatavalue.hpp"
 #include "base/configtype.hpp"
 #include "base/statsfunction.hpp"
+#include "base/threadpool.hpp"
+#include "base/timer.hpp"
+#include "base/application.hpp"
 
 using namespace icinga;
 
@@ -308,6 +311,25 @@ void CIB::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata) {
 
 	status->Set("remote_check_queue", ClusterEvents::GetCheckRequestQueueSize());
 
+	ThreadPoolStatistics tps = Application::GetTP().GetStatistics();
+
+	status->Set("thread_pool_threads", tps.Threads);
+	status->Set("thread_pool_idle_threads", tps.IdleThreads);
+	status->Set("thread_pool_pending", tps.Lanes[DefaultScheduler].Pending);
+	status->Set("thread_pool_task_rate", tps.Lanes[DefaultScheduler].TaskRate);
+	status->Set("thread_pool_avg_wait_time", tps.Lanes[DefaultScheduler].AvgWaitTime);
+	status->Set("thread_pool_avg_service_time", tps.Lanes[DefaultScheduler].AvgServiceTime);
+	status->Set("thread_pool_low_latency_pending", tps.Lanes[LowLatencyScheduler].Pending);
+	status->Set("thread_pool_low_latency_task_rate", tps.Lanes[LowLatencyScheduler].TaskRate);
+	status->Set("thread_pool_low_latency_avg_wait_time", tps.Lanes[LowLatencyScheduler].AvgWaitTime);
+	status->Set("thread_pool_low_latency_avg_service_time", tps.Lanes[LowLatencyScheduler].AvgServiceTime);
+
+	TimerStatistics ts = Timer::GetStatistics();
+
+	status->Set("timers", ts.Timers);
+	status->Set("timer_avg_lag", ts.AvgLag);
+	status->Set("timer_max_lag", ts.MaxLag);
+
 	CheckableCheckStatistics scs = CalculateServiceCheckStats();
 
 	status->Set("min_latency", scs.min_latency);
@@ -31,6 +31,8 @@
 #include "base/perfdatavalue.hpp"
 #include "base/function.hpp"
 #include "base/configtype.hpp"
+#include "base/threadpool.hpp"
+#include "base/timer.hpp"
 
 using namespace icinga;
 
@@ -94,6 +96,20 @@ void IcingaCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 	perfdata->Add(new PerfdataValue("current_concurrent_checks", Checkable::GetPendingChecks()));
 	perfdata->Add(new PerfdataValue("remote_check_queue", ClusterEvents::GetCheckRequestQueueSize()));
 
+	ThreadPoolStatistics tps = Application::GetTP().GetStatistics();
+
+	perfdata->Add(new PerfdataValue("thread_pool_threads", tps.Threads));
+	perfdata->Add(new PerfdataValue("thread_pool_pending", tps.Lanes[DefaultScheduler].Pending));
+	perfdata->Add(new PerfdataValue("thread_pool_avg_wait_time", tps.Lanes[DefaultScheduler].AvgWaitTime));
+	perfdata->Add(new PerfdataValue("thread_pool_avg_service_time", tps.Lanes[DefaultScheduler].AvgServiceTime));
+	perfdata->Add(new PerfdataValue("thread_pool_low_latency_avg_wait_time", tps.Lanes[LowLatencyScheduler].AvgWaitTime));
+
+	TimerStatistics ts = Timer::GetStatistics();
+
+	perfdata->Add(new PerfdataValue("timers", ts.Timers));
+	perfdata->Add(new PerfdataValue("timer_avg_lag", ts.AvgLag));
+	perfdata->Add(new PerfdataValue("timer_max_lag", ts.MaxLag));
+
 	CheckableCheckStatistics scs = CIB::CalculateServiceCheckStats();
 
 	perfdata->Add(new PerfdataValue("min_latency", scs.min_latency));
@@ -128,7 +144,7 @@ void IcingaCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 	perfdata->Add(new PerfdataValue("num_hosts_in_downtime", hs.hosts_in_downtime));
 	perfdata->Add(new PerfdataValue("num_hosts_acknowledged", hs.hosts_acknowledged));
 
-	std::vector<Endpoint::Ptr> endpoints = ConfigType::GetObjectsByType<Endpoint>();
+	auto endpoints = ConfigType::GetObjectsByType<Endpoint>();
 
 	double lastMessageSent = 0;
 	double lastMessageReceived = 0;
@@ -541,7 +541,7 @@ void ElasticsearchWriter::SendRequest(const String& body)
 
 		Dictionary::Ptr jsonResponse;
 		try {
-			jsonResponse = JsonDecode(buffer.get());
+			jsonResponse = JsonDecode(buffer.get(), responseSize);
 		} catch (...) {
 			Log(LogWarning, "ElasticsearchWriter")
 				<< "Unable to parse JSON response:\n" << buffer.get();
@@ -509,7 +509,7 @@ void InfluxdbWriter::Flush()
 
 		Dictionary::Ptr jsonResponse;
 		try {
-			jsonResponse = JsonDecode(buffer.get());
+			jsonResponse = JsonDecode(buffer.get(), responseSize);
 		} catch (...) {
 			Log(LogWarning, "InfluxdbWriter")
 				<< "Unable to parse JSON response:\n" << buffer.get();
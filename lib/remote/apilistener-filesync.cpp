@@ -31,7 +31,7 @@ using namespace icinga;
 
 REGISTER_APIFUNCTION(Update, config, &ApiListener::ConfigUpdateHandler);
 
-void ApiListener::ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file)
+void ApiListener::ConfigGlobHandler(DictionaryData& updateV1, DictionaryData& updateV2, const String& path, const String& file)
 {
 	CONTEXT("Creating config update for file '" + file + "'");
 
@@ -44,35 +44,39 @@ void ApiListener::ConfigGlobHandler(ConfigDirInformation& config, const String&
 
 	String content((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
 
-	Dictionary::Ptr update;
+	DictionaryData& update = Utility::Match("*.conf", file) ? updateV1 : updateV2;
 
-	if (Utility::Match("*.conf", file))
-		update = config.UpdateV1;
-	else
-		update = config.UpdateV2;
-
-	update->Set(file.SubStr(path.GetLength()), content);
+	update.emplace_back(file.SubStr(path.GetLength()), std::move(content));
 }
 
 Dictionary::Ptr ApiListener::MergeConfigUpdate(const ConfigDirInformation& config)
 {
-	Dictionary::Ptr result = new Dictionary();
+	DictionaryData result;
 
-	if (config.UpdateV1)
-		config.UpdateV1->CopyTo(result);
+	/* The dictionary keeps the first of several identical keys, V2 files take precedence. */
+	for (const Dictionary::Ptr& update : { config.UpdateV2, config.UpdateV1 }) {
+		if (!update)
+			continue;
 
-	if (config.UpdateV2)
-		config.UpdateV2->CopyTo(result);
+		ObjectLock olock(update);
+
+		for (const Dictionary::Pair& kv : update) {
+			result.emplace_back(kv);
+		}
+	}
 
-	return result;
+	return new Dictionary(std::move(result));
 }
 
 ConfigDirInformation ApiListener::LoadConfigDir(const String& dir)
 {
+	/* Files are collected first, setting them one by one in glob order is quadratic for large zone directories. */
+	DictionaryData updateV1, updateV2;
+	Utility::GlobRecursive(dir, "*", std::bind(&ApiListener::ConfigGlobHandler, std::ref(updateV1), std::ref(updateV2), dir, _1), GlobFile);
+
 	ConfigDirInformation config;
-	config.UpdateV1 = new Dictionary();
-	config.UpdateV2 = new Dictionary();
-	Utility::GlobRecursive(dir, "*", std::bind(&ApiListener::ConfigGlobHandler, std::ref(config), dir, _1), GlobFile);
+	config.UpdateV1 = new Dictionary(std::move(updateV1));
+	config.UpdateV2 = new Dictionary(std::move(updateV2));
 	return config;
 }
 
@@ -175,28 +179,33 @@ bool ApiListener::UpdateConfigDir(const ConfigDirInformation& oldConfigInfo, con
 
 void ApiListener::SyncZoneDir(const Zone::Ptr& zone) const
 {
-	ConfigDirInformation newConfigInfo;
-	newConfigInfo.UpdateV1 = new Dictionary();
-	newConfigInfo.UpdateV2 = new Dictionary();
+	std::vector<ZoneFragment> zoneDirs = ConfigCompiler::GetZoneDirs(zone->GetName());
+	DictionaryData updateV1, updateV2;
 
-	for (const ZoneFragment& zf : ConfigCompiler::GetZoneDirs(zone->GetName())) {
+	/* The dictionary keeps the first of several identical keys, files from later fragments take precedence. */
+	for (auto it = zoneDirs.rbegin(); it != zoneDirs.rend(); it++) {
+		const ZoneFragment& zf = *it;
 		ConfigDirInformation newConfigPart = LoadConfigDir(zf.Path);
 
 		{
 			ObjectLock olock(newConfigPart.UpdateV1);
 			for (const Dictionary::Pair& kv : newConfigPart.UpdateV1) {
-				newConfigInfo.UpdateV1->Set("/" + zf.Tag + kv.first, kv.second);
+				updateV1.emplace_back("/" + zf.Tag + kv.first, kv.second);
 			}
 		}
 
 		{
 			ObjectLock olock(newConfigPart.UpdateV2);
 			for (const Dictionary::Pair& kv : newConfigPart.UpdateV2) {
-				newConfigInfo.UpdateV2->Set("/" + zf.Tag + kv.first, kv.second);
+				updateV2.emplace_back("/" + zf.Tag + kv.first, kv.second);
 			}
 		}
 	}
 
+	ConfigDirInformation newConfigInfo;
+	newConfigInfo.UpdateV1 = new Dictionary(std::move(updateV1));
+	newConfigInfo.UpdateV2 = new Dictionary(std::move(updateV2));
+
 	int sumUpdates = newConfigInfo.UpdateV1->GetLength() + newConfigInfo.UpdateV2->GetLength();
 
 	if (sumUpdates == 0)
@@ -27,12 +27,14 @@
 #include "base/netstring.hpp"
 #include "base/json.hpp"
 #include "base/configtype.hpp"
+#include "base/configuration.hpp"
 #include "base/logger.hpp"
 #include "base/objectlock.hpp"
 #include "base/stdiostream.hpp"
 #include "base/perfdatavalue.hpp"
 #include "base/application.hpp"
 #include "base/context.hpp"
+#include "base/defer.hpp"
 #include "base/statsfunction.hpp"
 #include "base/exception.hpp"
 #include <fstream>
@@ -240,15 +242,23 @@ void ApiListener::Start(bool runtimeCreated)
 	Log(LogInformation, "ApiListener")
 		<< "'" << GetName() << "' started.";
 
+#ifndef SSL_OP_ENABLE_KTLS
+	if (Configuration::TlsKernelOffload) {
+		Log(LogWarning, "ApiListener")
+			<< "TlsKernelOffload is enabled but the OpenSSL library Icinga 2 was built against doesn't support kTLS. "
+			<< "TLS records are encrypted by Icinga 2.";
+	}
+#endif /* SSL_OP_ENABLE_KTLS */
+
 	SyncZoneDirs();
 
 	ObjectImpl<ApiListener>::Start(runtimeCreated);
 
-	{
-		boost::mutex::scoped_lock lock(m_LogLock);
-		RotateLogFile();
-		OpenLogFile();
-	}
+	RotateLogFile();
+	OpenLogFile();
+
+	m_LogStopped = false;
+	m_LogThread = std::thread(std::bind(&ApiListener::LogWriterThreadProc, this));
 
 	/* create the primary JSON-RPC listener */
 	if (!AddListener(GetBindHost(), GetBindPort())) {
@@ -292,9 +302,15 @@ void ApiListener::Stop(bool runtimeDeleted)
 
 	{
 		boost::mutex::scoped_lock lock(m_LogLock);
-		CloseLogFile();
+		m_LogStopped = true;
+		m_LogCV.notify_all();
 	}
 
+	if (m_LogThread.joinable())
+		m_LogThread.join();
+
+	CloseLogFile();
+
 	RemoveStatusFile();
 }
 
@@ -860,45 +876,148 @@ void ApiListener::RelayMessage(const MessageOrigin::Ptr& origin,
 	m_RelayQueue.Enqueue(std::bind(&ApiListener::SyncRelayMessage, this, origin, secobj, message, log), PriorityNormal, true);
 }
 
-void ApiListener::PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj)
+void ApiListener::PersistMessage(const EncodedMessage::Ptr& message, const ConfigObject::Ptr& secobj)
 {
-	double ts = message->Get("ts");
+	double ts = message->GetTimestamp();
 
 	ASSERT(ts != 0);
 
-	Dictionary::Ptr pmessage = new Dictionary();
-	pmessage->Set("timestamp", ts);
-
-	pmessage->Set("message", JsonEncode(message));
+	String secobjType, secobjName;
 
 	if (secobj) {
-		Dictionary::Ptr secname = new Dictionary();
-		secname->Set("type", secobj->GetReflectionType()->GetName());
-		secname->Set("name", secobj->GetName());
-		pmessage->Set("secobj", secname);
+		secobjType = secobj->GetReflectionType()->GetName();
+		secobjName = secobj->GetName();
 	}
 
+	ReplayLogEntry entry { ts, secobjType, secobjName, message };
+
 	boost::mutex::scoped_lock lock(m_LogLock);
-	if (m_LogFile) {
-		NetString::WriteStringToStream(m_LogFile, JsonEncode(pmessage));
-		m_LogMessageCount++;
-		SetLogMessageTimestamp(ts);
 
-		if (m_LogMessageCount > 50000) {
+	m_LogQueue.emplace_back(std::move(entry));
+
+	/* The writer is already awake if there were other messages in the queue. */
+	if (m_LogQueue.size() == 1)
+		m_LogCV.notify_all();
+}
+
+/**
+ * Writes the queued messages to the replay log. All messages which were
+ * queued while the previous batch was being written are written at once
+ * and the file is only flushed once per batch.
+ */
+void ApiListener::LogWriterThreadProc()
+{
+	Utility::SetThreadName("Replay Log");
+
+	for (;;) {
+		std::vector<ReplayLogEntry> messages;
+		unsigned long rotation;
+		bool paused, stopped;
+
+		{
+			boost::mutex::scoped_lock lock(m_LogLock);
+
+			while (!m_LogStopped && m_LogRotationsRequested == m_LogRotationsDone && (m_LogQueue.empty() || m_LogPaused > 0))
+				m_LogCV.wait(lock);
+
+			rotation = m_LogRotationsRequested;
+			paused = m_LogPaused > 0;
+			stopped = m_LogStopped;
+
+			/* Messages which were queued before a rotation was requested
+			 * belong into the file that is about to be rotated. When we're
+			 * stopping the queue is written even if the writer is paused. */
+			if (!paused || stopped || rotation != m_LogRotationsDone)
+				messages.swap(m_LogQueue);
+		}
+
+		for (const ReplayLogEntry& entry : messages) {
+			if (!m_LogFile)
+				OpenLogFile();
+
+			if (!m_LogFile)
+				break;
+
+			m_LogFile->Write(entry.Timestamp, entry.SecobjType, entry.SecobjName, entry.Message->GetJson(), entry.Message->GetJsonLength());
+			m_LogMessageCount++;
+			SetLogMessageTimestamp(entry.Timestamp);
+
+			if (m_LogMessageCount > 50000) {
+				CloseLogFile();
+				RotateLogFile();
+			}
+		}
+
+		if (m_LogFile)
+			m_LogFile->Flush();
+
+		if (rotation != m_LogRotationsDone) {
 			CloseLogFile();
 			RotateLogFile();
-			OpenLogFile();
+
+			if (!paused)
+				OpenLogFile();
+
+			boost::mutex::scoped_lock lock(m_LogLock);
+			m_LogRotationsDone = rotation;
+			m_LogRotatedCV.notify_all();
 		}
+
+		if (stopped && messages.empty())
+			break;
 	}
 }
 
+/**
+ * Asks the log writer thread to rotate the current log file and waits until
+ * it has done so. Readers may then read all rotated files without holding
+ * any locks.
+ *
+ * @param pause Whether the writer should stop writing new messages until
+ *              ResumeLog() is called. New messages are queued in the meantime.
+ * @returns false if the writer has been stopped already; ResumeLog() must not
+ *          be called then.
+ */
+bool ApiListener::RequestLogRotation(bool pause)
+{
+	boost::mutex::scoped_lock lock(m_LogLock);
+
+	if (m_LogStopped)
+		return false;
+
+	unsigned long rotation = ++m_LogRotationsRequested;
+
+	if (pause)
+		m_LogPaused++;
+
+	m_LogCV.notify_all();
+
+	while (m_LogRotationsDone < rotation && !m_LogStopped)
+		m_LogRotatedCV.wait(lock);
+
+	return true;
+}
+
+void ApiListener::ResumeLog()
+{
+	boost::mutex::scoped_lock lock(m_LogLock);
+
+	if (--m_LogPaused == 0)
+		m_LogCV.notify_all();
+}
+
 void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message)
+{
+	SyncSendMessage(endpoint, new EncodedMessage(message));
+}
+
+void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const EncodedMessage::Ptr& message)
 {
 	ObjectLock olock(endpoint);
 
 	if (!endpoint->GetSyncing()) {
 		Log(LogNotice, "ApiListener")
-			<< "Sending message '" << message->Get("method") << "' to '" << endpoint->GetName() << "'";
+			<< "Sending message '" << message->GetMethod() << "' to '" << endpoint->GetName() << "'";
 
 		double maxTs = 0;
 
@@ -916,7 +1035,7 @@ void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionar
 	}
 }
 
-bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrigin::Ptr& origin, const Dictionary::Ptr& message, const Endpoint::Ptr& currentMaster)
+bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrigin::Ptr& origin, const EncodedMessage::Ptr& message, const Endpoint::Ptr& currentMaster)
 {
 	ASSERT(targetZone);
 
@@ -999,7 +1118,7 @@ bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrig
 	}
 
 	if (!skippedEndpoints.empty()) {
-		double ts = message->Get("ts");
+		double ts = message->GetTimestamp();
 
 		for (const Endpoint::Ptr& endpoint : skippedEndpoints)
 			endpoint->SetLocalLogPosition(ts);
@@ -1034,38 +1153,41 @@ void ApiListener::SyncRelayMessage(const MessageOrigin::Ptr& origin,
 
 	Endpoint::Ptr master = GetMaster();
 
-	bool need_log = !RelayMessageOne(target_zone, origin, message, master);
+	/* The message is encoded once and shared by all endpoints and the replay log. */
+	EncodedMessage::Ptr emessage = new EncodedMessage(message);
+
+	bool need_log = !RelayMessageOne(target_zone, origin, emessage, master);
 
 	for (const Zone::Ptr& zone : target_zone->GetAllParentsRaw()) {
-		if (!RelayMessageOne(zone, origin, message, master))
+		if (!RelayMessageOne(zone, origin, emessage, master))
 			need_log = true;
 	}
 
 	if (log && need_log)
-		PersistMessage(message, secobj);
+		PersistMessage(emessage, secobj);
 }
 
-/* must hold m_LogLock */
+/* must only be called by the log writer thread once it's running */
 void ApiListener::OpenLogFile()
 {
 	String path = GetApiDir() + "log/current";
 
 	Utility::MkDirP(Utility::DirName(path), 0750);
 
-	auto *fp = new std::fstream(path.CStr(), std::fstream::out | std::ofstream::app);
+	std::unique_ptr<ReplayLogWriter> logFile(new ReplayLogWriter(path));
 
-	if (!fp->good()) {
+	if (!logFile->IsGood()) {
 		Log(LogWarning, "ApiListener")
 			<< "Could not open spool file: " << path;
 		return;
 	}
 
-	m_LogFile = new StdioStream(fp, true);
+	m_LogFile = std::move(logFile);
 	m_LogMessageCount = 0;
 	SetLogMessageTimestamp(Utility::GetTime());
 }
 
-/* must hold m_LogLock */
+/* must only be called by the log writer thread once it's running */
 void ApiListener::CloseLogFile()
 {
 	if (!m_LogFile)
@@ -1075,7 +1197,7 @@ void ApiListener::CloseLogFile()
 	m_LogFile.reset();
 }
 
-/* must hold m_LogLock */
+/* must only be called by the log writer thread once it's running */
 void ApiListener::RotateLogFile()
 {
 	double ts = GetLogMessageTimestamp();
@@ -1141,16 +1263,24 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 		return;
 	}
 
-	for (;;) {
-		boost::mutex::scoped_lock lock(m_LogLock);
+	std::map<std::pair<String, String>, bool> secobjAccess;
 
-		CloseLogFile();
-		RotateLogFile();
+	/* The writer must be resumed even if replaying the log throws. */
+	bool paused = false;
 
-		if (count == -1 || count > 50000) {
-			OpenLogFile();
-			lock.unlock();
-		} else {
+	Defer resume([this, &paused]() {
+		if (paused)
+			ResumeLog();
+	});
+
+	for (;;) {
+		/* Once there are only a few messages left the writer is paused during
+		 * the last pass so that no messages are persisted which this endpoint
+		 * wouldn't see. They're written to the log once syncing has finished. */
+		if (count == -1 || count > 50000)
+			RequestLogRotation(false);
+		else {
+			paused = RequestLogRotation(true);
 			last_sync = true;
 		}
 
@@ -1169,6 +1299,49 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 			Log(LogNotice, "ApiListener")
 				<< "Replaying log: " << path;
 
+			ReplayLogReader reader(path);
+
+			if (reader.IsGood()) {
+				/* Only the record headers have to be read to decide whether
+				 * a message needs to be sent, the message is sent verbatim. */
+				reader.SeekToTimestamp(peer_ts);
+
+				double timestamp;
+				String secobjType, secobjName;
+
+				while (reader.Next(&timestamp, &secobjType, &secobjName)) {
+					if (timestamp <= peer_ts)
+						continue;
+
+					if (!secobjType.IsEmpty()) {
+						auto key = std::make_pair(secobjType, secobjName);
+						auto it = secobjAccess.find(key);
+
+						if (it == secobjAccess.end()) {
+							ConfigObject::Ptr secobj = ConfigObject::GetObject(secobjType, secobjName);
+							it = secobjAccess.insert(std::make_pair(key, secobj && target_zone->CanAccessObject(secobj))).first;
+						}
+
+						if (!it->second)
+							continue;
+					}
+
+					String message = reader.ReadMessage();
+
+					if (message.IsEmpty())
+						break;
+
+					if (!ReplayLogMessage(client, ts, message, logpos_ts))
+						break;
+
+					peer_ts = timestamp;
+					count++;
+				}
+
+				continue;
+			}
+
+			/* Log files which were written by older versions. */
 			auto *fp = new std::fstream(path.CStr(), std::fstream::in | std::fstream::binary);
 			StdioStream::Ptr logStream = new StdioStream(fp, true);
 
@@ -1210,36 +1383,11 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 						continue;
 				}
 
-				try  {
-					size_t bytesSent = NetString::WriteStringToStream(client->GetStream(), pmessage->Get("message"));
-					endpoint->AddMessageSent(bytesSent);
-					count++;
-				} catch (const std::exception& ex) {
-					Log(LogWarning, "ApiListener")
-						<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex, false);
-
-					Log(LogDebug, "ApiListener")
-						<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex);
-
+				if (!ReplayLogMessage(client, ts, pmessage->Get("message"), logpos_ts))
 					break;
-				}
 
 				peer_ts = pmessage->Get("timestamp");
-
-				if (ts > logpos_ts + 10) {
-					logpos_ts = ts;
-
-					Dictionary::Ptr lmessage = new Dictionary({
-						{ "jsonrpc", "2.0" },
-						{ "method", "log::SetLogPosition" },
-						{ "params", new Dictionary({
-							{ "log_position", logpos_ts }
-						}) }
-					});
-
-					size_t bytesSent = JsonRpc::SendMessage(client->GetStream(), lmessage);
-					endpoint->AddMessageSent(bytesSent);
-				}
+				count++;
 			}
 
 			logStream->Close();
@@ -1259,13 +1407,52 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 				endpoint->SetSyncing(false);
 			}
 
-			OpenLogFile();
-
 			break;
 		}
 	}
 }
 
+/**
+ * Sends a message from the replay log to an endpoint and updates the
+ * endpoint's log position every few seconds.
+ *
+ * @returns false if the message could not be sent.
+ */
+bool ApiListener::ReplayLogMessage(const JsonRpcConnection::Ptr& client, int ts, const String& message, double& logpos_ts)
+{
+	Endpoint::Ptr endpoint = client->GetEndpoint();
+
+	try  {
+		size_t bytesSent = NetString::WriteStringToStream(client->GetStream(), message);
+		endpoint->AddMessageSent(bytesSent);
+
+		if (ts > logpos_ts + 10) {
+			logpos_ts = ts;
+
+			Dictionary::Ptr lmessage = new Dictionary({
+				{ "jsonrpc", "2.0" },
+				{ "method", "log::SetLogPosition" },
+				{ "params", new Dictionary({
+					{ "log_position", logpos_ts }
+				}) }
+			});
+
+			bytesSent = JsonRpc::SendMessage(client->GetStream(), lmessage);
+			endpoint->AddMessageSent(bytesSent);
+		}
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ApiListener")
+			<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex, false);
+
+		Log(LogDebug, "ApiListener")
+			<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex);
+
+		return false;
+	}
+
+	return true;
+}
+
 void ApiListener::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	std::pair<Dictionary::Ptr, Dictionary::Ptr> stats;
@@ -25,13 +25,16 @@
 #include "remote/httpserverconnection.hpp"
 #include "remote/endpoint.hpp"
 #include "remote/messageorigin.hpp"
+#include "remote/replaylog.hpp"
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/tlsstream.hpp"
 #include "base/threadpool.hpp"
+#include <memory>
 #include <set>
+#include <thread>
 
 namespace icinga
 {
@@ -75,6 +78,7 @@ public:
 	Endpoint::Ptr GetLocalEndpoint() const;
 
 	void SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message);
+	void SyncSendMessage(const Endpoint::Ptr& endpoint, const EncodedMessage::Ptr& message);
 	void RelayMessage(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
@@ -155,19 +159,33 @@ private:
 	WorkQueue m_RelayQueue;
 	WorkQueue m_SyncQueue{0, 4};
 
+	/* m_LogLock only protects the queue, the log file is owned by the log writer thread. */
 	boost::mutex m_LogLock;
-	Stream::Ptr m_LogFile;
+	boost::condition_variable m_LogCV;
+	boost::condition_variable m_LogRotatedCV;
+	std::vector<ReplayLogEntry> m_LogQueue;
+	unsigned long m_LogRotationsRequested{0};
+	unsigned long m_LogRotationsDone{0};
+	int m_LogPaused{0};
+	bool m_LogStopped{true};
+	std::thread m_LogThread;
+
+	std::unique_ptr<ReplayLogWriter> m_LogFile;
 	size_t m_LogMessageCount{0};
 
-	bool RelayMessageOne(const Zone::Ptr& zone, const MessageOrigin::Ptr& origin, const Dictionary::Ptr& message, const Endpoint::Ptr& currentMaster);
+	bool RelayMessageOne(const Zone::Ptr& zone, const MessageOrigin::Ptr& origin, const EncodedMessage::Ptr& message, const Endpoint::Ptr& currentMaster);
 	void SyncRelayMessage(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
-	void PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj);
+	void PersistMessage(const EncodedMessage::Ptr& message, const ConfigObject::Ptr& secobj);
 
 	void OpenLogFile();
 	void RotateLogFile();
 	void CloseLogFile();
+	void LogWriterThreadProc();
+	bool RequestLogRotation(bool pause);
+	void ResumeLog();
 	static void LogGlobHandler(std::vector<int>& files, const String& file);
 	void ReplayLog(const JsonRpcConnection::Ptr& client);
+	bool ReplayLogMessage(const JsonRpcConnection::Ptr& client, int ts, const String& message, double& logpos_ts);
 
 	static void CopyCertificateFile(const String& oldCertPath, const String& newCertPath);
 
@@ -182,7 +200,7 @@ private:
 	void SyncZoneDirs() const;
 	void SyncZoneDir(const Zone::Ptr& zone) const;
 
-	static void ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file);
+	static void ConfigGlobHandler(DictionaryData& updateV1, DictionaryData& updateV2, const String& path, const String& file);
 	void SendConfigUpdate(const JsonRpcConnection::Ptr& aclient);
 
 	/* configsync */
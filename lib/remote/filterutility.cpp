@@ -24,8 +24,11 @@
 #include "base/namespace.hpp"
 #include "base/json.hpp"
 #include "base/configtype.hpp"
+#include "base/dependencygraph.hpp"
 #include "base/logger.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
+#include <algorithm>
+#include <iterator>
 
 using namespace icinga;
 
@@ -128,6 +131,351 @@ bool FilterUtility::EvaluateFilter(ScriptFrame& frame, Expression *filter,
 	return Convert::ToBool(filter->Evaluate(frame));
 }
 
+/* Objects which may match a filter, ordered by their address. */
+typedef std::set<ConfigObject::Ptr> FilterCandidates;
+
+struct FilterIndexContext
+{
+	Type::Ptr TargetType;
+	String VariableName;
+	Namespace::Ptr FilterVars;
+};
+
+/**
+ * Returns the ID of the navigation field which EvaluateFilter() exposes
+ * as the specified variable, or -1.
+ */
+static int GetNavigationField(const Type::Ptr& type, const String& variable)
+{
+	for (int fid = 0; fid < type->GetFieldCount(); fid++) {
+		Field field = type->GetFieldInfo(fid);
+
+		if ((field.Attributes & FANavigation) == 0)
+			continue;
+
+		if (variable == (field.NavigationName ? field.NavigationName : field.Name))
+			return fid;
+	}
+
+	return -1;
+}
+
+/**
+ * Returns whether the variable is overwritten by EvaluateFilter() for each object.
+ */
+static bool IsTargetVariable(const FilterIndexContext& ctx, const String& variable)
+{
+	return variable == "obj" || variable == ctx.VariableName || GetNavigationField(ctx.TargetType, variable) != -1;
+}
+
+/**
+ * Resolves a constant string, i.e. a literal or one of the 'filter_vars'.
+ */
+static bool GetIndexedValue(const FilterIndexContext& ctx, Expression *expr, String& value)
+{
+	auto *lexpr = dynamic_cast<LiteralExpression *>(expr);
+
+	if (lexpr) {
+		if (!lexpr->GetValue().IsString())
+			return false;
+
+		value = lexpr->GetValue();
+		return true;
+	}
+
+	auto *vexpr = dynamic_cast<VariableExpression *>(expr);
+
+	if (!vexpr || IsTargetVariable(ctx, vexpr->GetVariable()))
+		return false;
+
+	Value fvalue;
+
+	if (!ctx.FilterVars->Get(vexpr->GetVariable(), &fvalue) || !fvalue.IsString())
+		return false;
+
+	value = fvalue;
+	return true;
+}
+
+/**
+ * Resolves an attribute reference such as 'host.name'. The attribute either belongs to
+ * the filter's target object or, if navigationField isn't -1, to a joined object.
+ */
+static bool GetIndexedAttribute(const FilterIndexContext& ctx, Expression *expr, Type::Ptr& type, int& navigationField, int& fieldId)
+{
+	auto *iexpr = dynamic_cast<IndexerExpression *>(expr);
+
+	if (!iexpr)
+		return false;
+
+	auto *vexpr = dynamic_cast<VariableExpression *>(iexpr->GetOperand1());
+	auto *lexpr = dynamic_cast<LiteralExpression *>(iexpr->GetOperand2());
+
+	if (!vexpr || !lexpr || !lexpr->GetValue().IsString())
+		return false;
+
+	String variable = vexpr->GetVariable();
+
+	/* EvaluateFilter() sets the navigation fields last, they take precedence. */
+	navigationField = GetNavigationField(ctx.TargetType, variable);
+
+	if (navigationField != -1) {
+		Field field = ctx.TargetType->GetFieldInfo(navigationField);
+		type = Type::GetByName(field.RefTypeName ? field.RefTypeName : field.TypeName);
+
+		if (!type || !ConfigObject::TypeInstance->IsAssignableFrom(type))
+			return false;
+	} else if (variable == "obj" || variable == ctx.VariableName)
+		type = ctx.TargetType;
+	else
+		return false;
+
+	fieldId = type->GetFieldId(lexpr->GetValue());
+
+	return fieldId != -1;
+}
+
+static void AddInactiveObjects(const Type::Ptr& type, FilterCandidates& candidates)
+{
+	auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+	for (const ConfigObject::Ptr& object : ctype->GetInactiveObjects())
+		candidates.insert(object);
+}
+
+/**
+ * Adds the objects of the specified type which reference the object.
+ * References are tracked in the dependency graph while objects are active.
+ */
+static void AddReferrers(const Type::Ptr& type, const Object::Ptr& object, FilterCandidates& candidates)
+{
+	for (const Object::Ptr& referrer : DependencyGraph::GetParents(object)) {
+		if (type->IsAssignableFrom(referrer->GetReflectionType()))
+			candidates.insert(static_pointer_cast<ConfigObject>(referrer));
+	}
+}
+
+/**
+ * Looks up the objects whose attribute is equal to the value or, for 'in', whose
+ * attribute contains the value.
+ */
+static bool GetAttributeCandidates(const Type::Ptr& type, int fieldId, const String& value, bool contains, FilterCandidates& candidates)
+{
+	Field field = type->GetFieldInfo(fieldId);
+	String name = field.Name;
+
+	/* Short names are only unique for types which don't compose their names. */
+	if (!contains && (name == "__name" || (name == "name" && !dynamic_cast<NameComposer *>(type.get())))) {
+		ConfigObject::Ptr object = dynamic_cast<ConfigType *>(type.get())->GetObject(value);
+
+		if (object)
+			candidates.insert(object);
+
+		return true;
+	}
+
+	if (!field.RefTypeName || value.IsEmpty() || contains != (field.ArrayRank > 0))
+		return false;
+
+	ConfigObject::Ptr object = ConfigObject::GetObject(field.RefTypeName, value);
+
+	if (object)
+		AddReferrers(type, object, candidates);
+
+	AddInactiveObjects(type, candidates);
+
+	return true;
+}
+
+/**
+ * Evaluates match() against a string attribute without setting up a script frame for each object.
+ */
+static void GetMatchCandidates(const Type::Ptr& type, int fieldId, const String& pattern, FilterCandidates& candidates)
+{
+	auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+	for (const ConfigObject::Ptr& object : ctype->GetObjects()) {
+		if (Utility::Match(pattern, object->GetField(fieldId)))
+			candidates.insert(object);
+	}
+}
+
+/**
+ * Maps candidates for a joined object to the filter's target objects.
+ */
+static void GetTargetCandidates(const FilterIndexContext& ctx, int navigationField, FilterCandidates& candidates)
+{
+	if (navigationField == -1)
+		return;
+
+	FilterCandidates targets;
+
+	for (const ConfigObject::Ptr& object : candidates)
+		AddReferrers(ctx.TargetType, object, targets);
+
+	AddInactiveObjects(ctx.TargetType, targets);
+
+	candidates = std::move(targets);
+}
+
+/**
+ * Determines a superset of the objects which match the filter expression. Returns
+ * false if the expression cannot be answered from an index. Scans over the values of
+ * an attribute (for match()) are only used if allowScan is true.
+ */
+static bool GetFilterCandidates(const FilterIndexContext& ctx, Expression *expr, bool allowScan, FilterCandidates& candidates)
+{
+	if (auto *aexpr = dynamic_cast<LogicalAndExpression *>(expr)) {
+		FilterCandidates left, right;
+
+		/* Prefer lookups over scans, the whole filter is evaluated for the candidates anyway. */
+		bool haveLeft = GetFilterCandidates(ctx, aexpr->GetOperand1(), false, left);
+		bool haveRight = GetFilterCandidates(ctx, aexpr->GetOperand2(), false, right);
+
+		if (!haveLeft && !haveRight && allowScan) {
+			haveLeft = GetFilterCandidates(ctx, aexpr->GetOperand1(), true, left);
+
+			if (!haveLeft)
+				haveRight = GetFilterCandidates(ctx, aexpr->GetOperand2(), true, right);
+		}
+
+		if (haveLeft && haveRight)
+			std::set_intersection(left.begin(), left.end(), right.begin(), right.end(), std::inserter(candidates, candidates.end()));
+		else if (haveLeft)
+			candidates = std::move(left);
+		else if (haveRight)
+			candidates = std::move(right);
+
+		return haveLeft || haveRight;
+	}
+
+	if (auto *oexpr = dynamic_cast<LogicalOrExpression *>(expr)) {
+		FilterCandidates right;
+
+		if (!GetFilterCandidates(ctx, oexpr->GetOperand1(), allowScan, candidates))
+			return false;
+
+		if (!GetFilterCandidates(ctx, oexpr->GetOperand2(), allowScan, right))
+			return false;
+
+		candidates.insert(right.begin(), right.end());
+
+		return true;
+	}
+
+	Type::Ptr type;
+	int navigationField, fieldId;
+	String value;
+
+	if (auto *eexpr = dynamic_cast<EqualExpression *>(expr)) {
+		Expression *attr = eexpr->GetOperand1();
+		Expression *constant = eexpr->GetOperand2();
+
+		if (!GetIndexedAttribute(ctx, attr, type, navigationField, fieldId))
+			std::swap(attr, constant);
+
+		if (!GetIndexedAttribute(ctx, attr, type, navigationField, fieldId) || !GetIndexedValue(ctx, constant, value))
+			return false;
+
+		if (!GetAttributeCandidates(type, fieldId, value, false, candidates))
+			return false;
+
+		GetTargetCandidates(ctx, navigationField, candidates);
+
+		return true;
+	}
+
+	if (auto *iexpr = dynamic_cast<InExpression *>(expr)) {
+		if (!GetIndexedValue(ctx, iexpr->GetOperand1(), value) ||
+			!GetIndexedAttribute(ctx, iexpr->GetOperand2(), type, navigationField, fieldId))
+			return false;
+
+		if (!GetAttributeCandidates(type, fieldId, value, true, candidates))
+			return false;
+
+		GetTargetCandidates(ctx, navigationField, candidates);
+
+		return true;
+	}
+
+	if (auto *fexpr = dynamic_cast<FunctionCallExpression *>(expr)) {
+		if (!allowScan || fexpr->m_Args.size() != 2)
+			return false;
+
+		auto *vexpr = dynamic_cast<VariableExpression *>(fexpr->m_FName.get());
+
+		/* Make sure that 'match' refers to the global function. */
+		if (!vexpr || vexpr->GetVariable() != "match" || IsTargetVariable(ctx, "match") || ctx.FilterVars->Contains("match"))
+			return false;
+
+		if (!GetIndexedValue(ctx, fexpr->m_Args[0].get(), value) ||
+			!GetIndexedAttribute(ctx, fexpr->m_Args[1].get(), type, navigationField, fieldId))
+			return false;
+
+		Field field = type->GetFieldInfo(fieldId);
+
+		if (strcmp(field.TypeName, "String") != 0 || field.ArrayRank > 0)
+			return false;
+
+		GetMatchCandidates(type, fieldId, value, candidates);
+		GetTargetCandidates(ctx, navigationField, candidates);
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Uses the object indexes (names, references to other objects such as hosts, zones
+ * and groups) to find the objects which may match the filter. Returns false if the
+ * filter requires evaluating it for all objects of the type.
+ *
+ * The filter still has to be evaluated for each of the returned objects.
+ *
+ * @param type The object type.
+ * @param filter The compiled filter expression.
+ * @param filterVars Variables for the filter, i.e. 'filter_vars'.
+ * @param variableName The variable name for the target object.
+ * @param targets The candidate objects.
+ * @returns true if the candidates were determined using an index.
+ */
+bool FilterUtility::GetIndexedTargets(const Type::Ptr& type, Expression *filter, const Namespace::Ptr& filterVars,
+	const String& variableName, std::vector<ConfigObject::Ptr>& targets)
+{
+	auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+	if (!ctype)
+		return false;
+
+	/* ConfigCompiler::CompileText() returns an inline dictionary with the filter's statements. */
+	auto *dexpr = dynamic_cast<DictExpression *>(filter);
+
+	if (dexpr) {
+		if (!dexpr->IsInline() || dexpr->GetExpressions().size() != 1)
+			return false;
+
+		filter = dexpr->GetExpressions()[0].get();
+	}
+
+	FilterIndexContext ctx;
+	ctx.TargetType = type;
+	ctx.VariableName = variableName.IsEmpty() ? type->GetName().ToLower() : variableName;
+	ctx.FilterVars = filterVars ? filterVars : new Namespace();
+
+	FilterCandidates candidates;
+
+	if (!GetFilterCandidates(ctx, filter, true, candidates))
+		return false;
+
+	/* The candidate set is ordered by address. Return the objects in registration order
+	 * like FindTargets() does, otherwise paging through the results would not work. */
+	std::vector<ConfigObject::Ptr> objects = ctype->GetObjects(candidates);
+	targets.insert(targets.end(), objects.begin(), objects.end());
+
+	return true;
+}
+
 static void FilteredAddTarget(ScriptFrame& permissionFrame, Expression *permissionFilter,
 	ScriptFrame& frame, Expression *ufilter, std::vector<Value>& result, const String& variableName, const Object::Ptr& target)
 {
@@ -273,9 +621,21 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 
 			frame.Self = frameNS;
 
-			provider->FindTargets(type, std::bind(&FilteredAddTarget,
+			auto addTarget = std::bind(&FilteredAddTarget,
 				std::ref(permissionFrame), permissionFilter,
-				std::ref(frame), &*ufilter, std::ref(result), variableName, _1));
+				std::ref(frame), &*ufilter, std::ref(result), variableName, _1);
+
+			std::vector<ConfigObject::Ptr> targets;
+
+			if (dynamic_cast<ConfigObjectTargetProvider *>(provider.get()) &&
+				GetIndexedTargets(Type::GetByName(type), &*ufilter, frameNS, variableName, targets)) {
+				Log(LogDebug, "FilterUtility")
+					<< "Evaluating filter for " << targets.size() << " indexed objects of type '" << type << "'.";
+
+				for (const ConfigObject::Ptr& target : targets)
+					addTarget(target);
+			} else
+				provider->FindTargets(type, addTarget);
 		} else {
 			/* Ensure to pass a nullptr as filter expression.
 			 * GCC 8.1.1 on F28 causes problems, see GH #6533.
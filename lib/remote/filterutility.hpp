@@ -25,6 +25,7 @@
 #include "config/expression.hpp"
 #include "base/dictionary.hpp"
 #include "base/configobject.hpp"
+#include "base/namespace.hpp"
 #include <set>
 
 namespace icinga
@@ -73,6 +74,8 @@ public:
 		const ApiUser::Ptr& user, const String& variableName = String());
 	static bool EvaluateFilter(ScriptFrame& frame, Expression *filter,
 		const Object::Ptr& target, const String& variableName = String());
+	static bool GetIndexedTargets(const Type::Ptr& type, Expression *filter, const Namespace::Ptr& filterVars,
+		const String& variableName, std::vector<ConfigObject::Ptr>& targets);
 };
 
 }
@@ -26,7 +26,7 @@
 using namespace icinga;
 
 HttpResponse::HttpResponse(Stream::Ptr stream, const HttpRequest& request)
-	: Complete(false), m_State(HttpResponseStart), m_Request(&request), m_Stream(std::move(stream))
+	: Complete(false), m_State(HttpResponseStart), m_Aborted(false), m_Request(&request), m_Stream(std::move(stream))
 { }
 
 void HttpResponse::SetStatus(int code, const String& message)
@@ -90,8 +90,29 @@ void HttpResponse::WriteBody(const char *data, size_t count)
 	}
 }
 
+/**
+ * Waits until most of the body has been sent to the client, so that handlers
+ * which write large bodies piece by piece don't queue all of it in memory.
+ * HTTP/1.0 bodies are buffered until Finish() because of the Content-Length
+ * header.
+ *
+ * @param count The number of bytes which may still be queued.
+ * @param timeout How long to wait (in seconds) for the client to read more data.
+ * @returns false if the client disconnected or stopped reading.
+ */
+bool HttpResponse::WaitForSendQueue(size_t count, int timeout)
+{
+	if (m_Request->ProtocolVersion == HttpVersion10)
+		return true;
+
+	return m_Stream->WaitForSendQueue(count, timeout);
+}
+
 void HttpResponse::Finish()
 {
+	if (m_Aborted)
+		return;
+
 	ASSERT(m_State != HttpResponseEnd);
 
 	if (m_Request->ProtocolVersion == HttpVersion10) {
@@ -122,6 +143,19 @@ void HttpResponse::Finish()
 		m_Stream->Shutdown();
 }
 
+/**
+ * Closes the connection without completing the response. This is used when
+ * an error occurs after parts of the body have already been sent, the client
+ * then sees an incomplete response instead of a truncated but valid one.
+ */
+void HttpResponse::Abort()
+{
+	m_Aborted = true;
+	m_State = HttpResponseEnd;
+
+	m_Stream->Close();
+}
+
 bool HttpResponse::Parse(StreamReadContext& src, bool may_wait)
 {
 	if (m_State != HttpResponseBody) {
@@ -61,7 +61,9 @@ public:
 	void SetStatus(int code, const String& message);
 	void AddHeader(const String& key, const String& value);
 	void WriteBody(const char *data, size_t count);
+	bool WaitForSendQueue(size_t count, int timeout);
 	void Finish();
+	void Abort();
 
 	bool IsPeerConnected() const;
 
@@ -69,6 +71,7 @@ public:
 
 private:
 	HttpResponseState m_State;
+	bool m_Aborted;
 	std::shared_ptr<ChunkReadContext> m_ChunkContext;
 	const HttpRequest *m_Request;
 	Stream::Ptr m_Stream;
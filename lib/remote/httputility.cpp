@@ -23,6 +23,17 @@
 
 using namespace icinga;
 
+/* Encoded results are written to the response in chunks of this size. */
+static const size_t l_JsonResultsChunkSize = 64 * 1024;
+
+/* A slow client may leave at most this many bytes of a streamed response
+ * queued before more results are encoded.
+ */
+static const size_t l_JsonResultsMaxQueued = 1024 * 1024;
+
+/* Responses are aborted if the client doesn't read any data for this many seconds. */
+static const int l_JsonResultsSendTimeout = 60;
+
 Dictionary::Ptr HttpUtility::FetchRequestParameters(HttpRequest& request)
 {
 	Dictionary::Ptr result;
@@ -132,3 +143,82 @@ String HttpUtility::GetErrorNameByCode(const int code)
 	}
 }
 
+JsonResultsWriter::JsonResultsWriter(HttpResponse& response, const Dictionary::Ptr& params)
+	: m_Response(response), m_PrettyPrint(false)
+{
+	if (params)
+		m_PrettyPrint = HttpUtility::GetLastParameter(params, "pretty");
+
+	/* The output is the same as JsonEncode() produces for the whole object. */
+	if (m_PrettyPrint)
+		m_Buffer = "{\n    \"results\": [";
+	else
+		m_Buffer = "{\"results\":[";
+}
+
+bool JsonResultsWriter::IsStarted() const
+{
+	return m_Started;
+}
+
+/**
+ * Adds an element to the results array.
+ *
+ * @returns false if the client disconnected or stopped reading.
+ */
+bool JsonResultsWriter::Add(const Value& result)
+{
+	if (m_Count > 0)
+		m_Buffer += ",";
+
+	if (m_PrettyPrint)
+		m_Buffer += "\n        ";
+
+	JsonEncode(result, m_Buffer, m_PrettyPrint, 2);
+	m_Count++;
+
+	if (m_Buffer.GetLength() < l_JsonResultsChunkSize)
+		return true;
+
+	return Flush();
+}
+
+/**
+ * Closes the results array and writes what's left. HttpResponse::Finish()
+ * still has to be called afterwards.
+ *
+ * @returns false if the client disconnected or stopped reading.
+ */
+bool JsonResultsWriter::Finish()
+{
+	if (m_PrettyPrint) {
+		if (m_Count > 0)
+			m_Buffer += "\n    ";
+
+		m_Buffer += "]\n}\n";
+	} else
+		m_Buffer += "]}";
+
+	return Flush();
+}
+
+bool JsonResultsWriter::Flush()
+{
+	if (!m_Started) {
+		m_Response.SetStatus(200, "OK");
+		m_Response.AddHeader("Content-Type", "application/json");
+		m_Started = true;
+	}
+
+	m_Response.WriteBody(m_Buffer.CStr(), m_Buffer.GetLength());
+	m_Buffer.Clear();
+
+	if (!m_Response.WaitForSendQueue(l_JsonResultsMaxQueued, l_JsonResultsSendTimeout)) {
+		Log(LogWarning, "HttpUtility")
+			<< "Aborting response after " << m_Count << " results: The client disconnected or didn't read any data for "
+			<< l_JsonResultsSendTimeout << " seconds.";
+		return false;
+	}
+
+	return true;
+}
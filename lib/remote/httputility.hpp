@@ -47,6 +47,34 @@ private:
 
 };
 
+/**
+ * Sends a JSON object with a "results" array whose elements are encoded as
+ * they are added and written in chunks, instead of building the whole array
+ * in memory first. The response is only started with the first chunk, until
+ * then HttpUtility::SendJsonError() can still be used.
+ *
+ * @ingroup remote
+ */
+class JsonResultsWriter
+{
+public:
+	JsonResultsWriter(HttpResponse& response, const Dictionary::Ptr& params);
+
+	bool IsStarted() const;
+
+	bool Add(const Value& result);
+	bool Finish();
+
+private:
+	HttpResponse& m_Response;
+	bool m_PrettyPrint;
+	bool m_Started{false};
+	size_t m_Count{0};
+	String m_Buffer;
+
+	bool Flush();
+};
+
 }
 
 #endif /* HTTPUTILITY_H */
@@ -23,7 +23,9 @@
 #include "base/console.hpp"
 #include "base/scriptglobal.hpp"
 #include "base/convert.hpp"
+#include <algorithm>
 #include <iostream>
+#include <limits>
 
 using namespace icinga;
 
@@ -53,6 +55,64 @@ static bool GetDebugJsonRpcCached()
 }
 #endif /* I2_DEBUG */
 
+EncodedMessage::EncodedMessage(const Dictionary::Ptr& message)
+	: m_Timestamp(message->Get("ts")), m_Method(message->Get("method"))
+{
+	/* The length prefix is only known once the message has been encoded. Leave
+	 * room for the longest one in front of the JSON document and fill in the
+	 * actual prefix right before the document afterwards. */
+	const size_t maxPrefix = std::numeric_limits<size_t>::digits10 + 2;
+
+	m_Buffer = String(maxPrefix, ' ');
+	JsonEncode(message, m_Buffer);
+	m_Buffer += ",";
+
+	String prefix = Convert::ToString(m_Buffer.GetLength() - maxPrefix - 1) + ":";
+
+	m_JsonOffset = maxPrefix;
+	m_Offset = maxPrefix - prefix.GetLength();
+	std::copy(prefix.Begin(), prefix.End(), m_Buffer.GetData().begin() + m_Offset);
+}
+
+/**
+ * Returns the message's "ts" attribute.
+ */
+double EncodedMessage::GetTimestamp() const
+{
+	return m_Timestamp;
+}
+
+/**
+ * Returns the message's "method" attribute.
+ */
+const String& EncodedMessage::GetMethod() const
+{
+	return m_Method;
+}
+
+const char *EncodedMessage::GetJson() const
+{
+	return m_Buffer.CStr() + m_JsonOffset;
+}
+
+size_t EncodedMessage::GetJsonLength() const
+{
+	return m_Buffer.GetLength() - m_JsonOffset - 1;
+}
+
+/**
+ * Returns the NetString-framed message, ready to be written to a stream.
+ */
+const char *EncodedMessage::GetNetString() const
+{
+	return m_Buffer.CStr() + m_Offset;
+}
+
+size_t EncodedMessage::GetNetStringLength() const
+{
+	return m_Buffer.GetLength() - m_Offset;
+}
+
 /**
  * Sends a message to the connected peer and returns the bytes sent.
  *
@@ -72,6 +132,27 @@ size_t JsonRpc::SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& me
 	return NetString::WriteStringToStream(stream, json);
 }
 
+/**
+ * Sends a message which has already been encoded to the connected peer
+ * and returns the bytes sent.
+ *
+ * @param message The message.
+ *
+ * @return The amount of bytes sent.
+ */
+size_t JsonRpc::SendMessage(const Stream::Ptr& stream, const EncodedMessage::Ptr& message)
+{
+#ifdef I2_DEBUG
+	if (GetDebugJsonRpcCached())
+		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << ">> " << String(message->GetJson(), message->GetJson() + message->GetJsonLength())
+			<< ConsoleColorTag(Console_Normal) << "\n";
+#endif /* I2_DEBUG */
+
+	/* The message is immutable, streams which support it can send it without copying. */
+	stream->WriteShared(message, message->GetNetString(), message->GetNetStringLength());
+	return message->GetNetStringLength();
+}
+
 StreamReadStatus JsonRpc::ReadMessage(const Stream::Ptr& stream, String *message, StreamReadContext& src, bool may_wait, ssize_t maxMessageLength)
 {
 	String jsonString;
@@ -27,6 +27,42 @@
 namespace icinga
 {
 
+/**
+ * A JSON-RPC message which is encoded once and can then be sent to any
+ * number of connections and written to the replay log without having to
+ * be encoded again.
+ *
+ * Only the NetString-framed message is kept; the JSON document is the
+ * part of it between the length prefix and the trailing comma.
+ *
+ * @ingroup remote
+ */
+class EncodedMessage final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(EncodedMessage);
+
+	explicit EncodedMessage(const Dictionary::Ptr& message);
+
+	double GetTimestamp() const;
+	const String& GetMethod() const;
+
+	const char *GetJson() const;
+	size_t GetJsonLength() const;
+
+	const char *GetNetString() const;
+	size_t GetNetStringLength() const;
+
+private:
+	double m_Timestamp;
+	String m_Method;
+
+	/* The NetString starts at m_Offset; there's unused space for the length prefix before it. */
+	String m_Buffer;
+	size_t m_Offset;
+	size_t m_JsonOffset;
+};
+
 /**
  * A JSON-RPC connection.
  *
@@ -36,6 +72,7 @@ class JsonRpc
 {
 public:
 	static size_t SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message);
+	static size_t SendMessage(const Stream::Ptr& stream, const EncodedMessage::Ptr& message);
 	static StreamReadStatus ReadMessage(const Stream::Ptr& stream, String *message, StreamReadContext& src, bool may_wait = false, ssize_t maxMessageLength = -1);
 	static Dictionary::Ptr DecodeMessage(const String& message);
 
@@ -111,6 +111,11 @@ ConnectionRole JsonRpcConnection::GetRole() const
 }
 
 void JsonRpcConnection::SendMessage(const Dictionary::Ptr& message)
+{
+	SendMessage(new EncodedMessage(message));
+}
+
+void JsonRpcConnection::SendMessage(const EncodedMessage::Ptr& message)
 {
 	try {
 		ObjectLock olock(m_Stream);
@@ -23,18 +23,21 @@
 #include "base/serializer.hpp"
 #include "base/dependencygraph.hpp"
 #include "base/configtype.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
+#include <algorithm>
+#include <map>
 #include <set>
 
 using namespace icinga;
 
 REGISTER_URLHANDLER("/v1/objects", ObjectQueryHandler);
 
-Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& object,
+std::vector<int> ObjectQueryHandler::GetFieldIds(const Type::Ptr& type,
 	const String& attrPrefix, const Array::Ptr& attrs, bool isJoin, bool allAttrs)
 {
-	Type::Ptr type = object->GetReflectionType();
-
 	std::vector<int> fids;
 
 	if (isJoin && attrs) {
@@ -81,6 +84,13 @@ Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& obje
 		}
 	}
 
+	return fids;
+}
+
+Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& object, const std::vector<int>& fids)
+{
+	Type::Ptr type = object->GetReflectionType();
+
 	DictionaryData resultAttrs;
 	resultAttrs.reserve(fids.size());
 
@@ -159,6 +169,45 @@ bool ObjectQueryHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& re
 		params->Set(attr, request.RequestUrl->GetPath()[3]);
 	}
 
+	long offset = 0, limit = -1;
+
+	try {
+		Value voffset = HttpUtility::GetLastParameter(params, "offset");
+		Value vlimit = HttpUtility::GetLastParameter(params, "limit");
+
+		if (!voffset.IsEmpty())
+			offset = Convert::ToLong(voffset);
+
+		if (!vlimit.IsEmpty())
+			limit = Convert::ToLong(vlimit);
+
+		if (offset < 0 || (!vlimit.IsEmpty() && limit < 0))
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Values must not be negative."));
+	} catch (const std::exception& ex) {
+		HttpUtility::SendJsonError(response, params, 400,
+			"Invalid value for 'offset' or 'limit' specified.", DiagnosticInformation(ex));
+		return true;
+	}
+
+	if (umetas) {
+		ObjectLock olock(umetas);
+		for (const String& meta : umetas) {
+			if (meta != "used_by" && meta != "location") {
+				HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for meta: " + meta);
+				return true;
+			}
+		}
+	}
+
+	std::vector<int> fids;
+
+	try {
+		fids = GetFieldIds(type, String(), uattrs, false, false);
+	} catch (const ScriptError& ex) {
+		HttpUtility::SendJsonError(response, params, 400, ex.what());
+		return true;
+	}
+
 	std::vector<Value> objs;
 
 	try {
@@ -170,9 +219,6 @@ bool ObjectQueryHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& re
 		return true;
 	}
 
-	ArrayData results;
-	results.reserve(objs.size());
-
 	std::set<String> joinAttrs;
 	std::set<String> userJoinAttrs;
 
@@ -195,95 +241,129 @@ bool ObjectQueryHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& re
 		joinAttrs.insert(field.Name);
 	}
 
-	for (const ConfigObject::Ptr& obj : objs) {
-		DictionaryData result1{
-			{ "name", obj->GetName() },
-			{ "type", obj->GetReflectionType()->GetName() }
-		};
+	std::vector<int> joinFids;
 
-		DictionaryData metaAttrs;
+	for (const String& joinAttr : joinAttrs) {
+		int fid = type->GetFieldId(joinAttr);
 
-		if (umetas) {
-			ObjectLock olock(umetas);
-			for (const String& meta : umetas) {
-				if (meta == "used_by") {
-					Array::Ptr used_by = new Array();
-					metaAttrs.emplace_back("used_by", used_by);
+		if (fid < 0) {
+			HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for join: " + joinAttr);
+			return true;
+		}
+
+		Field field = type->GetFieldInfo(fid);
+
+		if (!(field.Attributes & FANavigation)) {
+			HttpUtility::SendJsonError(response, params, 400, "Not a joinable field: " + joinAttr);
+			return true;
+		}
 
-					for (const Object::Ptr& pobj : DependencyGraph::GetParents((obj)))
-					{
-						ConfigObject::Ptr configObj = dynamic_pointer_cast<ConfigObject>(pobj);
+		joinFids.push_back(fid);
+	}
+
+	/* The attributes of joined objects are looked up once per join and type. */
+	std::map<std::pair<int, Type *>, std::vector<int> > joinedFids;
+
+	size_t begin = std::min<size_t>(offset, objs.size());
+	size_t end = objs.size();
+
+	if (limit >= 0)
+		end = std::min<size_t>(end, begin + limit);
 
-						if (!configObj)
-							continue;
+	/* Results are encoded and sent one by one, responses for large object types
+	 * would otherwise have to be kept in memory as a whole several times. */
+	JsonResultsWriter results(response, params);
 
-						used_by->Add(new Dictionary({
-							{ "type", configObj->GetReflectionType()->GetName() },
-							{ "name", configObj->GetName() }
-						}));
+	size_t i = begin;
+
+	try {
+		for (i = begin; i < end; i++) {
+			ConfigObject::Ptr obj = objs[i];
+
+			DictionaryData result1{
+				{ "name", obj->GetName() },
+				{ "type", obj->GetReflectionType()->GetName() }
+			};
+
+			DictionaryData metaAttrs;
+
+			if (umetas) {
+				ObjectLock olock(umetas);
+				for (const String& meta : umetas) {
+					if (meta == "used_by") {
+						Array::Ptr used_by = new Array();
+						metaAttrs.emplace_back("used_by", used_by);
+
+						for (const Object::Ptr& pobj : DependencyGraph::GetParents((obj)))
+						{
+							ConfigObject::Ptr configObj = dynamic_pointer_cast<ConfigObject>(pobj);
+
+							if (!configObj)
+								continue;
+
+							used_by->Add(new Dictionary({
+								{ "type", configObj->GetReflectionType()->GetName() },
+								{ "name", configObj->GetName() }
+							}));
+						}
+					} else if (meta == "location") {
+						metaAttrs.emplace_back("location", obj->GetSourceLocation());
 					}
-				} else if (meta == "location") {
-					metaAttrs.emplace_back("location", obj->GetSourceLocation());
-				} else {
-					HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for meta: " + meta);
-					return true;
 				}
 			}
-		}
 
-		result1.emplace_back("meta", new Dictionary(std::move(metaAttrs)));
+			result1.emplace_back("meta", new Dictionary(std::move(metaAttrs)));
+			result1.emplace_back("attrs", SerializeObjectAttrs(obj, fids));
 
-		try {
-			result1.emplace_back("attrs", SerializeObjectAttrs(obj, String(), uattrs, false, false));
-		} catch (const ScriptError& ex) {
-			HttpUtility::SendJsonError(response, params, 400, ex.what());
-			return true;
-		}
+			DictionaryData joins;
 
-		DictionaryData joins;
+			for (int fid : joinFids) {
+				Object::Ptr joinedObj = obj->NavigateField(fid);
 
-		for (const String& joinAttr : joinAttrs) {
-			Object::Ptr joinedObj;
-			int fid = type->GetFieldId(joinAttr);
+				if (!joinedObj)
+					continue;
 
-			if (fid < 0) {
-				HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for join: " + joinAttr);
-				return true;
-			}
+				String prefix = type->GetFieldInfo(fid).NavigationName;
 
-			Field field = type->GetFieldInfo(fid);
+				auto key = std::make_pair(fid, joinedObj->GetReflectionType().get());
+				auto it = joinedFids.find(key);
 
-			if (!(field.Attributes & FANavigation)) {
-				HttpUtility::SendJsonError(response, params, 400, "Not a joinable field: " + joinAttr);
-				return true;
-			}
+				if (it == joinedFids.end()) {
+					try {
+						it = joinedFids.emplace(key, GetFieldIds(key.second, prefix, ujoins, true, allJoins)).first;
+					} catch (const ScriptError& ex) {
+						if (results.IsStarted())
+							throw;
 
-			joinedObj = obj->NavigateField(fid);
+						HttpUtility::SendJsonError(response, params, 400, ex.what());
+						return true;
+					}
+				}
 
-			if (!joinedObj)
-				continue;
+				joins.emplace_back(prefix, SerializeObjectAttrs(joinedObj, it->second));
+			}
 
-			String prefix = field.NavigationName;
+			result1.emplace_back("joins", new Dictionary(std::move(joins)));
 
-			try {
-				joins.emplace_back(prefix, SerializeObjectAttrs(joinedObj, prefix, ujoins, true, allJoins));
-			} catch (const ScriptError& ex) {
-				HttpUtility::SendJsonError(response, params, 400, ex.what());
+			if (!results.Add(new Dictionary(std::move(result1)))) {
+				response.Abort();
 				return true;
 			}
 		}
 
-		result1.emplace_back("joins", new Dictionary(std::move(joins)));
-
-		results.push_back(new Dictionary(std::move(result1)));
-	}
+		if (!results.Finish())
+			response.Abort();
+	} catch (const std::exception& ex) {
+		/* Once the first results are out the status can't be changed anymore, the client
+		 * has to notice the truncated response. Otherwise the default error response is sent. */
+		if (!results.IsStarted())
+			throw;
 
-	Dictionary::Ptr result = new Dictionary({
-		{ "results", new Array(std::move(results)) }
-	});
+		Log(LogWarning, "ObjectQueryHandler")
+			<< "Aborting response after " << (i - begin) << " objects: " << DiagnosticInformation(ex, false);
 
-	response.SetStatus(200, "OK");
-	HttpUtility::SendJsonBody(response, params, result);
+		response.Abort();
+	}
 
 	return true;
 }
@@ -34,8 +34,9 @@ public:
 		HttpResponse& response, const Dictionary::Ptr& params) override;
 
 private:
-	static Dictionary::Ptr SerializeObjectAttrs(const Object::Ptr& object, const String& attrPrefix,
+	static std::vector<int> GetFieldIds(const Type::Ptr& type, const String& attrPrefix,
 		const Array::Ptr& attrs, bool isJoin, bool allAttrs);
+	static Dictionary::Ptr SerializeObjectAttrs(const Object::Ptr& object, const std::vector<int>& fids);
 };
 
 }
@@ -0,0 +1,352 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/replaylog.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace icinga;
+
+static const char l_ReplayLogFileMagic[8] = { 'I', '2', 'R', 'L', 'O', 'G', '0', '1' };
+
+enum ReplayLogBlockMagic : uint32_t
+{
+	ReplayLogRecordMagic = 0x52523249, /* "I2RR" */
+	ReplayLogIndexMagic = 0x49523249, /* "I2RI" */
+	ReplayLogFooterMagic = 0x46523249 /* "I2RF" */
+};
+
+/**
+ * The index is written after the last record when the file is closed:
+ * the magic, the number of entries and the entries themselves, followed
+ * by a footer which points back to the start of the index.
+ */
+struct ReplayLogIndexHeader
+{
+	uint32_t Magic;
+	uint32_t Count;
+};
+
+struct ReplayLogIndexEntry
+{
+	double Timestamp;
+	uint64_t Offset;
+};
+
+struct ReplayLogFooter
+{
+	uint64_t IndexOffset;
+	uint32_t Magic;
+	uint32_t Reserved;
+};
+
+/* Upper bounds for the lengths in a record header; anything larger is from a corrupt record. */
+static const uint32_t l_ReplayLogMaxSecobjLength = 1024 * 1024;
+static const uint32_t l_ReplayLogMaxMessageLength = 512 * 1024 * 1024;
+
+ReplayLogWriter::ReplayLogWriter(const String& path)
+	: m_Stream(path.CStr(), std::ofstream::out | std::ofstream::app | std::ofstream::binary)
+{
+	if (!m_Stream.good())
+		return;
+
+	m_Stream.seekp(0, std::ofstream::end);
+	m_Offset = m_Stream.tellp();
+
+	if (m_Offset == 0) {
+		m_Stream.write(l_ReplayLogFileMagic, sizeof(l_ReplayLogFileMagic));
+		m_Offset = sizeof(l_ReplayLogFileMagic);
+	}
+}
+
+bool ReplayLogWriter::IsGood() const
+{
+	return m_Stream.good();
+}
+
+size_t ReplayLogWriter::GetMessageCount() const
+{
+	return m_MessageCount;
+}
+
+void ReplayLogWriter::Write(double ts, const String& secobjType, const String& secobjName, const String& message)
+{
+	Write(ts, secobjType, secobjName, message.CStr(), message.GetLength());
+}
+
+void ReplayLogWriter::Write(double ts, const String& secobjType, const String& secobjName, const char *message, size_t length)
+{
+	String secobj;
+
+	if (!secobjType.IsEmpty()) {
+		secobj = secobjType;
+		secobj += '\0';
+		secobj += secobjName;
+	}
+
+	/* Index the first message of each second. */
+	if (m_Index.empty() || static_cast<long>(ts) > static_cast<long>(m_Index.back().first))
+		m_Index.emplace_back(ts, m_Offset);
+
+	ReplayLogRecordHeader header;
+	header.Magic = ReplayLogRecordMagic;
+	header.SecobjLength = secobj.GetLength();
+	header.MessageLength = length;
+	header.Reserved = 0;
+	header.Timestamp = ts;
+
+	m_Stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	m_Stream.write(secobj.CStr(), secobj.GetLength());
+	m_Stream.write(message, length);
+
+	m_Offset += sizeof(header) + secobj.GetLength() + length;
+	m_MessageCount++;
+}
+
+/**
+ * Flushes all messages which were written since the last call to Flush().
+ * Callers which write several messages at once only need to flush once.
+ */
+void ReplayLogWriter::Flush()
+{
+	m_Stream.flush();
+}
+
+void ReplayLogWriter::Close()
+{
+	if (!m_Stream.is_open())
+		return;
+
+	ReplayLogIndexHeader header;
+	header.Magic = ReplayLogIndexMagic;
+	header.Count = m_Index.size();
+
+	m_Stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+	for (const auto& kv : m_Index) {
+		ReplayLogIndexEntry entry;
+		entry.Timestamp = kv.first;
+		entry.Offset = kv.second;
+
+		m_Stream.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+	}
+
+	ReplayLogFooter footer;
+	footer.IndexOffset = m_Offset;
+	footer.Magic = ReplayLogFooterMagic;
+	footer.Reserved = 0;
+
+	m_Stream.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+
+	m_Stream.close();
+}
+
+ReplayLogReader::ReplayLogReader(const String& path)
+	: m_Stream(path.CStr(), std::ifstream::in | std::ifstream::binary)
+{
+	char magic[sizeof(l_ReplayLogFileMagic)];
+
+	if (!m_Stream.read(magic, sizeof(magic)) || memcmp(magic, l_ReplayLogFileMagic, sizeof(magic)) != 0)
+		return;
+
+	if (!m_Stream.seekg(0, std::ifstream::end))
+		return;
+
+	m_FileSize = m_Stream.tellg();
+	m_Good = true;
+	m_NextOffset = sizeof(magic);
+}
+
+/**
+ * Returns whether the file was opened and is in the replay log format.
+ * Log files which were written by older versions are NetString-encoded
+ * and have to be read with NetString::ReadStringFromStream() instead.
+ */
+bool ReplayLogReader::IsGood() const
+{
+	return m_Good;
+}
+
+bool ReplayLogReader::ReadIndex(std::vector<std::pair<double, uint64_t> >& index)
+{
+	m_Stream.clear();
+
+	if (!m_Stream.seekg(0, std::ifstream::end))
+		return false;
+
+	uint64_t size = m_Stream.tellg();
+
+	if (size < sizeof(l_ReplayLogFileMagic) + sizeof(ReplayLogIndexHeader) + sizeof(ReplayLogFooter))
+		return false;
+
+	ReplayLogFooter footer;
+
+	if (!m_Stream.seekg(size - sizeof(footer)) || !m_Stream.read(reinterpret_cast<char *>(&footer), sizeof(footer)))
+		return false;
+
+	if (footer.Magic != ReplayLogFooterMagic || footer.IndexOffset >= size)
+		return false;
+
+	ReplayLogIndexHeader header;
+
+	if (!m_Stream.seekg(footer.IndexOffset) || !m_Stream.read(reinterpret_cast<char *>(&header), sizeof(header)))
+		return false;
+
+	/* The footer must directly follow the index, otherwise more records were appended after it. */
+	if (header.Magic != ReplayLogIndexMagic || footer.IndexOffset + sizeof(header) + header.Count * sizeof(ReplayLogIndexEntry) + sizeof(footer) != size)
+		return false;
+
+	index.reserve(header.Count);
+
+	for (uint32_t i = 0; i < header.Count; i++) {
+		ReplayLogIndexEntry entry;
+
+		if (!m_Stream.read(reinterpret_cast<char *>(&entry), sizeof(entry)))
+			return false;
+
+		index.emplace_back(entry.Timestamp, entry.Offset);
+	}
+
+	return true;
+}
+
+/**
+ * Skips ahead to the first indexed record which might be newer than the
+ * specified timestamp. Messages which are not newer than the timestamp may
+ * still be returned by Next() and have to be filtered by the caller.
+ *
+ * @param ts The timestamp.
+ */
+void ReplayLogReader::SeekToTimestamp(double ts)
+{
+	std::vector<std::pair<double, uint64_t> > index;
+
+	if (ReadIndex(index)) {
+		/* Timestamps are only mostly monotonic, allow for a bit of slack. */
+		auto it = std::lower_bound(index.begin(), index.end(), ts - 1, [](const std::pair<double, uint64_t>& entry, double value) {
+			return entry.first < value;
+		});
+
+		if (it != index.begin())
+			m_NextOffset = std::max(m_NextOffset, (it - 1)->second);
+	}
+
+	m_Stream.clear();
+	m_MessagePending = false;
+}
+
+/**
+ * Reads the next record's header. The message itself is skipped unless
+ * ReadMessage() is called before the next call to Next().
+ *
+ * @param ts The message's timestamp.
+ * @param secobjType The type of the security object (empty if there is none).
+ * @param secobjName The name of the security object.
+ * @returns false if there are no more records.
+ */
+bool ReplayLogReader::Next(double *ts, String *secobjType, String *secobjName)
+{
+	if (!m_Good)
+		return false;
+
+	for (;;) {
+		if (!m_Stream.seekg(m_NextOffset))
+			return false;
+
+		uint32_t magic;
+
+		if (!m_Stream.read(reinterpret_cast<char *>(&magic), sizeof(magic)))
+			return false;
+
+		if (magic == ReplayLogIndexMagic) {
+			/* More records were appended after the file was closed once, skip the old index. */
+			uint32_t count;
+
+			if (!m_Stream.read(reinterpret_cast<char *>(&count), sizeof(count)))
+				return false;
+
+			m_NextOffset += sizeof(ReplayLogIndexHeader) + count * sizeof(ReplayLogIndexEntry) + sizeof(ReplayLogFooter);
+			continue;
+		}
+
+		/* Anything else is a partially written record. */
+		if (magic != ReplayLogRecordMagic)
+			return false;
+
+		ReplayLogRecordHeader header;
+
+		if (!m_Stream.seekg(m_NextOffset) || !m_Stream.read(reinterpret_cast<char *>(&header), sizeof(header)))
+			return false;
+
+		/* Don't trust the lengths before allocating buffers for them: a record which
+		 * doesn't fit into the file is treated as the end of the log. */
+		if (header.SecobjLength > l_ReplayLogMaxSecobjLength || header.MessageLength > l_ReplayLogMaxMessageLength ||
+			m_NextOffset + sizeof(header) + header.SecobjLength + header.MessageLength > m_FileSize)
+			return false;
+
+		String secobj;
+
+		if (header.SecobjLength > 0) {
+			std::vector<char> buf(header.SecobjLength);
+
+			if (!m_Stream.read(buf.data(), buf.size()))
+				return false;
+
+			secobj = String(buf.begin(), buf.end());
+		}
+
+		size_t pos = secobj.GetData().find('\0');
+
+		if (pos != std::string::npos) {
+			*secobjType = secobj.SubStr(0, pos);
+			*secobjName = secobj.SubStr(pos + 1);
+		} else {
+			*secobjType = String();
+			*secobjName = String();
+		}
+
+		*ts = header.Timestamp;
+
+		m_NextOffset += sizeof(header) + header.SecobjLength + header.MessageLength;
+		m_MessageLength = header.MessageLength;
+		m_MessagePending = true;
+
+		return true;
+	}
+}
+
+/**
+ * Reads the message of the record which was returned by the last call to Next().
+ *
+ * @returns The JSON-encoded message or an empty string if the record is incomplete.
+ */
+String ReplayLogReader::ReadMessage()
+{
+	if (!m_MessagePending)
+		return String();
+
+	m_MessagePending = false;
+
+	std::vector<char> buf(m_MessageLength);
+
+	if (m_MessageLength > 0 && !m_Stream.read(buf.data(), buf.size()))
+		return String();
+
+	return String(buf.begin(), buf.end());
+}
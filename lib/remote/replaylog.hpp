@@ -0,0 +1,118 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef REPLAYLOG_H
+#define REPLAYLOG_H
+
+#include "remote/i2-remote.hpp"
+#include "remote/jsonrpc.hpp"
+#include "base/string.hpp"
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * The fixed-size header which precedes each message in a replay log file.
+ * It is followed by SecobjLength bytes for the security object
+ * ("<type>\0<name>") and MessageLength bytes for the JSON-encoded message.
+ *
+ * @ingroup remote
+ */
+struct ReplayLogRecordHeader
+{
+	uint32_t Magic;
+	uint32_t SecobjLength;
+	uint32_t MessageLength;
+	uint32_t Reserved;
+	double Timestamp;
+};
+
+/**
+ * A message which is waiting to be written to the replay log.
+ *
+ * @ingroup remote
+ */
+struct ReplayLogEntry
+{
+	double Timestamp;
+	String SecobjType;
+	String SecobjName;
+	EncodedMessage::Ptr Message;
+};
+
+/**
+ * Appends messages to a replay log file. When the file is closed an index
+ * which maps timestamps to file offsets is written to the end of the file.
+ *
+ * @ingroup remote
+ */
+class ReplayLogWriter
+{
+public:
+	explicit ReplayLogWriter(const String& path);
+
+	bool IsGood() const;
+	size_t GetMessageCount() const;
+
+	void Write(double ts, const String& secobjType, const String& secobjName, const String& message);
+	void Write(double ts, const String& secobjType, const String& secobjName, const char *message, size_t length);
+	void Flush();
+	void Close();
+
+private:
+	std::ofstream m_Stream;
+	uint64_t m_Offset{0};
+	size_t m_MessageCount{0};
+	std::vector<std::pair<double, uint64_t> > m_Index;
+};
+
+/**
+ * Reads messages from a replay log file. Only the record headers are parsed
+ * unless the caller asks for the message itself.
+ *
+ * @ingroup remote
+ */
+class ReplayLogReader
+{
+public:
+	explicit ReplayLogReader(const String& path);
+
+	bool IsGood() const;
+
+	void SeekToTimestamp(double ts);
+	bool Next(double *ts, String *secobjType, String *secobjName);
+	String ReadMessage();
+
+private:
+	std::ifstream m_Stream;
+	bool m_Good{false};
+	uint64_t m_FileSize{0};
+	uint64_t m_NextOffset{0};
+	uint32_t m_MessageLength{0};
+	bool m_MessagePending{false};
+
+	bool ReadIndex(std::vector<std::pair<double, uint64_t> >& index);
+};
+
+}
+
+#endif /* REPLAYLOG_H */
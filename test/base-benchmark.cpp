@@ -0,0 +1,252 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/dictionary.hpp"
+#include "base/objectlock.hpp"
+#include "base/json.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif /* __GLIBC__ */
+
+using namespace icinga;
+
+/* Timings for the base library. These are not part of the unit tests, build them
+ * with 'make benchmark' and compare the numbers before and after a change. */
+
+static void Measure(const String& name, int rounds, const std::function<void ()>& callback)
+{
+	double start = Utility::GetTime();
+
+	for (int i = 0; i < rounds; i++)
+		callback();
+
+	double duration = Utility::GetTime() - start;
+
+	std::cout << std::left << std::setw(48) << name << std::right << std::setw(12) << std::fixed << std::setprecision(3)
+		<< duration * 1e6 / rounds << " us/op" << std::endl;
+}
+
+static void BenchmarkDictionary()
+{
+	std::vector<String> keys = { "type", "host", "service", "state", "state_type", "output", "performance_data",
+		"schedule_start", "schedule_end", "execution_start", "execution_end", "exit_status", "vars_before", "vars_after" };
+
+	Measure("Dictionary: Set() 14 keys", 100000, [&keys]() {
+		Dictionary::Ptr dictionary = new Dictionary();
+
+		for (const String& key : keys)
+			dictionary->Set(key, 1);
+	});
+
+	Dictionary::Ptr small = new Dictionary();
+
+	for (const String& key : keys)
+		small->Set(key, 1);
+
+	Measure("Dictionary: Get() 14 keys", 100000, [&keys, &small]() {
+		for (const String& key : keys)
+			(void)small->Get(key);
+	});
+
+	Measure("Dictionary: iterate 14 keys", 100000, [&small]() {
+		ObjectLock olock(small);
+		double sum = 0;
+
+		for (const Dictionary::Pair& kv : small)
+			sum += static_cast<double>(kv.second);
+	});
+
+	/* Keys in random order, e.g. from a directory listing. */
+	std::vector<String> manyKeys;
+
+	for (int i = 0; i < 10000; i++)
+		manyKeys.push_back("zones.d/zone-" + Convert::ToString(i % 100) + "/hosts-" + Convert::ToString(i) + ".conf");
+
+	std::shuffle(manyKeys.begin(), manyKeys.end(), std::mt19937(1));
+
+	Measure("Dictionary: Set() 10k unsorted keys", 10, [&manyKeys]() {
+		Dictionary::Ptr dictionary = new Dictionary();
+
+		for (const String& key : manyKeys)
+			dictionary->Set(key, 1);
+	});
+
+	Measure("Dictionary: DictionaryData 10k unsorted keys", 10, [&manyKeys]() {
+		DictionaryData data;
+
+		for (const String& key : manyKeys)
+			data.emplace_back(key, 1);
+
+		Dictionary::Ptr dictionary = new Dictionary(std::move(data));
+	});
+
+	String message = "{\"jsonrpc\":\"2.0\",\"method\":\"event::CheckResult\",\"params\":{\"host\":\"web-server-01.example.com\","
+		"\"service\":\"disk\",\"cr\":{\"active\":true,\"check_source\":\"satellite-01\",\"command\":[\"/usr/lib/nagios/plugins/check_disk\","
+		"\"-w\",\"20%\",\"-c\",\"10%\"],\"execution_end\":1541072512.7,\"execution_start\":1541072512.6,\"exit_status\":0.0,"
+		"\"output\":\"DISK OK\",\"performance_data\":[\"/=2643MB;5948;6687;0;7434\"],\"schedule_end\":1541072512.7,"
+		"\"schedule_start\":1541072512.5,\"state\":0.0,\"ttl\":0.0,\"type\":\"CheckResult\",\"vars_after\":{\"attempt\":1.0,"
+		"\"reachable\":true,\"state\":0.0,\"state_type\":1.0},\"vars_before\":{\"attempt\":1.0,\"reachable\":true,"
+		"\"state\":0.0,\"state_type\":1.0}}},\"ts\":1541072512.7}";
+
+	Measure("Dictionary: JsonDecode() event::CheckResult", 10000, [&message]() {
+		Dictionary::Ptr dmessage = JsonDecode(message);
+	});
+}
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+static size_t GetHeapInUse()
+{
+	struct mallinfo2 mi = mallinfo2();
+	return mi.uordblks + mi.hblkhd;
+}
+
+/* Heap used by the Values which stay alive after loading 100k hosts with 10 services each: the literals
+ * of each host's object declaration, its vars as in conf.d/hosts.conf and the services' vars, which are
+ * copies of their apply rule's literals. */
+static void BenchmarkValueMemory()
+{
+	size_t start = GetHeapInUse();
+
+	std::vector<Value> literals;
+	std::vector<Dictionary::Ptr> vars;
+
+	Value ruleUri = "/", ruleWarn = "20%", ruleCrit = "10%", ruleCommand = "http", ruleGroup = "web-services";
+	Value ruleDisplayName = "HTTP check for the default vhost";
+
+	for (int i = 0; i < 100000; i++) {
+		for (Value value : { Value("web-server-" + Convert::ToString(i) + ".example.com"), Value("generic-host"),
+			Value("10.0." + Convert::ToString(i % 250) + "." + Convert::ToString(i % 200)), Value("::1"), Value("Linux"),
+			Value("http"), Value("/"), Value("disk"), Value("disk /"), Value("/"), Value("mail"), Value("icingaadmins"),
+			Value(60), Value(30), Value(true) })
+			literals.emplace_back(std::move(value));
+
+		vars.emplace_back(new Dictionary({
+			{ "os", "Linux" },
+			{ "http_vhosts", new Dictionary({ { "http", new Dictionary({ { "http_uri", "/" } }) } }) },
+			{ "disks", new Dictionary({ { "disk", new Dictionary() }, { "disk /", new Dictionary({ { "disk_partitions", "/" } }) } }) },
+			{ "notification", new Dictionary({ { "mail", new Dictionary({ { "groups", new Array({ "icingaadmins" }) } }) } }) }
+		}));
+
+		for (int s = 0; s < 10; s++) {
+			vars.emplace_back(new Dictionary({
+				{ "http_uri", ruleUri },
+				{ "http_warn", ruleWarn },
+				{ "http_crit", ruleCrit },
+				{ "check_command", ruleCommand },
+				{ "groups", new Array({ ruleGroup }) },
+				{ "display_name", ruleDisplayName },
+				{ "port", 80 + s }
+			}));
+		}
+	}
+
+	std::cout << std::left << std::setw(48) << "Value: 100k hosts, 1M services" << std::right << std::setw(12)
+		<< std::fixed << std::setprecision(1) << (GetHeapInUse() - start) / 1048576.0 << " MB" << std::endl;
+}
+#endif /* __GLIBC__ */
+
+/* Messages modelled on the cluster events in lib/icinga/clusterevents.cpp, used when no captured traffic is available. */
+static std::vector<String> MakeClusterMessages(int count)
+{
+	std::vector<String> messages;
+
+	for (int i = 0; i < count; i++) {
+		String host = "web-server-" + Convert::ToString(i % 5000) + ".example.com";
+		String ts = Convert::ToString(1541072512 + i) + ".7" + Convert::ToString(i % 10);
+		int kind = i % 20;
+
+		if (kind < 12) {
+			messages.push_back("{\"jsonrpc\":\"2.0\",\"method\":\"event::CheckResult\",\"params\":{\"host\":\"" + host + "\","
+				"\"service\":\"disk-" + Convert::ToString(i % 7) + "\",\"cr\":{\"active\":true,\"check_source\":\"satellite-01\","
+				"\"command\":[\"/usr/lib/nagios/plugins/check_disk\",\"-w\",\"20%\",\"-c\",\"10%\",\"-p\",\"/var\"],"
+				"\"execution_end\":" + ts + ",\"execution_start\":" + ts + ",\"exit_status\":0.0,"
+				"\"output\":\"DISK OK - free space: /var " + Convert::ToString(i % 9000) + " MB (" + Convert::ToString(i % 100) + "% inode=97%):\","
+				"\"performance_data\":[\"/var=2643MB;5948;6687;0;7434\",\"/var/log=121MB;1000;1200;0;2000\"],"
+				"\"schedule_end\":" + ts + ",\"schedule_start\":" + ts + ",\"state\":0.0,\"ttl\":0.0,\"type\":\"CheckResult\","
+				"\"vars_after\":{\"attempt\":1.0,\"reachable\":true,\"state\":0.0,\"state_type\":1.0},"
+				"\"vars_before\":{\"attempt\":1.0,\"reachable\":true,\"state\":0.0,\"state_type\":1.0}}},\"ts\":" + ts + "}");
+		} else if (kind < 16) {
+			messages.push_back("{\"jsonrpc\":\"2.0\",\"method\":\"event::SetNextCheck\",\"params\":{\"host\":\"" + host + "\","
+				"\"next_check\":" + ts + ",\"service\":\"ping4\"},\"ts\":" + ts + "}");
+		} else if (kind < 18) {
+			messages.push_back("{\"jsonrpc\":\"2.0\",\"method\":\"event::Heartbeat\",\"params\":{\"timeout\":120.0}}");
+		} else if (kind < 19) {
+			messages.push_back("{\"jsonrpc\":\"2.0\",\"method\":\"log::SetLogPosition\",\"params\":{\"log_position\":" + ts + "}}");
+		} else {
+			messages.push_back("{\"jsonrpc\":\"2.0\",\"method\":\"config::UpdateObject\",\"params\":{\"config\":\"object Host \\\"" + host
+				+ "\\\" {\\n\\timport \\\"generic-host\\\"\\n\\taddress = \\\"10.0." + Convert::ToString(i % 250) + ".1\\\"\\n"
+				"\\tvars.os = \\\"Linux\\\"\\n}\\n\",\"modified_attributes\":{},\"name\":\"" + host + "\","
+				"\"original_attributes\":[],\"type\":\"Host\",\"version\":" + ts + ",\"zone\":\"master\"},\"ts\":" + ts + "}");
+		}
+	}
+
+	return messages;
+}
+
+/**
+ * Decodes cluster messages, one JSON document per line of the specified file
+ * or generated ones if no file was specified.
+ */
+static void BenchmarkJson(const char *path)
+{
+	std::vector<String> messages;
+
+	if (path) {
+		std::ifstream fp(path);
+		std::string line;
+
+		while (std::getline(fp, line)) {
+			if (!line.empty())
+				messages.emplace_back(std::move(line));
+		}
+	} else
+		messages = MakeClusterMessages(100000);
+
+	size_t bytes = 0;
+
+	for (const String& message : messages)
+		bytes += message.GetLength();
+
+	std::cout << "JSON: " << messages.size() << " cluster messages, " << bytes << " bytes" << std::endl;
+
+	Measure("JSON: JsonDecode() all messages", 5, [&messages]() {
+		for (const String& message : messages)
+			(void)JsonDecode(message);
+	});
+}
+
+int main(int argc, char **argv)
+{
+	BenchmarkDictionary();
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	BenchmarkValueMemory();
+#endif /* __GLIBC__ */
+	BenchmarkJson(argc > 1 ? argv[1] : nullptr);
+
+	return 0;
+}
@@ -20,7 +20,9 @@
 #include "base/dictionary.hpp"
 #include "base/objectlock.hpp"
 #include "base/json.hpp"
+#include "base/convert.hpp"
 #include <BoostTestTargetConfig.h>
+#include <algorithm>
 
 using namespace icinga;
 
@@ -200,4 +202,64 @@ BOOST_AUTO_TEST_CASE(json)
 	BOOST_CHECK(deserialized->Get("test2") == "hello world");
 }
 
+BOOST_AUTO_TEST_CASE(order)
+{
+	Dictionary::Ptr dictionary = new Dictionary({
+		{ "c", 1 },
+		{ "a", 2 },
+		{ "b", 3 },
+		{ "a", 4 }
+	});
+
+	/* The first of several identical keys wins. */
+	BOOST_CHECK(dictionary->GetLength() == 3);
+	BOOST_CHECK(dictionary->Get("a") == 2);
+
+	dictionary->Set("0", 5);
+	dictionary->Set("d", 6);
+	dictionary->Set("b", 7);
+
+	std::vector<String> keys = dictionary->GetKeys();
+	BOOST_CHECK(keys == std::vector<String>({ "0", "a", "b", "c", "d" }));
+	BOOST_CHECK(dictionary->Get("b") == 7);
+}
+
+BOOST_AUTO_TEST_CASE(large)
+{
+	const int count = 1000;
+
+	Dictionary::Ptr dictionary = new Dictionary();
+
+	/* Neither ascending nor descending, most keys have to be inserted in the middle. */
+	for (int i = 0; i < count; i++)
+		dictionary->Set("key" + Convert::ToString((i * 7919) % count), i);
+
+	BOOST_CHECK(dictionary->GetLength() == count);
+
+	std::vector<String> keys = dictionary->GetKeys();
+	BOOST_CHECK(std::is_sorted(keys.begin(), keys.end()));
+
+	for (int i = 0; i < count; i++)
+		BOOST_CHECK(dictionary->Get("key" + Convert::ToString((i * 7919) % count)) == i);
+
+	DictionaryData data;
+
+	for (int i = count - 1; i >= 0; i--)
+		data.emplace_back("key" + Convert::ToString(i), i);
+
+	Dictionary::Ptr bulk = new Dictionary(std::move(data));
+	BOOST_CHECK(bulk->GetKeys() == keys);
+
+	double sum = 0;
+
+	{
+		ObjectLock olock(bulk);
+
+		for (const Dictionary::Pair& kv : bulk)
+			sum += static_cast<double>(kv.second);
+	}
+
+	BOOST_CHECK(sum == count * (count - 1) / 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -18,19 +18,98 @@
  ******************************************************************************/
 
 #include "base/dictionary.hpp"
+#include "base/array.hpp"
 #include "base/objectlock.hpp"
 #include "base/json.hpp"
+#include "base/convert.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
 
 BOOST_AUTO_TEST_SUITE(base_json)
 
+BOOST_AUTO_TEST_CASE(encode)
+{
+	Dictionary::Ptr dict = new Dictionary({
+		{ "array", new Array({ 1, -2.5, true, Empty }) },
+		{ "empty", new Dictionary() },
+		{ "string", "a\"b\\c\n\x01/\xc3\xa4" }
+	});
+
+	BOOST_CHECK(JsonEncode(dict) == "{\"array\":[1.0,-2.5,true,null],\"empty\":{},\"string\":\"a\\\"b\\\\c\\n\\u0001/\xc3\xa4\"}");
+
+	BOOST_CHECK(JsonEncode(new Array({ 1 }), true) == "[\n    1.0\n]\n");
+
+	BOOST_CHECK(JsonEncode(0.1) == "0.10000000000000001");
+	BOOST_CHECK(JsonEncode(1e20) == "1e+20");
+	BOOST_CHECK(JsonEncode(1451606400) == "1451606400.0");
+
+	String output = "prefix:";
+	JsonEncode("x", output);
+	BOOST_CHECK(output == "prefix:\"x\"");
+}
+
+BOOST_AUTO_TEST_CASE(encode_large)
+{
+	Array::Ptr arr = new Array();
+
+	for (int i = 0; i < 1000; i++) {
+		arr->Add(new Dictionary({
+			{ "host_name", "host-" + Convert::ToString(i) },
+			{ "state", i % 4 },
+			{ "execution_time", i / 7.0 },
+			{ "output", "OK - \"load\" is fine\n" }
+		}));
+	}
+
+	String json = JsonEncode(arr);
+
+	Array::Ptr result = JsonDecode(json);
+	BOOST_CHECK(result->GetLength() == 1000);
+
+	Dictionary::Ptr last = result->Get(999);
+	BOOST_CHECK(last->Get("host_name") == "host-999");
+	BOOST_CHECK(last->Get("execution_time") == 999 / 7.0);
+	BOOST_CHECK(last->Get("output") == "OK - \"load\" is fine\n");
+}
+
+BOOST_AUTO_TEST_CASE(decode)
+{
+	Dictionary::Ptr dict = JsonDecode("{ \"a\": 1, \"b\": [ 2.5, -3e2, true, null ], /* comment */ \"c\": \"x\\n\\u00e4\" }");
+
+	BOOST_CHECK(dict->Get("a") == 1);
+
+	Array::Ptr arr = dict->Get("b");
+	BOOST_CHECK(arr->GetLength() == 4);
+	BOOST_CHECK(arr->Get(0) == 2.5);
+	BOOST_CHECK(arr->Get(1) == -300);
+	BOOST_CHECK(arr->Get(2) == true);
+	BOOST_CHECK(arr->Get(3).IsEmpty());
+
+	BOOST_CHECK(dict->Get("c") == "x\n\xc3\xa4");
+
+	/* the last of several identical keys wins */
+	dict = JsonDecode("{\"k\":1,\"k\":2}");
+	BOOST_CHECK(dict->Get("k") == 2);
+
+	/* integers which don't fit into 64 bits must not overflow */
+	BOOST_CHECK(JsonDecode("123456789012345678901234567890") == 123456789012345678901234567890.0);
+	BOOST_CHECK(JsonDecode("-123456789012345678901234567890") == -123456789012345678901234567890.0);
+	BOOST_CHECK(JsonDecode("9007199254740993") == 9007199254740993.0);
+
+	const char buf[] = "[1,2]garbage";
+	arr = JsonDecode(buf, 5);
+	BOOST_CHECK(arr->GetLength() == 2);
+}
+
 BOOST_AUTO_TEST_CASE(invalid1)
 {
 	BOOST_CHECK_THROW(JsonDecode("\"1.7"), std::exception);
 	BOOST_CHECK_THROW(JsonDecode("{8: \"test\"}"), std::exception);
 	BOOST_CHECK_THROW(JsonDecode("{\"test\": \"test\""), std::exception);
+	BOOST_CHECK_THROW(JsonDecode("[1,]"), std::exception);
+	BOOST_CHECK_THROW(JsonDecode("[1] x"), std::exception);
+	BOOST_CHECK_THROW(JsonDecode(""), std::exception);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -19,6 +19,9 @@
 
 #include "base/object.hpp"
 #include "base/value.hpp"
+#include "base/objectlock.hpp"
+#include <thread>
+#include <vector>
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -53,4 +56,27 @@ BOOST_AUTO_TEST_CASE(getself)
 	BOOST_CHECK(vobject.IsObjectType<TestObject>());
 }
 
+BOOST_AUTO_TEST_CASE(lock)
+{
+	TestObject::Ptr tobject = new TestObject();
+	int counter = 0;
+
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 4; i++) {
+		threads.emplace_back([tobject, &counter]() {
+			for (int j = 0; j < 10000; j++) {
+				ObjectLock olock(tobject);
+				ObjectLock olock2(tobject);
+				counter++;
+			}
+		});
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	BOOST_CHECK(counter == 40000);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,141 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/socketevents.hpp"
+#include <BoostTestTargetConfig.h>
+#include <cstring>
+#include <vector>
+#ifndef _WIN32
+#	include <sys/resource.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+
+class EchoSocketEvents final : public SocketEvents
+{
+public:
+	DECLARE_PTR_TYPEDEFS(EchoSocketEvents);
+
+	EchoSocketEvents(const Socket::Ptr& socket)
+		: SocketEvents(socket), m_Socket(socket)
+	{
+		ChangeEvents(POLLIN);
+	}
+
+	void OnEvent(int revents) override
+	{
+		char buffer[512];
+		size_t count = m_Socket->Read(buffer, sizeof(buffer));
+
+		if (count > 0)
+			m_Socket->Write(buffer, count);
+
+		ChangeEvents(POLLIN);
+	}
+
+	size_t Read(void *buffer, size_t count, bool allow_partial) override
+	{
+		return 0;
+	}
+
+	void Write(const void *buffer, size_t count) override
+	{
+	}
+
+	void Close() override
+	{
+		Unregister();
+		m_Socket->Close();
+	}
+
+	bool IsEof() const override
+	{
+		return false;
+	}
+
+private:
+	Socket::Ptr m_Socket;
+};
+
+BOOST_AUTO_TEST_SUITE(base_socketevents)
+
+BOOST_AUTO_TEST_CASE(echo)
+{
+	int connections = 500;
+
+#ifndef _WIN32
+	/* Every connection needs two sockets. */
+	rlimit rl;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+		rl.rlim_cur = rl.rlim_max;
+		(void) setrlimit(RLIMIT_NOFILE, &rl);
+		(void) getrlimit(RLIMIT_NOFILE, &rl);
+
+		if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < 2 * connections + 64)
+			connections = (rl.rlim_cur - 64) / 2;
+	}
+#endif /* _WIN32 */
+
+	const int rounds = 20;
+
+	std::vector<Socket::Ptr> clients;
+	std::vector<EchoSocketEvents::Ptr> servers;
+
+	for (int i = 0; i < connections; i++) {
+		SOCKET fds[2];
+		Socket::SocketPair(fds);
+
+		Socket::Ptr server = new Socket(fds[0]);
+		server->MakeNonBlocking();
+
+		servers.emplace_back(new EchoSocketEvents(server));
+		clients.emplace_back(new Socket(fds[1]));
+	}
+
+	const char message[] = "{\"jsonrpc\":\"2.0\",\"method\":\"event::Heartbeat\",\"params\":{}}";
+	size_t echoed = 0;
+
+	for (int i = 0; i < rounds; i++) {
+		for (const Socket::Ptr& client : clients)
+			client->Write(message, sizeof(message));
+
+		for (const Socket::Ptr& client : clients) {
+			char buffer[sizeof(message)];
+			size_t count = 0;
+
+			while (count < sizeof(buffer))
+				count += client->Read(buffer + count, sizeof(buffer) - count);
+
+			if (memcmp(buffer, message, sizeof(message)) == 0)
+				echoed++;
+		}
+	}
+
+	BOOST_CHECK(echoed == static_cast<size_t>(connections) * rounds);
+
+	for (const EchoSocketEvents::Ptr& server : servers) {
+		server->Close();
+		BOOST_CHECK(!server->IsHandlingEvents());
+	}
+
+	for (const Socket::Ptr& client : clients)
+		client->Close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
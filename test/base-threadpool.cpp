@@ -0,0 +1,98 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "base/threadpool.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <atomic>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_threadpool)
+
+static void WaitFor(const std::atomic<int>& counter, int expected)
+{
+	for (int i = 0; i < 500 && counter.load() < expected; i++)
+		Utility::Sleep(0.01);
+}
+
+BOOST_AUTO_TEST_CASE(post)
+{
+	ThreadPool tp;
+	std::atomic<int> counter(0);
+
+	for (int i = 0; i < 1000; i++)
+		BOOST_CHECK(tp.Post([&counter]() { counter++; }));
+
+	WaitFor(counter, 1000);
+	BOOST_CHECK(counter.load() == 1000);
+}
+
+BOOST_AUTO_TEST_CASE(nested)
+{
+	ThreadPool tp;
+	std::atomic<int> counter(0);
+
+	/* Items posted by workers go into the worker's own deque and may be stolen. */
+	for (int i = 0; i < 100; i++) {
+		tp.Post([&tp, &counter]() {
+			for (int j = 0; j < 10; j++)
+				tp.Post([&counter]() { counter++; });
+		});
+	}
+
+	WaitFor(counter, 1000);
+	BOOST_CHECK(counter.load() == 1000);
+}
+
+BOOST_AUTO_TEST_CASE(lowlatency)
+{
+	ThreadPool tp;
+	std::atomic<int> counter(0);
+
+	for (int i = 0; i < 100; i++)
+		tp.Post([&counter]() { counter++; }, LowLatencyScheduler);
+
+	WaitFor(counter, 100);
+	BOOST_CHECK(counter.load() == 100);
+
+	ThreadPoolStatistics stats = tp.GetStatistics();
+	BOOST_CHECK(stats.Threads > 0);
+	BOOST_CHECK(stats.Lanes[LowLatencyScheduler].Pending == 0);
+}
+
+BOOST_AUTO_TEST_CASE(restart)
+{
+	ThreadPool tp;
+	std::atomic<int> counter(0);
+
+	tp.Stop();
+
+	/* Items posted while the pool is stopped are kept until it's restarted. */
+	BOOST_CHECK(tp.Post([&counter]() { counter++; }));
+
+	tp.Start();
+	BOOST_CHECK(tp.Post([&counter]() { counter++; }));
+
+	WaitFor(counter, 2);
+	BOOST_CHECK(counter.load() == 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -21,6 +21,7 @@
 #include "base/utility.hpp"
 #include "base/application.hpp"
 #include <BoostTestTargetConfig.h>
+#include <atomic>
 
 using namespace icinga;
 
@@ -75,4 +76,46 @@ BOOST_AUTO_TEST_CASE(scope)
 	BOOST_CHECK(counter >= 4 && counter <= 6);
 }
 
+BOOST_AUTO_TEST_CASE(reschedule)
+{
+	Timer::Ptr timer = new Timer();
+	timer->OnTimerExpired.connect(&Callback);
+
+	counter = 0;
+	timer->Start();
+
+	/* Move a one-shot timer from far in the future to shortly after now. */
+	timer->Reschedule(Utility::GetTime() + 3600);
+	timer->Reschedule(Utility::GetTime() + 0.5);
+	Utility::Sleep(1.5);
+
+	BOOST_CHECK(counter == 1);
+
+	timer->Reschedule(Utility::GetTime() + 0.5);
+	timer->Stop();
+	Utility::Sleep(1.5);
+	BOOST_CHECK(counter == 1);
+}
+
+BOOST_AUTO_TEST_CASE(many)
+{
+	std::vector<Timer::Ptr> timers;
+	std::atomic<int> calls(0);
+
+	for (int i = 0; i < 1000; i++) {
+		Timer::Ptr timer = new Timer();
+		timer->OnTimerExpired.connect([&calls](const Timer::Ptr&) { calls++; });
+		timer->Start();
+		timer->Reschedule(Utility::GetTime() + (i % 10) * 0.1);
+		timers.push_back(timer);
+	}
+
+	Utility::Sleep(2);
+
+	BOOST_CHECK(calls == 1000);
+
+	for (const Timer::Ptr& timer : timers)
+		timer->Stop(true);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
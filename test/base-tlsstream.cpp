@@ -0,0 +1,127 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/tlsstream.hpp"
+#include "base/tlsutility.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+using namespace icinga;
+
+/* Keeps the data for WriteShared() alive until the stream is done with it. */
+class SharedBuffer final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(SharedBuffer);
+
+	explicit SharedBuffer(std::string data)
+		: Data(std::move(data))
+	{ }
+
+	std::string Data;
+};
+
+static std::shared_ptr<SSL_CTX> MakeTestSSLContext()
+{
+	String prefix = "tlsstream-" + Convert::ToString(Utility::GetPid());
+	String keyfile = prefix + ".key";
+	String certfile = prefix + ".crt";
+
+	MakeX509CSR("localhost", keyfile, String(), certfile);
+
+	std::shared_ptr<SSL_CTX> context = MakeSSLContext(certfile, keyfile);
+
+	(void)remove(keyfile.CStr());
+	(void)remove(certfile.CStr());
+
+	return context;
+}
+
+BOOST_AUTO_TEST_SUITE(base_tlsstream)
+
+BOOST_AUTO_TEST_CASE(send_queue)
+{
+	std::shared_ptr<SSL_CTX> context = MakeTestSSLContext();
+
+	SOCKET fds[2];
+	Socket::SocketPair(fds);
+
+	/* The receiving end is driven by hand so that it can stop reading. */
+	std::shared_ptr<SSL> peer(SSL_new(context.get()), SSL_free);
+	SSL_set_fd(peer.get(), fds[0]);
+
+	int accepted = 0;
+	std::thread handshake([&peer, &accepted]() { accepted = SSL_accept(peer.get()); });
+
+	TlsStream::Ptr stream = new TlsStream(new Socket(fds[1]), "localhost", RoleClient, context);
+	stream->Handshake();
+
+	handshake.join();
+	BOOST_REQUIRE(accepted == 1);
+
+	/* Mix copied and shared segments of various sizes. Nobody reads them for
+	 * now, so SSL_write() runs into partial writes and has to retry them while
+	 * more data is appended to the copied segment it's writing from. */
+	std::string expected;
+
+	for (int i = 0; i < 600; i++) {
+		size_t length = (i * 7919) % (i % 3 == 0 ? 70000 : 300) + 1;
+		std::string chunk;
+
+		for (size_t k = 0; k < length; k++)
+			chunk += static_cast<char>('a' + (i + k) % 26);
+
+		if (i % 3 == 0) {
+			SharedBuffer::Ptr buffer = new SharedBuffer(chunk);
+			stream->WriteShared(buffer, buffer->Data.c_str(), buffer->Data.size());
+		} else
+			stream->Write(chunk.c_str(), chunk.size());
+
+		expected += chunk;
+	}
+
+	/* The peer doesn't read, so the queue can't drain. */
+	BOOST_CHECK(!stream->WaitForSendQueue(0, 1));
+
+	std::string received;
+	char buffer[16 * 1024];
+
+	while (received.size() < expected.size()) {
+		int rc = SSL_read(peer.get(), buffer, sizeof(buffer));
+
+		if (rc <= 0)
+			break;
+
+		received.append(buffer, rc);
+	}
+
+	BOOST_CHECK(stream->WaitForSendQueue(0, 10));
+	BOOST_CHECK(received.size() == expected.size());
+	BOOST_CHECK(received == expected);
+
+	stream->Close();
+	peer.reset();
+	closesocket(fds[0]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -66,4 +66,49 @@ BOOST_AUTO_TEST_CASE(format)
 	BOOST_CHECK(v != 3);
 }
 
+BOOST_AUTO_TEST_CASE(compact)
+{
+	BOOST_CHECK(sizeof(Value) <= 16);
+
+	Value a = "a string which is too long to be stored inline";
+	Value b = a;
+
+	BOOST_CHECK(b == a);
+	BOOST_CHECK(b == "a string which is too long to be stored inline");
+
+	Value c = std::move(b);
+	BOOST_CHECK(b.IsEmpty());
+	BOOST_CHECK(c == a);
+
+	c = 7;
+	BOOST_CHECK(c.IsNumber());
+	BOOST_CHECK(a.IsString());
+
+	a.Swap(c);
+	BOOST_CHECK(a == 7);
+	BOOST_CHECK(c.IsString());
+
+	BOOST_CHECK_THROW(c.Get<double>(), boost::bad_get);
+
+	Value s1 = "short";
+	Value s2 = String("14 chars: abcd");
+	Value s3 = String("15 chars: abcde");
+
+	BOOST_CHECK(s1 == "short");
+	BOOST_CHECK(static_cast<String>(s2) == "14 chars: abcd");
+	BOOST_CHECK(static_cast<String>(s3) == "15 chars: abcde");
+	BOOST_CHECK(s2 != s3);
+	BOOST_CHECK(s3 != "15 chars: abcd");
+
+	Value s4 = s2;
+	s2 = Empty;
+	BOOST_CHECK(s4 == "14 chars: abcd");
+	BOOST_CHECK(s4.ToBool());
+
+	Value e = "";
+	BOOST_CHECK(e.IsString());
+	BOOST_CHECK(e.IsEmpty());
+	BOOST_CHECK(!e.ToBool());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,155 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "base/workqueue.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <atomic>
+#include <thread>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_workqueue)
+
+BOOST_AUTO_TEST_CASE(order)
+{
+	WorkQueue wq;
+	wq.SetName("order");
+
+	std::vector<int> results;
+
+	for (int i = 0; i < 1000; i++)
+		wq.Enqueue([&results, i]() { results.push_back(i); });
+
+	wq.Join();
+
+	BOOST_CHECK(results.size() == 1000);
+
+	for (int i = 0; i < 1000; i++)
+		BOOST_CHECK(results[i] == i);
+}
+
+BOOST_AUTO_TEST_CASE(priority)
+{
+	WorkQueue wq;
+	wq.SetName("priority");
+
+	std::atomic<bool> blocked(true);
+	std::vector<int> results;
+
+	/* Keep the worker busy until all other tasks are queued. */
+	wq.Enqueue([&blocked]() {
+		while (blocked.load())
+			Utility::Sleep(0.001);
+	});
+
+	wq.Enqueue([&results]() { results.push_back(PriorityLow); }, PriorityLow);
+	wq.Enqueue([&results]() { results.push_back(PriorityNormal); }, PriorityNormal);
+	wq.Enqueue([&results]() { results.push_back(PriorityHigh); }, PriorityHigh);
+
+	blocked.store(false);
+	wq.Join();
+
+	BOOST_CHECK(results.size() == 3);
+	BOOST_CHECK(results[0] == PriorityHigh);
+	BOOST_CHECK(results[1] == PriorityNormal);
+	BOOST_CHECK(results[2] == PriorityLow);
+}
+
+BOOST_AUTO_TEST_CASE(backpressure)
+{
+	const int producers = 4;
+
+	WorkQueue wq(10);
+	wq.SetName("backpressure");
+
+	std::atomic<int> counter(0);
+	std::atomic<size_t> maxLength(0);
+	std::vector<std::thread> threads;
+
+	for (int p = 0; p < producers; p++) {
+		threads.emplace_back([&]() {
+			for (int i = 0; i < 1000; i++) {
+				wq.Enqueue([&counter]() { counter++; });
+
+				size_t length = wq.GetLength();
+
+				if (length > maxLength.load())
+					maxLength.store(length);
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	wq.Join();
+
+	BOOST_CHECK(counter.load() == producers * 1000);
+
+	/* Producers which passed the check at the same time may overshoot the limit. */
+	BOOST_CHECK(maxLength.load() <= 10 + producers);
+}
+
+BOOST_AUTO_TEST_CASE(parallelfor)
+{
+	WorkQueue wq(0, 4);
+	wq.SetName("parallelfor");
+
+	std::vector<int> items;
+
+	for (int i = 1; i <= 1000; i++)
+		items.push_back(i);
+
+	std::atomic<int> sum(0);
+
+	wq.ParallelFor(items, [&sum](int item) { sum += item; });
+	wq.Join();
+
+	BOOST_CHECK(sum.load() == 500500);
+}
+
+BOOST_AUTO_TEST_CASE(contention)
+{
+	const int producers = 8;
+	const int tasks = 10000;
+
+	WorkQueue wq;
+	wq.SetName("contention");
+
+	std::atomic<int> counter(0);
+	std::vector<std::thread> threads;
+
+	for (int p = 0; p < producers; p++) {
+		threads.emplace_back([&]() {
+			for (int i = 0; i < tasks; i++)
+				wq.Enqueue([&counter]() { counter++; });
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	wq.Join();
+
+	BOOST_CHECK(counter.load() == producers * tasks);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,188 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/filterutility.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
+#include "base/function.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static void CreateFilterTestObjects()
+{
+	String config = R"CONFIG(
+object CheckCommand "filter-dummy" {
+  command = "/bin/echo"
+}
+
+object HostGroup "filter-linux" { }
+
+object Host "filter-web-01" {
+  check_command = "filter-dummy"
+  groups = [ "filter-linux" ]
+  vars.os = "Linux"
+}
+
+object Host "filter-web-02" {
+  check_command = "filter-dummy"
+  groups = [ "filter-linux" ]
+  vars.os = "Linux"
+}
+
+object Host "filter-db-01" {
+  check_command = "filter-dummy"
+}
+
+apply Service "filter-ping" {
+  check_command = "filter-dummy"
+  assign where match("filter-*", host.name)
+}
+
+apply Service "filter-http" {
+  check_command = "filter-dummy"
+  assign where match("filter-web-*", host.name)
+}
+)CONFIG";
+
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<filterutility>", config);
+	expr->Evaluate(*ScriptFrame::GetCurrentFrame());
+}
+
+struct FilterUtilityFixture
+{
+	FilterUtilityFixture()
+	{
+		static bool initialized = false;
+
+		if (!initialized) {
+			ConfigItem::RunWithActivationContext(new Function("CreateFilterTestObjects", CreateFilterTestObjects));
+			initialized = true;
+		}
+	}
+};
+
+/* Returns the names of the objects which match the filter and whether an index was used for them. */
+static std::set<String> GetFilterTargetNames(const String& type, const String& filter, bool& indexed,
+	const Dictionary::Ptr& filterVars = nullptr)
+{
+	QueryDescription qd;
+	qd.Types.insert(type);
+
+	Dictionary::Ptr query = new Dictionary({
+		{ "type", type },
+		{ "filter", filter }
+	});
+
+	Namespace::Ptr vars = new Namespace();
+
+	if (filterVars) {
+		query->Set("filter_vars", filterVars);
+
+		ObjectLock olock(filterVars);
+		for (const Dictionary::Pair& kv : filterVars) {
+			vars->Set(kv.first, kv.second);
+		}
+	}
+
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<API query>", filter);
+	std::vector<ConfigObject::Ptr> candidates;
+	indexed = FilterUtility::GetIndexedTargets(Type::GetByName(type), expr.get(), vars, String(), candidates);
+
+	std::set<String> names;
+
+	for (const ConfigObject::Ptr& target : FilterUtility::GetFilterTargets(qd, query, nullptr)) {
+		names.insert(target->GetName());
+	}
+
+	return names;
+}
+
+BOOST_FIXTURE_TEST_SUITE(remote_filterutility, FilterUtilityFixture)
+
+BOOST_AUTO_TEST_CASE(hosts)
+{
+	bool indexed;
+
+	BOOST_CHECK(GetFilterTargetNames("Host", "host.name == \"filter-web-01\"", indexed) == std::set<String>({ "filter-web-01" }));
+	BOOST_CHECK(indexed);
+
+	BOOST_CHECK(GetFilterTargetNames("Host", "\"filter-linux\" in host.groups", indexed) == std::set<String>({ "filter-web-01", "filter-web-02" }));
+	BOOST_CHECK(indexed);
+
+	BOOST_CHECK(GetFilterTargetNames("Host", "host.check_command == \"filter-dummy\"", indexed) == std::set<String>({ "filter-web-01", "filter-web-02", "filter-db-01" }));
+	BOOST_CHECK(indexed);
+
+	BOOST_CHECK(GetFilterTargetNames("Host", "match(\"FILTER-DB-*\", host.name)", indexed) == std::set<String>({ "filter-db-01" }));
+	BOOST_CHECK(indexed);
+
+	BOOST_CHECK(GetFilterTargetNames("Host", "host.name == \"filter-web-01\" && host.vars.os == \"Linux\"", indexed) == std::set<String>({ "filter-web-01" }));
+	BOOST_CHECK(indexed);
+
+	BOOST_CHECK(GetFilterTargetNames("Host", "host.name != \"filter-web-01\" && match(\"filter-*\", host.name)", indexed) == std::set<String>({ "filter-web-02", "filter-db-01" }));
+	BOOST_CHECK(indexed);
+}
+
+BOOST_AUTO_TEST_CASE(services)
+{
+	bool indexed;
+
+	BOOST_CHECK(GetFilterTargetNames("Service", "host.name == hostname", indexed, new Dictionary({ { "hostname", "filter-db-01" } }))
+		== std::set<String>({ "filter-db-01!filter-ping" }));
+	BOOST_CHECK(indexed);
+
+	BOOST_CHECK(GetFilterTargetNames("Service", "\"filter-linux\" in host.groups && service.name == \"filter-http\"", indexed)
+		== std::set<String>({ "filter-web-01!filter-http", "filter-web-02!filter-http" }));
+	BOOST_CHECK(indexed);
+
+	BOOST_CHECK(GetFilterTargetNames("Service", "service.host_name == \"filter-web-02\" || host.name == \"filter-db-01\"", indexed)
+		== std::set<String>({ "filter-web-02!filter-ping", "filter-web-02!filter-http", "filter-db-01!filter-ping" }));
+	BOOST_CHECK(indexed);
+
+	BOOST_CHECK(GetFilterTargetNames("Service", "match(\"filter-web-*\", host.name) && service.name == \"filter-ping\"", indexed)
+		== std::set<String>({ "filter-web-01!filter-ping", "filter-web-02!filter-ping" }));
+	BOOST_CHECK(indexed);
+
+	/* Service names are composed from the host name, their short names are not indexed. */
+	BOOST_CHECK(GetFilterTargetNames("Service", "service.name == \"filter-http\" || host.name == \"filter-db-01\"", indexed)
+		== std::set<String>({ "filter-web-01!filter-http", "filter-web-02!filter-http", "filter-db-01!filter-ping" }));
+	BOOST_CHECK(!indexed);
+}
+
+BOOST_AUTO_TEST_CASE(order)
+{
+	Type::Ptr type = Type::GetByName("Service");
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<API query>", "match(\"filter-*\", host.name)");
+
+	std::vector<ConfigObject::Ptr> targets;
+	BOOST_CHECK(FilterUtility::GetIndexedTargets(type, expr.get(), nullptr, String(), targets));
+
+	/* Paging with offset/limit relies on indexed lookups returning the objects in the same order as a scan. */
+	std::vector<ConfigObject::Ptr> expected;
+
+	for (const ConfigObject::Ptr& object : dynamic_cast<ConfigType *>(type.get())->GetObjects()) {
+		if (object->GetName().Find("filter-") == 0)
+			expected.push_back(object);
+	}
+
+	BOOST_CHECK(expected.size() == 5);
+	BOOST_CHECK(targets == expected);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
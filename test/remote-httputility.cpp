@@ -0,0 +1,95 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/httputility.hpp"
+#include "base/convert.hpp"
+#include "base/fifo.hpp"
+#include "base/json.hpp"
+#include <BoostTestTargetConfig.h>
+#include <cstdlib>
+
+using namespace icinga;
+
+/* Returns the body of a chunked response which was written to a FIFO. */
+static String ReadChunkedBody(const FIFO::Ptr& fifo)
+{
+	String output;
+	char buffer[4096];
+
+	while (fifo->IsDataAvailable()) {
+		size_t count = fifo->Read(buffer, sizeof(buffer), true);
+		output += String(buffer, buffer + count);
+	}
+
+	String body;
+	String::SizeType pos = output.Find("\r\n\r\n") + 4;
+
+	for (;;) {
+		String::SizeType eol = output.Find("\r\n", pos);
+		size_t length = strtoul(output.SubStr(pos, eol - pos).CStr(), nullptr, 16);
+
+		if (length == 0)
+			break;
+
+		body += output.SubStr(eol + 2, length);
+		pos = eol + 2 + length + 2;
+	}
+
+	return body;
+}
+
+BOOST_AUTO_TEST_SUITE(remote_httputility)
+
+BOOST_AUTO_TEST_CASE(json_results)
+{
+	for (bool pretty : { false, true }) {
+		for (int count : { 0, 1, 5000 }) {
+			FIFO::Ptr fifo = new FIFO();
+			HttpRequest request(fifo);
+			HttpResponse response(fifo, request);
+
+			JsonResultsWriter writer(response, new Dictionary({ { "pretty", pretty } }));
+			ArrayData results;
+
+			for (int i = 0; i < count; i++) {
+				Dictionary::Ptr result = new Dictionary({
+					{ "name", "host-" + Convert::ToString(i) },
+					{ "attrs", new Dictionary({
+						{ "state", i % 3 },
+						{ "groups", new Array({ "linux-servers", "web" }) },
+						{ "vars", new Dictionary() }
+					}) }
+				});
+
+				BOOST_CHECK(writer.Add(result));
+				results.push_back(result);
+			}
+
+			BOOST_CHECK(writer.Finish());
+			BOOST_CHECK(writer.IsStarted());
+
+			/* The streamed output must be the same as for the whole document. */
+			String expected = JsonEncode(new Dictionary({ { "results", new Array(std::move(results)) } }), pretty);
+
+			BOOST_CHECK(ReadChunkedBody(fifo) == expected);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,123 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://icinga.com/)      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/replaylog.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(remote_replaylog)
+
+BOOST_AUTO_TEST_CASE(read_write)
+{
+	String path = "replaylog-" + Convert::ToString(Utility::GetPid());
+
+	ReplayLogWriter writer(path);
+	BOOST_CHECK(writer.IsGood());
+
+	writer.Write(100, "Host", "example", "{\"method\":\"a\"}");
+	writer.Write(101, "", "", "{\"method\":\"b\"}");
+	BOOST_CHECK(writer.GetMessageCount() == 2);
+
+	writer.Close();
+
+	ReplayLogReader reader(path);
+	BOOST_CHECK(reader.IsGood());
+
+	double ts;
+	String type, name;
+
+	BOOST_CHECK(reader.Next(&ts, &type, &name));
+	BOOST_CHECK(ts == 100);
+	BOOST_CHECK(type == "Host");
+	BOOST_CHECK(name == "example");
+	BOOST_CHECK(reader.ReadMessage() == "{\"method\":\"a\"}");
+
+	BOOST_CHECK(reader.Next(&ts, &type, &name));
+	BOOST_CHECK(ts == 101);
+	BOOST_CHECK(type.IsEmpty());
+	BOOST_CHECK(reader.ReadMessage() == "{\"method\":\"b\"}");
+
+	BOOST_CHECK(!reader.Next(&ts, &type, &name));
+
+	(void)remove(path.CStr());
+}
+
+BOOST_AUTO_TEST_CASE(seek)
+{
+	String path = "replaylog-" + Convert::ToString(Utility::GetPid());
+
+	ReplayLogWriter writer(path);
+
+	for (int i = 0; i < 100; i++)
+		writer.Write(1000 + i, "", "", Convert::ToString(i));
+
+	writer.Close();
+
+	ReplayLogReader reader(path);
+	reader.SeekToTimestamp(1050);
+
+	double ts;
+	String type, name;
+
+	/* The reader may start a bit before the timestamp, but it must skip most of the file. */
+	BOOST_CHECK(reader.Next(&ts, &type, &name));
+	BOOST_CHECK(ts <= 1050 && ts > 1040);
+
+	(void)remove(path.CStr());
+}
+
+BOOST_AUTO_TEST_CASE(corrupt)
+{
+	String path = "replaylog-" + Convert::ToString(Utility::GetPid());
+
+	ReplayLogWriter writer(path);
+	writer.Write(100, "", "", "{\"method\":\"a\"}");
+	writer.Close();
+
+	/* Append a record whose message length points far beyond the end of the file. */
+	ReplayLogRecordHeader header;
+	memset(&header, 0, sizeof(header));
+	header.Magic = 0x52523249; /* "I2RR" */
+	header.MessageLength = 0xfffffff0;
+	header.Timestamp = 101;
+
+	std::ofstream fp(path.CStr(), std::ofstream::out | std::ofstream::app | std::ofstream::binary);
+	fp.write(reinterpret_cast<char *>(&header), sizeof(header));
+	fp.close();
+
+	ReplayLogReader reader(path);
+
+	double ts;
+	String type, name;
+
+	BOOST_CHECK(reader.Next(&ts, &type, &name));
+	BOOST_CHECK(reader.ReadMessage() == "{\"method\":\"a\"}");
+
+	BOOST_CHECK(!reader.Next(&ts, &type, &name));
+
+	(void)remove(path.CStr());
+}
+
+BOOST_AUTO_TEST_SUITE_END()